@@ -1,5 +1,9 @@
 #include "../include/audio/audio.h"
 #include "../include/log.h"
+#include <string.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 
 void finite_audio_get_audio_duration_debug(const char *file, const char *func, int line, FinitePlaybackDevice *dev) {
     // to get true seconds do basic math
@@ -47,50 +51,135 @@ bool finite_audio_get_audio_params_debug(const char *rfile, const char *func, in
     // now assign the info data to the device
     FINITE_LOG("Sound supports %d channels. %s", info.channels, info.channels == 2 ? "(Stereo)" : "(Mono)");
     dev->channels = info.channels;
-    if (info.samplerate != 44100) {
-        finite_log_internal(LOG_LEVEL_WARN, rfile, line, func, "Sample Rate %d is not the recommended sample rate of 44100.", info.samplerate);
-    }
-
+    // any rate works, it's converted to the device's rate during playback
     dev->sample_rate = (uint32_t) info.samplerate;
     
     dev->sfFrames = info.frames;
+    dev->writePosition = 0;
     return true;
 }
 
 FinitePlaybackDevice *finite_audio_device_init_debug(const char *file, const char *func, int line) {
+    return finite_audio_device_open_debug(file, func, line, "default");
+};
+
+FinitePlaybackDevice *finite_audio_device_open_debug(const char *file, const char *func, int line, const char *name) {
+    if (!name) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to open device with NULL name");
+        return NULL;
+    }
+
     FinitePlaybackDevice *dev = calloc(1, sizeof(FinitePlaybackDevice));
+    if (!dev) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to open device (no memory available)");
+        return NULL;
+    }
 
-    int err = snd_pcm_open(&dev->device, "default", SND_PCM_STREAM_PLAYBACK, 0);
+    int err = snd_pcm_open(&dev->device, name, SND_PCM_STREAM_PLAYBACK, 0);
     if (err < 0) {
-        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to open device");
-        return 0;
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to open device %s (%s)", name, snd_strerror(err));
+        free(dev);
+        return NULL;
     }
 
-    dev->name = "default";
-
     err = snd_pcm_hw_params_malloc(&dev->params);
     if (err < 0) {
         finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to allocate hw params");
-        return 0;
+        snd_pcm_close(dev->device);
+        free(dev);
+        return NULL;
+    }
+
+    // commands wake the engine through eventFd, and both sit in pollFd with the pcm's descriptors once playback starts
+    dev->eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    dev->pollFd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event event = { .events = EPOLLIN, .data.fd = dev->eventFd };
+    if (dev->eventFd < 0 || dev->pollFd < 0 || epoll_ctl(dev->pollFd, EPOLL_CTL_ADD, dev->eventFd, &event) < 0) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to create the wakeup descriptors (%s)", strerror(errno));
+        if (dev->eventFd >= 0) {
+            close(dev->eventFd);
+        }
+        if (dev->pollFd >= 0) {
+            close(dev->pollFd);
+        }
+        snd_pcm_hw_params_free(dev->params);
+        snd_pcm_close(dev->device);
+        free(dev);
+        return NULL;
     }
 
+    dev->name = strdup(name);
+    dev->resampleQuality = FINITE_AUDIO_RESAMPLE_MEDIUM;
+    pthread_mutex_init(&dev->wakeLock, NULL);
+    pthread_cond_init(&dev->wake, NULL);
     return dev;
-};
+}
 
-// when autoCreate is true it will run finite_audio_get_audio_params(). 
-bool finite_audio_init_audio_debug(const char *file, const char *func, int line, FinitePlaybackDevice *dev, char* audio, bool autoCreate) {
-    if (!dev || !audio) {
-        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to init audio with NULL data");
+// sets up the resampler when the pcm couldn't take the source's rate
+static bool finite_audio_setup_resampler(const char *file, const char *func, int line, FinitePlaybackDevice *dev) {
+    FiniteAudioResampler *rs = dev->resampler;
+    if (rs && (rs->inRate != dev->sample_rate || rs->outRate != dev->deviceRate || rs->channels != dev->channels)) {
+        finite_audio_resampler_destroy_debug(file, func, line, rs);
+        dev->resampler = NULL;
+    }
+
+    if (dev->deviceRate == dev->sample_rate || dev->resampler) {
+        return true;
+    }
+
+    dev->resampler = finite_audio_resampler_create_debug(file, func, line, dev->sample_rate, dev->deviceRate, dev->channels, dev->resampleQuality);
+    if (!dev->resampler) {
         return false;
-    } 
+    }
 
-    if (autoCreate) {
-        bool success = finite_audio_get_audio_params(audio, dev);
-        if (!success) {
-            return false; // message is printed already
-        }
+    free(dev->decodeBuffer);
+    dev->decodeCap = 4096;
+    dev->decodeBuffer = malloc(dev->decodeCap * dev->channels * sizeof(short));
+    if (!dev->decodeBuffer) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to allocate decode buffer");
+        finite_audio_resampler_destroy_debug(file, func, line, dev->resampler);
+        dev->resampler = NULL;
+        return false;
+    }
+
+    finite_log_internal(LOG_LEVEL_DEBUG, file, line, func, "Resampling %d Hz to the device's %d Hz", dev->sample_rate, dev->deviceRate);
+    return true;
+}
+
+// the device starts once its buffer is full and wakes us whenever a period is free (or on period events)
+static bool finite_audio_apply_sw_params(const char *file, const char *func, int line, FinitePlaybackDevice *dev) {
+    snd_pcm_sw_params_t *sw;
+    if (snd_pcm_sw_params_malloc(&sw) < 0) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to allocate sw params");
+        return false;
+    }
+
+    snd_pcm_uframes_t period = dev->frames > 0 ? dev->frames : 1;
+    int err = snd_pcm_sw_params_current(dev->device, sw);
+    if (err >= 0) {
+        err = snd_pcm_sw_params_set_start_threshold(dev->device, sw, (dev->bufferFrames / period) * period);
+    }
+    if (err >= 0) {
+        err = snd_pcm_sw_params_set_avail_min(dev->device, sw, dev->per_event ? dev->bufferFrames : period);
+    }
+    if (err >= 0 && dev->per_event) {
+        err = snd_pcm_sw_params_set_period_event(dev->device, sw, 1);
+    }
+    if (err >= 0) {
+        err = snd_pcm_sw_params(dev->device, sw);
     }
 
+    snd_pcm_sw_params_free(sw);
+    if (err < 0) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to set sw params (%s)", snd_strerror(err));
+        return false;
+    }
+
+    return true;
+}
+
+// applies the device's channels to the pcm and picks the rate closest to sample_rate (or preferredRate) the device can run at
+static bool finite_audio_apply_hw_params(const char *file, const char *func, int line, FinitePlaybackDevice *dev) {
     snd_pcm_hw_params_any(dev->device, dev->params);
 
     int err;
@@ -101,7 +190,17 @@ bool finite_audio_init_audio_debug(const char *file, const char *func, int line,
         return false;
     }
 
-    err = snd_pcm_hw_params_set_access(dev->device, dev->params, SND_PCM_ACCESS_RW_INTERLEAVED);
+    if (dev->useMmap) {
+        err = snd_pcm_hw_params_set_access(dev->device, dev->params, SND_PCM_ACCESS_MMAP_INTERLEAVED);
+        if (err < 0) {
+            finite_log_internal(LOG_LEVEL_WARN, file, line, func, "Device %s can't be mmapped, falling back to writes.", dev->name);
+            dev->useMmap = false;
+        }
+    }
+
+    if (!dev->useMmap) {
+        err = snd_pcm_hw_params_set_access(dev->device, dev->params, SND_PCM_ACCESS_RW_INTERLEAVED);
+    }
     if (err < 0) {
         finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to set device sampling to interleaved.");
         return false;
@@ -122,70 +221,1140 @@ bool finite_audio_init_audio_debug(const char *file, const char *func, int line,
         return false;
     }
 
-    err = snd_pcm_hw_params_set_rate(dev->device, dev->params, dev->sample_rate, 0);
+    unsigned int rate = dev->preferredRate != 0 ? dev->preferredRate : dev->sample_rate;
+    err = snd_pcm_hw_params_set_rate_near(dev->device, dev->params, &rate, 0);
     if (err < 0) {
         finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to set playback rate");
         return false;
     }
 
+    dev->deviceRate = rate;
+
+    if (dev->buff_time > 0) {
+        unsigned int bufferTime = dev->buff_time;
+        err = snd_pcm_hw_params_set_buffer_time_near(dev->device, dev->params, &bufferTime, 0);
+        if (err < 0) {
+            finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to set buffer time to %dus", dev->buff_time);
+            return false;
+        }
+    }
+
+    if (dev->buff_per > 0) {
+        unsigned int periodTime = dev->buff_per;
+        err = snd_pcm_hw_params_set_period_time_near(dev->device, dev->params, &periodTime, 0);
+        if (err < 0) {
+            finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to set period time to %dus", dev->buff_per);
+            return false;
+        }
+    }
+
     err = snd_pcm_hw_params(dev->device, dev->params);
     if (err < 0) {
         finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to save params to device");
         return false;
     }
 
+    snd_pcm_hw_params_get_buffer_size(dev->params, &dev->bufferFrames);
+    snd_pcm_hw_params_get_period_size(dev->params, &dev->frames, 0);
+    finite_log_internal(LOG_LEVEL_DEBUG, file, line, func, "Device buffer is %lu frames in periods of %lu", (unsigned long) dev->bufferFrames, (unsigned long) dev->frames);
+
+    if (!finite_audio_apply_sw_params(file, func, line, dev)) {
+        return false;
+    }
+
     err = snd_pcm_prepare(dev->device);
     if (err < 0) {
         finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to prepare the device");
         return false;
     }
 
+    return finite_audio_setup_resampler(file, func, line, dev);
+}
+
+// when autoCreate is true it will run finite_audio_get_audio_params(). 
+bool finite_audio_init_audio_debug(const char *file, const char *func, int line, FinitePlaybackDevice *dev, char* audio, bool autoCreate) {
+    if (!dev || !audio) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to init audio with NULL data");
+        return false;
+    } 
+
+    if (autoCreate) {
+        bool success = finite_audio_get_audio_params(audio, dev);
+        if (!success) {
+            return false; // message is printed already
+        }
+    }
+
+    if (!finite_audio_apply_hw_params(file, func, line, dev)) {
+        return false;
+    }
+
     dev->filename = audio;
     return true;
 }
 
-void finite_audio_play_debug(const char *file, const char *func, int line, FinitePlaybackDevice *dev) {
+bool finite_audio_init_stream_debug(const char *file, const char *func, int line, FinitePlaybackDevice *dev, char *path, float aheadSeconds) {
+    if (!dev || !path) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to init stream with NULL data");
+        return false;
+    }
+
+    if (dev->stream || dev->file) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to init stream on a device that already has a file");
+        return false;
+    }
+
+    FiniteAudioStream *stream = finite_audio_stream_map_debug(file, func, line, path);
+    if (!stream) {
+        return false;
+    }
+
+    SF_INFO info;
+    dev->file = finite_audio_stream_open_debug(file, func, line, stream, &info);
+    if (!dev->file) {
+        finite_audio_stream_destroy_debug(file, func, line, stream);
+        return false;
+    }
+
+    dev->stream = stream;
+    dev->channels = info.channels;
+    dev->sample_rate = (uint32_t) info.samplerate;
+    dev->sfFrames = info.frames;
+    dev->writePosition = 0;
+    dev->aheadSeconds = aheadSeconds > 0 ? aheadSeconds : 2.0f;
+
+    // keep the same stretch of the encoded file on its way in from storage
+    if (info.frames > 0 && info.samplerate > 0) {
+        double bytesPerSecond = (double) stream->size / ((double) info.frames / info.samplerate);
+        stream->aheadBytes = (sf_count_t) (bytesPerSecond * dev->aheadSeconds);
+    } else {
+        stream->aheadBytes = stream->size;
+    }
+
+    if (!finite_audio_apply_hw_params(file, func, line, dev)) {
+        return false;
+    }
+
+    dev->filename = path;
+    return true;
+}
+
+// sets the device up for audio that isn't read from a file (like a mixer). frames come from fill instead.
+bool finite_audio_init_output_debug(const char *file, const char *func, int line, FinitePlaybackDevice *dev, uint32_t sampleRate, uint32_t channels, FiniteAudioFill fill, void *data) {
+    if (!dev || !fill) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to init output with NULL device or fill function");
+        return false;
+    }
+
+    if (sampleRate == 0 || channels == 0) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to init output with no sample rate or channels (Rate: %d Channels: %d)", sampleRate, channels);
+        return false;
+    }
+
+    dev->sample_rate = sampleRate;
+    dev->channels = channels;
+
+    if (!finite_audio_apply_hw_params(file, func, line, dev)) {
+        return false;
+    }
+
+    dev->fill = fill;
+    dev->fillData = data;
+    return true;
+}
+
+bool finite_audio_set_buffer_debug(const char *file, const char *func, int line, FinitePlaybackDevice *dev, uint32_t bufferUs, uint32_t periodUs) {
     if (!dev) {
-        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to init audio with NULL device");
-    } 
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to set buffer on NULL device");
+        return false;
+    }
 
-    snd_pcm_hw_params_get_buffer_size(dev->params, &dev->frames);
-    FINITE_LOG("Got audio device with size %ld", dev->frames);
+    if (dev->engineRunning && dev->isPlaying) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to change the buffer while playing");
+        return false;
+    }
 
-    snd_pcm_hw_params_get_period_size(dev->params, &dev->frames, 0);
-    size_t buf_size = dev->frames * dev->channels * sizeof(short);
-    dev->audioBuffer = malloc(buf_size);
+    if (bufferUs > 0 && periodUs > bufferUs / 2) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to use a %dus period in a %dus buffer (at least 2 periods are needed)", periodUs, bufferUs);
+        return false;
+    }
 
-    // clean up params
-    snd_pcm_hw_params_free(dev->params);
+    dev->buff_time = bufferUs;
+    dev->buff_per = periodUs;
 
-    short _read;
-    sf_count_t _frames = dev->frames;
-    dev->isPlaying = true;
-    dev->isPaused = false;
-    while (true) {
-        snd_pcm_state_t state = snd_pcm_state(dev->device);
-        if (state != SND_PCM_STATE_PAUSED && dev->isPlaying == true) {
-            if ((_read = sf_readf_short(dev->file, dev->audioBuffer, _frames)) == 0) {
+    // already set up, so apply it now. the ring is sized from the buffer so it has to go too.
+    if (dev->deviceRate != 0) {
+        if (dev->engineRunning) {
+            finite_audio_wait_debug(file, func, line, dev);
+        }
+        if (dev->ring.data) {
+            finite_audio_ring_free(&dev->ring);
+        }
+        return finite_audio_apply_hw_params(file, func, line, dev);
+    }
+
+    return true;
+}
+
+bool finite_audio_set_latency_debug(const char *file, const char *func, int line, FinitePlaybackDevice *dev, FiniteAudioLatency latency) {
+    switch (latency) {
+        case FINITE_AUDIO_LATENCY_LOW:
+            return finite_audio_set_buffer_debug(file, func, line, dev, 7500, 2500);
+        case FINITE_AUDIO_LATENCY_BALANCED:
+            return finite_audio_set_buffer_debug(file, func, line, dev, 40000, 10000);
+        case FINITE_AUDIO_LATENCY_POWER_SAVE:
+            return finite_audio_set_buffer_debug(file, func, line, dev, 200000, 50000);
+        default:
+            return finite_audio_set_buffer_debug(file, func, line, dev, 0, 0);
+    }
+}
+
+// wake anything sleeping on the engine. cheap when nobody is asleep.
+static void finite_audio_engine_wake(FinitePlaybackDevice *dev) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load(&dev->sleepers) > 0) {
+        pthread_mutex_lock(&dev->wakeLock);
+        pthread_cond_broadcast(&dev->wake);
+        pthread_mutex_unlock(&dev->wakeLock);
+    }
+}
+
+// sleep until ready() is true. the check happens after we're registered as a sleeper so a wake can't be lost.
+static void finite_audio_engine_sleep(FinitePlaybackDevice *dev, bool (*ready)(FinitePlaybackDevice *dev)) {
+    pthread_mutex_lock(&dev->wakeLock);
+    atomic_fetch_add(&dev->sleepers, 1);
+    while (!ready(dev)) {
+        pthread_cond_wait(&dev->wake, &dev->wakeLock);
+    }
+    atomic_fetch_sub(&dev->sleepers, 1);
+    pthread_mutex_unlock(&dev->wakeLock);
+}
+
+// for stop, pause and seek. also wakes whoever is waiting on the device in epoll_wait.
+static void finite_audio_engine_command(FinitePlaybackDevice *dev) {
+    finite_audio_engine_wake(dev);
+    uint64_t one = 1;
+    // this only fails if the counter is about to overflow, and then there's a wake pending anyway
+    ssize_t ret = write(dev->eventFd, &one, sizeof(one));
+    (void) ret;
+}
+
+static void finite_audio_engine_clear(FinitePlaybackDevice *dev) {
+    uint64_t count;
+    ssize_t ret = read(dev->eventFd, &count, sizeof(count));
+    (void) ret;
+}
+
+// puts the pcm's descriptors in pollFd. they can change with the hw params so this runs every time playback starts.
+static bool finite_audio_setup_poll(FinitePlaybackDevice *dev) {
+    for (int i = 0; i < dev->_pollFds; i++) {
+        epoll_ctl(dev->pollFd, EPOLL_CTL_DEL, dev->pollFds[i].fd, NULL);
+    }
+    dev->_pollFds = 0;
+
+    int count = snd_pcm_poll_descriptors_count(dev->device);
+    if (count <= 0) {
+        return false;
+    }
+
+    struct pollfd *fds = realloc(dev->pollFds, count * sizeof(struct pollfd));
+    if (!fds) {
+        return false;
+    }
+    dev->pollFds = fds;
+
+    count = snd_pcm_poll_descriptors(dev->device, fds, count);
+    for (int i = 0; i < count; i++) {
+        struct epoll_event event = { .events = fds[i].events, .data.fd = fds[i].fd };
+        if (epoll_ctl(dev->pollFd, EPOLL_CTL_ADD, fds[i].fd, &event) < 0) {
+            return false;
+        }
+        dev->_pollFds = i + 1;
+    }
+
+    return count > 0;
+}
+
+// a paused pcm still reports room in its buffer, so polled playback stops listening to it until it's unpaused
+static void finite_audio_poll_device(FinitePlaybackDevice *dev, bool enable) {
+    for (int i = 0; i < dev->_pollFds; i++) {
+        struct epoll_event event = { .events = enable ? dev->pollFds[i].events : 0, .data.fd = dev->pollFds[i].fd };
+        epoll_ctl(dev->pollFd, EPOLL_CTL_MOD, dev->pollFds[i].fd, &event);
+    }
+}
+
+// waits up to timeout ms for the device or a command. alsa gets to look at what woke us since some plugins
+// (dmix and friends) only clear their timers there.
+static int finite_audio_engine_poll(FinitePlaybackDevice *dev, int timeout) {
+    struct epoll_event events[8];
+    int count = epoll_wait(dev->pollFd, events, 8, timeout);
+    if (count < 0) {
+        return errno == EINTR ? 0 : -errno;
+    }
+
+    bool device = false;
+    for (int i = 0; i < dev->_pollFds; i++) {
+        dev->pollFds[i].revents = 0;
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (events[i].data.fd == dev->eventFd) {
+            finite_audio_engine_clear(dev);
+            continue;
+        }
+        for (int j = 0; j < dev->_pollFds; j++) {
+            if (dev->pollFds[j].fd == events[i].data.fd) {
+                dev->pollFds[j].revents = events[i].events;
+                device = true;
+            }
+        }
+    }
+
+    if (device) {
+        unsigned short revents;
+        int err = snd_pcm_poll_descriptors_revents(dev->device, dev->pollFds, dev->_pollFds, &revents);
+        if (err < 0) {
+            return err;
+        }
+    }
+
+    return 0;
+}
+
+// how long an engine thread waits on a device that's gone quiet before checking on it again
+static int finite_audio_poll_timeout(FinitePlaybackDevice *dev) {
+    if (dev->deviceRate == 0) {
+        return 100;
+    }
+    return (int) ((dev->bufferFrames * 2000) / dev->deviceRate) + 1;
+}
+
+static bool finite_audio_seek_pending(FinitePlaybackDevice *dev) {
+    return atomic_load(&dev->seekRequest) != atomic_load(&dev->decoderSeek);
+}
+
+static bool finite_audio_flush_pending(FinitePlaybackDevice *dev) {
+    return atomic_load(&dev->decoderSeek) != atomic_load(&dev->outputSeek);
+}
+
+static bool finite_audio_decoder_ready(FinitePlaybackDevice *dev) {
+    if (!dev->isPlaying || finite_audio_seek_pending(dev)) {
+        return true;
+    }
+    return !dev->decodeDone && finite_audio_ring_writable(&dev->ring) >= dev->frames;
+}
+
+static bool finite_audio_decoder_flushed(FinitePlaybackDevice *dev) {
+    return !dev->isPlaying || !finite_audio_flush_pending(dev);
+}
+
+static bool finite_audio_output_ready(FinitePlaybackDevice *dev) {
+    if (!dev->isPlaying || finite_audio_flush_pending(dev)) {
+        return true;
+    }
+    if (dev->isPaused) {
+        return false;
+    }
+    return dev->decodeDone || finite_audio_ring_readable(&dev->ring) > 0;
+}
+
+static bool finite_audio_pump_ready(FinitePlaybackDevice *dev) {
+    return !dev->isPlaying || finite_audio_seek_pending(dev) || !dev->isPaused;
+}
+
+static bool finite_audio_finished(FinitePlaybackDevice *dev) {
+    return !dev->isPlaying;
+}
+static uint64_t finite_audio_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void finite_audio_record_xrun(FinitePlaybackDevice *dev) {
+    FINITE_LOG_WARN("An underrun occurred.");
+    atomic_fetch_add_explicit(&dev->xruns, 1, memory_order_relaxed);
+    dev->lastWrite = 0;
+}
+
+// called right before each write with the frames the device has room for
+static void finite_audio_record_write(FinitePlaybackDevice *dev, snd_pcm_sframes_t avail) {
+    atomic_fetch_add_explicit(&dev->writes, 1, memory_order_relaxed);
+
+    if (avail >= 0 && (snd_pcm_uframes_t) avail <= dev->bufferFrames) {
+        snd_pcm_uframes_t fill = dev->bufferFrames - avail;
+        atomic_fetch_add_explicit(&dev->fillSum, fill, memory_order_relaxed);
+        if (fill < atomic_load_explicit(&dev->fillMin, memory_order_relaxed)) {
+            atomic_store_explicit(&dev->fillMin, fill, memory_order_relaxed);
+        }
+        if (fill > atomic_load_explicit(&dev->fillMax, memory_order_relaxed)) {
+            atomic_store_explicit(&dev->fillMax, fill, memory_order_relaxed);
+        }
+    }
+
+    if (dev->ring.data) {
+        size_t ringFill = finite_audio_ring_readable(&dev->ring);
+        atomic_fetch_add_explicit(&dev->ringFillSum, ringFill, memory_order_relaxed);
+        if (ringFill > atomic_load_explicit(&dev->ringFillMax, memory_order_relaxed)) {
+            atomic_store_explicit(&dev->ringFillMax, ringFill, memory_order_relaxed);
+        }
+    }
+
+    // while the device is still filling up writes don't wait on it, so only running counts
+    uint64_t now = finite_audio_now();
+    if (snd_pcm_state(dev->device) != SND_PCM_STATE_RUNNING) {
+        dev->lastWrite = 0;
+        return;
+    }
+
+    if (dev->lastWrite != 0 && dev->deviceRate != 0) {
+        uint64_t interval = now - dev->lastWrite;
+        uint64_t expected = ((uint64_t) dev->frames * 1000000000ull) / dev->deviceRate;
+        uint64_t jitter = interval > expected ? interval - expected : expected - interval;
+        atomic_fetch_add_explicit(&dev->jitterSum, jitter, memory_order_relaxed);
+        atomic_fetch_add_explicit(&dev->jitterSamples, 1, memory_order_relaxed);
+        if (jitter > atomic_load_explicit(&dev->jitterMax, memory_order_relaxed)) {
+            atomic_store_explicit(&dev->jitterMax, jitter, memory_order_relaxed);
+        }
+    }
+    dev->lastWrite = now;
+}
+
+// device frames to source frames
+static sf_count_t finite_audio_source_frames(FinitePlaybackDevice *dev, sf_count_t frames) {
+    if (dev->deviceRate == 0 || dev->deviceRate == dev->sample_rate) {
+        return frames;
+    }
+    return (frames * dev->sample_rate) / dev->deviceRate;
+}
+
+// publishes where the listener is in the file. delay is in device frames. readers use positionSeq to get a consistent copy.
+static void finite_audio_publish_position(FinitePlaybackDevice *dev, snd_pcm_sframes_t delay) {
+    sf_count_t frame = dev->writePosition - finite_audio_source_frames(dev, delay);
+    if (frame < 0) {
+        frame = 0;
+    }
+
+    uint64_t now = finite_audio_now();
+
+    atomic_fetch_add_explicit(&dev->positionSeq, 1, memory_order_acq_rel);
+    atomic_store_explicit(&dev->positionFrame, frame, memory_order_relaxed);
+    atomic_store_explicit(&dev->positionLimit, dev->writePosition, memory_order_relaxed);
+    atomic_store_explicit(&dev->positionTime, now, memory_order_relaxed);
+    atomic_fetch_add_explicit(&dev->positionSeq, 1, memory_order_release);
+}
+
+static sf_count_t finite_audio_read_source(FinitePlaybackDevice *dev, short *out, size_t frames) {
+    if (dev->fill) {
+        return dev->fill(dev, out, frames, dev->fillData);
+    }
+
+    sf_count_t _read = sf_readf_short(dev->file, out, frames);
+    if (dev->stream) {
+        finite_audio_stream_prefetch(dev->stream);
+    }
+    return _read;
+}
+
+static void finite_audio_reset_decode(FinitePlaybackDevice *dev) {
+    if (dev->resampler) {
+        finite_audio_resampler_reset(dev->resampler);
+    }
+    dev->decodeLen = 0;
+    dev->decodeOffset = 0;
+    dev->sourceDone = false;
+}
+
+// fills out with frames at the device's rate. returns 0 once the source and the resampler's tail are used up.
+static sf_count_t finite_audio_decode(FinitePlaybackDevice *dev, short *out, size_t frames) {
+    if (!dev->resampler) {
+        return finite_audio_read_source(dev, out, frames);
+    }
+
+    size_t produced = 0;
+    while (produced < frames) {
+        if (dev->decodeOffset == dev->decodeLen && !dev->sourceDone) {
+            sf_count_t _read = finite_audio_read_source(dev, dev->decodeBuffer, dev->decodeCap);
+            dev->decodeOffset = 0;
+            dev->decodeLen = _read > 0 ? (size_t) _read : 0;
+            dev->sourceDone = _read <= 0;
+        }
+
+        size_t outFrames = frames - produced;
+        if (dev->decodeOffset < dev->decodeLen) {
+            size_t inFrames = dev->decodeLen - dev->decodeOffset;
+            finite_audio_resampler_process_s16(dev->resampler, dev->decodeBuffer + (dev->decodeOffset * dev->channels), &inFrames, out + (produced * dev->channels), &outFrames);
+            dev->decodeOffset += inFrames;
+        } else {
+            outFrames = finite_audio_resampler_drain_s16(dev->resampler, out + (produced * dev->channels), outFrames);
+            if (outFrames == 0) {
                 break;
             }
+        }
+        produced += outFrames;
+    }
+
+    return produced;
+}
+
+static void *finite_audio_decode_worker(void *data) {
+    FinitePlaybackDevice *dev = data;
+
+    while (dev->isPlaying) {
+        if (finite_audio_seek_pending(dev)) {
+            uint32_t request = atomic_load(&dev->seekRequest);
+            sf_count_t result = sf_seek(dev->file, atomic_load(&dev->seekTarget), SEEK_SET);
+            if (result < 0) {
+                FINITE_LOG_WARN("Unable to seek %s (%s)", dev->filename, sf_strerror(dev->file));
+            }
+
+            // park until the output thread has thrown away everything we decoded before the seek
+            finite_audio_reset_decode(dev);
+            dev->decodeDone = false;
+            atomic_store(&dev->seekResult, result);
+            atomic_store(&dev->decoderSeek, request);
+            finite_audio_engine_wake(dev);
+            finite_audio_engine_sleep(dev, finite_audio_decoder_flushed);
+            continue;
+        }
+
+        size_t space;
+        short *dst = finite_audio_ring_write_begin(&dev->ring, &space);
+        if (space == 0 || dev->decodeDone) {
+            // at the end of the file we stay around in case the caller seeks back
+            finite_audio_engine_sleep(dev, finite_audio_decoder_ready);
+            continue;
+        }
+
+        sf_count_t _read = finite_audio_decode(dev, dst, space);
+
+        if (_read <= 0) {
+            dev->decodeDone = true;
+            finite_audio_engine_wake(dev);
+            continue;
+        }
+
+        finite_audio_ring_write_commit(&dev->ring, _read);
+        finite_audio_engine_wake(dev);
+    }
+
+    return NULL;
+}
+
+// the pcm counts device frames but writePosition is in source frames, so count both from the last seek
+static void finite_audio_advance(FinitePlaybackDevice *dev, snd_pcm_sframes_t frames) {
+    dev->written += frames;
+    dev->writePosition = dev->writeBase + finite_audio_source_frames(dev, dev->written);
+    snd_pcm_sframes_t delay = 0;
+    if (snd_pcm_delay(dev->device, &delay) < 0 || delay < 0) {
+        delay = 0;
+    }
+    finite_audio_publish_position(dev, delay);
+}
+
+static void finite_audio_apply_pause(FinitePlaybackDevice *dev) {
+    dev->pcmPaused = dev->isPaused;
+    // not every device can pause in hardware. then whatever's queued is thrown away so it can't underrun.
+    if (snd_pcm_pause(dev->device, dev->pcmPaused ? 1 : 0) < 0) {
+        snd_pcm_drop(dev->device);
+        snd_pcm_prepare(dev->device);
+    }
+    if (dev->polled) {
+        finite_audio_poll_device(dev, !dev->pcmPaused);
+    }
+    finite_audio_publish_position(dev, 0);
+    dev->lastWrite = 0;
+}
+
+// ends a run on whichever thread owns the pcm
+static void finite_audio_finish(FinitePlaybackDevice *dev, bool drain) {
+    if (drain) {
+        FINITE_LOG("Read succesfully. Audio %s has %d channel(s) with a sample rate of %d", dev->filename ? dev->filename : dev->name, dev->channels, dev->sample_rate);
+        // the pcm is nonblocking while we play but this drain should wait
+        snd_pcm_nonblock(dev->device, 0);
+        snd_pcm_drain(dev->device);
+    } else {
+        snd_pcm_drop(dev->device);
+    }
+
+    finite_audio_publish_position(dev, 0);
+    dev->polled = false;
+    dev->draining = false;
+    dev->isPlaying = false;
+    dev->isPaused = false;
+    finite_audio_engine_wake(dev);
+}
 
-            int pcm_data = snd_pcm_writei(dev->device, dev->audioBuffer, _read);
-            if (pcm_data == -EPIPE) {
-                finite_log_internal(LOG_LEVEL_WARN, file, line, func, "An underrun occurred.");
+static void *finite_audio_output_worker(void *data) {
+    FinitePlaybackDevice *dev = data;
+    bool drained = false;
+    int timeout = finite_audio_poll_timeout(dev);
+
+    while (dev->isPlaying) {
+        if (finite_audio_flush_pending(dev)) {
+            uint32_t request = atomic_load(&dev->decoderSeek);
+            sf_count_t result = atomic_load(&dev->seekResult);
+            if (result >= 0) {
+                // the decoder is parked so everything in the ring is from before the seek
+                snd_pcm_drop(dev->device);
                 snd_pcm_prepare(dev->device);
-            } else if (pcm_data < 0) {
-                finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to write to device %s", snd_strerror(pcm_data));
-            } else if (pcm_data != _read) {
-                finite_log_internal(LOG_LEVEL_FATAL, file, line, func, "Write data does not match read data.");
+                finite_audio_ring_read_commit(&dev->ring, finite_audio_ring_readable(&dev->ring));
+                dev->writeBase = result;
+                dev->written = 0;
+                dev->writePosition = result;
+                finite_audio_publish_position(dev, 0);
+            }
+
+            atomic_store(&dev->outputSeek, request);
+            finite_audio_engine_wake(dev);
+            continue;
+        }
+
+        if (dev->isPaused != dev->pcmPaused) {
+            finite_audio_apply_pause(dev);
+            continue;
+        }
+
+        size_t avail;
+        const short *src = finite_audio_ring_read_begin(&dev->ring, &avail);
+        if (avail == 0 || dev->pcmPaused) {
+            if (avail == 0 && dev->decodeDone && !dev->pcmPaused) {
+                drained = true;
+                break;
+            }
+            finite_audio_engine_sleep(dev, finite_audio_output_ready);
+            continue;
+        }
+
+        if (avail > dev->frames) {
+            avail = dev->frames;
+        }
+
+        snd_pcm_sframes_t room = snd_pcm_avail_update(dev->device);
+        if (room >= 0 && (snd_pcm_uframes_t) room < avail) {
+            // the buffer is as full as it gets. sleep until a period plays out or a command comes in.
+            if (snd_pcm_state(dev->device) == SND_PCM_STATE_PREPARED) {
+                snd_pcm_start(dev->device);
+            }
+            int err = finite_audio_engine_poll(dev, timeout);
+            if (err < 0 && snd_pcm_recover(dev->device, err, 1) < 0) {
+                FINITE_LOG_ERROR("Unable to wait on device %s", snd_strerror(err));
+                break;
+            }
+            continue;
+        }
+
+        finite_audio_record_write(dev, room);
+        snd_pcm_sframes_t pcm_data = snd_pcm_writei(dev->device, src, avail);
+        if (pcm_data == -EAGAIN) {
+            continue;
+        } else if (pcm_data == -EPIPE) {
+            finite_audio_record_xrun(dev);
+            snd_pcm_prepare(dev->device);
+            continue;
+        } else if (pcm_data < 0) {
+            if (snd_pcm_recover(dev->device, pcm_data, 1) < 0) {
+                FINITE_LOG_ERROR("Unable to write to device %s", snd_strerror(pcm_data));
+                break;
+            }
+            continue;
+        }
+
+        finite_audio_ring_read_commit(&dev->ring, pcm_data);
+        finite_audio_engine_wake(dev);
+        finite_audio_advance(dev, pcm_data);
+    }
+
+    finite_audio_finish(dev, drained);
+    return NULL;
+}
+
+// what a pump step wants to happen next
+enum {
+    FINITE_AUDIO_PUMP_MORE, // call again right away
+    FINITE_AUDIO_PUMP_WAIT, // nothing to do until pollFd wakes up
+    FINITE_AUDIO_PUMP_DONE, // the source has ended, drain the device
+    FINITE_AUDIO_PUMP_FAILED
+};
+
+static int finite_audio_pump_recover(FinitePlaybackDevice *dev, int err) {
+    if (err == -EPIPE) {
+        finite_audio_record_xrun(dev);
+    }
+    if (snd_pcm_recover(dev->device, err, 1) < 0) {
+        FINITE_LOG_ERROR("Unable to recover device %s", snd_strerror(err));
+        return FINITE_AUDIO_PUMP_FAILED;
+    }
+    return FINITE_AUDIO_PUMP_MORE;
+}
+
+// there's no decode thread when pumping so seeks are handled right here
+static void finite_audio_pump_seek(FinitePlaybackDevice *dev) {
+    uint32_t request = atomic_load(&dev->seekRequest);
+    sf_count_t result = sf_seek(dev->file, atomic_load(&dev->seekTarget), SEEK_SET);
+    if (result < 0) {
+        FINITE_LOG_WARN("Unable to seek %s (%s)", dev->filename, sf_strerror(dev->file));
+    } else {
+        snd_pcm_drop(dev->device);
+        snd_pcm_prepare(dev->device);
+        if (dev->ring.data) {
+            finite_audio_ring_reset(&dev->ring);
+        }
+        finite_audio_reset_decode(dev);
+        dev->decodeDone = false;
+        dev->draining = false;
+        dev->writeBase = result;
+        dev->written = 0;
+        dev->writePosition = result;
+        finite_audio_publish_position(dev, 0);
+    }
+
+    atomic_store(&dev->seekResult, result);
+    atomic_store(&dev->decoderSeek, request);
+    atomic_store(&dev->outputSeek, request);
+}
+
+// one step of single threaded playback, used by mmap mode and by polled playback. it never blocks.
+// in mmap mode the source decodes (or the mixer mixes) right into the device's buffer so nothing is copied per period.
+// otherwise the ring is only a staging buffer for snd_pcm_writei.
+static int finite_audio_pump(FinitePlaybackDevice *dev) {
+    if (finite_audio_seek_pending(dev)) {
+        finite_audio_pump_seek(dev);
+        return FINITE_AUDIO_PUMP_MORE;
+    }
+
+    if (dev->isPaused != dev->pcmPaused) {
+        finite_audio_apply_pause(dev);
+        return FINITE_AUDIO_PUMP_MORE;
+    }
+
+    if (dev->pcmPaused) {
+        return FINITE_AUDIO_PUMP_WAIT;
+    }
+
+    size_t ready = 0;
+    const short *src = dev->ring.data ? finite_audio_ring_read_begin(&dev->ring, &ready) : NULL;
+    if (dev->decodeDone && ready == 0) {
+        return FINITE_AUDIO_PUMP_DONE;
+    }
+
+    snd_pcm_sframes_t avail = snd_pcm_avail_update(dev->device);
+    if (avail < 0) {
+        return finite_audio_pump_recover(dev, avail);
+    }
+
+    if ((snd_pcm_uframes_t) avail < dev->frames) {
+        // the buffer is full. mmap writes never start the pcm on their own.
+        if (snd_pcm_state(dev->device) == SND_PCM_STATE_PREPARED) {
+            snd_pcm_start(dev->device);
+        }
+        return FINITE_AUDIO_PUMP_WAIT;
+    }
+
+    snd_pcm_sframes_t committed;
+    if (dev->useMmap) {
+        const snd_pcm_channel_area_t *areas;
+        snd_pcm_uframes_t offset;
+        snd_pcm_uframes_t frames = avail;
+        int err = snd_pcm_mmap_begin(dev->device, &areas, &offset, &frames);
+        if (err < 0) {
+            return finite_audio_pump_recover(dev, err);
+        }
+
+        finite_audio_record_write(dev, avail);
+        short *dst = (short *) ((char *) areas[0].addr + (areas[0].first / 8) + (offset * (areas[0].step / 8)));
+        sf_count_t _read = finite_audio_decode(dev, dst, frames);
+        if (_read <= 0) {
+            snd_pcm_mmap_commit(dev->device, offset, 0);
+            dev->decodeDone = true;
+            return FINITE_AUDIO_PUMP_MORE;
+        }
+
+        committed = snd_pcm_mmap_commit(dev->device, offset, _read);
+        if (committed < 0 || committed != _read) {
+            return finite_audio_pump_recover(dev, committed >= 0 ? -EPIPE : committed);
+        }
+    } else {
+        if (ready == 0) {
+            size_t space;
+            short *dst = finite_audio_ring_write_begin(&dev->ring, &space);
+            if (space > (size_t) avail) {
+                space = avail;
+            }
+
+            sf_count_t _read = finite_audio_decode(dev, dst, space);
+            if (_read <= 0) {
+                dev->decodeDone = true;
+                return FINITE_AUDIO_PUMP_MORE;
+            }
+
+            finite_audio_ring_write_commit(&dev->ring, _read);
+            src = finite_audio_ring_read_begin(&dev->ring, &ready);
+        }
+
+        if (ready > (size_t) avail) {
+            ready = avail;
+        }
+
+        finite_audio_record_write(dev, avail);
+        committed = snd_pcm_writei(dev->device, src, ready);
+        if (committed == -EAGAIN) {
+            return FINITE_AUDIO_PUMP_WAIT;
+        } else if (committed < 0) {
+            return finite_audio_pump_recover(dev, committed);
+        }
+        finite_audio_ring_read_commit(&dev->ring, committed);
+    }
+
+    finite_audio_advance(dev, committed);
+    return FINITE_AUDIO_PUMP_MORE;
+}
+
+static void *finite_audio_pump_worker(void *data) {
+    FinitePlaybackDevice *dev = data;
+    bool drained = false;
+    int timeout = finite_audio_poll_timeout(dev);
+
+    while (dev->isPlaying) {
+        int step = finite_audio_pump(dev);
+        if (step == FINITE_AUDIO_PUMP_WAIT) {
+            if (dev->pcmPaused) {
+                finite_audio_engine_sleep(dev, finite_audio_pump_ready);
+                continue;
+            }
+            int err = finite_audio_engine_poll(dev, timeout);
+            if (err < 0 && snd_pcm_recover(dev->device, err, 1) < 0) {
+                FINITE_LOG_ERROR("Unable to wait on device %s", snd_strerror(err));
+                break;
             }
-        } else if (dev->isPlaying == false) {
+        } else if (step == FINITE_AUDIO_PUMP_DONE) {
+            drained = true;
+            break;
+        } else if (step == FINITE_AUDIO_PUMP_FAILED) {
             break;
         }
     }
 
-    FINITE_LOG("Read succesfully. Audio file %s has %d channel(s) with a sample rate of %d", dev->filename, dev->channels, dev->sample_rate);
-    snd_pcm_drain(dev->device);
+    finite_audio_finish(dev, drained);
+    return NULL;
+}
+
+// everything a fresh run needs whichever way it's driven
+static bool finite_audio_engine_prepare(const char *file, const char *func, int line, FinitePlaybackDevice *dev) {
+    snd_pcm_uframes_t bufferSize;
+    snd_pcm_hw_params_get_buffer_size(dev->params, &bufferSize);
+    finite_log_internal(LOG_LEVEL_DEBUG, file, line, func, "Got audio device with size %ld", bufferSize);
+
+    snd_pcm_hw_params_get_period_size(dev->params, &dev->frames, 0);
+    finite_audio_reset_stats(dev);
+
+    if (!finite_audio_setup_poll(dev)) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to poll device %s", dev->name);
+        return false;
+    }
+
+    // the last run's drain or drop leaves the pcm in SETUP, where every write fails with -EBADFD
+    int err = snd_pcm_prepare(dev->device);
+    if (err < 0) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to prepare device %s (%s)", dev->name, snd_strerror(err));
+        return false;
+    }
+
+    // writes never block. the engine sleeps in epoll_wait instead so commands can wake it.
+    snd_pcm_nonblock(dev->device, 1);
+
+    if (!dev->useMmap && !dev->ring.data) {
+        // let the decoder run a few device buffers ahead so storage hiccups don't reach the device
+        size_t ringFrames = dev->ringFrames;
+        if (ringFrames == 0 && dev->aheadSeconds > 0) {
+            ringFrames = (size_t) (dev->aheadSeconds * dev->deviceRate);
+        }
+        if (ringFrames == 0) {
+            ringFrames = bufferSize * 4 > 16384 ? bufferSize * 4 : 16384;
+        }
+
+        if (!finite_audio_ring_init_debug(file, func, line, &dev->ring, ringFrames, dev->channels)) {
+            return false;
+        }
+    }
+
+    if (dev->ring.data) {
+        finite_audio_ring_reset(&dev->ring);
+    }
+    finite_audio_reset_decode(dev);
+    finite_audio_engine_clear(dev);
+    // any seek made while stopped has already been applied to the file
+    atomic_store(&dev->decoderSeek, atomic_load(&dev->seekRequest));
+    atomic_store(&dev->outputSeek, atomic_load(&dev->seekRequest));
+    dev->writeBase = dev->writePosition;
+    dev->written = 0;
+    dev->decodeDone = false;
+    dev->draining = false;
+    dev->pcmPaused = false;
+    dev->isPaused = false;
+    return true;
+}
+
+// starts the engine and returns right away. use finite_audio_wait() or isPlaying to know when it's done.
+bool finite_audio_play_async_debug(const char *file, const char *func, int line, FinitePlaybackDevice *dev) {
+    if (!dev) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to play audio with NULL device");
+        return false;
+    }
+
+    if (dev->engineRunning || dev->polled) {
+        if (dev->isPlaying) {
+            finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to play audio that is already playing.");
+            return false;
+        }
+        // the last run finished on its own, reap its threads first
+        finite_audio_wait_debug(file, func, line, dev);
+    }
+
+    if (!finite_audio_engine_prepare(file, func, line, dev)) {
+        return false;
+    }
+
+    dev->isPlaying = true;
+
+    if (dev->useMmap) {
+        if (pthread_create(&dev->output, NULL, finite_audio_pump_worker, dev) != 0) {
+            finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to start the output thread");
+            dev->isPlaying = false;
+            return false;
+        }
+
+        dev->engineRunning = true;
+        return true;
+    }
+
+    if (pthread_create(&dev->decoder, NULL, finite_audio_decode_worker, dev) != 0) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to start the decode thread");
+        dev->isPlaying = false;
+        return false;
+    }
+
+    if (pthread_create(&dev->output, NULL, finite_audio_output_worker, dev) != 0) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to start the output thread");
+        dev->isPlaying = false;
+        finite_audio_engine_wake(dev);
+        pthread_join(dev->decoder, NULL);
+        return false;
+    }
+
+    dev->engineRunning = true;
+    return true;
+}
+
+bool finite_audio_play_polled_debug(const char *file, const char *func, int line, FinitePlaybackDevice *dev) {
+    if (!dev) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to play audio with NULL device");
+        return false;
+    }
+
+    if (dev->isPlaying) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to play audio that is already playing.");
+        return false;
+    }
+
+    if (dev->engineRunning || dev->polled) {
+        finite_audio_wait_debug(file, func, line, dev);
+    }
+
+    if (!finite_audio_engine_prepare(file, func, line, dev)) {
+        return false;
+    }
+
+    dev->polled = true;
+    dev->isPlaying = true;
+    return true;
+}
+
+bool finite_audio_service(FinitePlaybackDevice *dev) {
+    if (!dev || !dev->polled) {
+        return false;
+    }
+
+    // doesn't block, it just clears the command counter and lets alsa see what woke the caller
+    int err = finite_audio_engine_poll(dev, 0);
+    if (err < 0 && snd_pcm_recover(dev->device, err, 1) < 0) {
+        FINITE_LOG_ERROR("Unable to poll device %s", snd_strerror(err));
+        finite_audio_finish(dev, false);
+        return false;
+    }
+
+    if (!dev->isPlaying) {
+        finite_audio_finish(dev, false);
+        return false;
+    }
+
+    if (dev->draining) {
+        if (snd_pcm_state(dev->device) == SND_PCM_STATE_DRAINING) {
+            return true;
+        }
+        finite_audio_finish(dev, false);
+        return false;
+    }
+
+    while (true) {
+        switch (finite_audio_pump(dev)) {
+            case FINITE_AUDIO_PUMP_MORE:
+                continue;
+            case FINITE_AUDIO_PUMP_WAIT:
+                return true;
+            case FINITE_AUDIO_PUMP_DONE:
+                FINITE_LOG("Read succesfully. Audio %s has %d channel(s) with a sample rate of %d", dev->filename ? dev->filename : dev->name, dev->channels, dev->sample_rate);
+                // a nonblocking drain returns right away. the pcm wakes the loop again once it's empty.
+                snd_pcm_drain(dev->device);
+                dev->draining = true;
+                return true;
+            default:
+                finite_audio_finish(dev, false);
+                return false;
+        }
+    }
+}
+
+int finite_audio_get_fd(FinitePlaybackDevice *dev) {
+    return dev ? dev->pollFd : -1;
+}
+
+// blocks the caller until playback has finished or was stopped. the caller sleeps the whole time.
+void finite_audio_wait_debug(const char *file, const char *func, int line, FinitePlaybackDevice *dev) {
+    if (!dev) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to wait on NULL device");
+        return;
+    }
+
+    if (dev->polled) {
+        // polled playback has no threads to wait on. this only tidies up a run that was stopped and not serviced since.
+        if (!dev->isPlaying) {
+            finite_audio_finish(dev, false);
+        }
+        return;
+    }
+
+    if (!dev->engineRunning) {
+        return;
+    }
+
+    finite_audio_engine_sleep(dev, finite_audio_finished);
+    pthread_join(dev->output, NULL);
+    if (!dev->useMmap) {
+        pthread_join(dev->decoder, NULL);
+    }
+    dev->engineRunning = false;
+}
+
+void finite_audio_play_debug(const char *file, const char *func, int line, FinitePlaybackDevice *dev) {
+    if (!finite_audio_play_async_debug(file, func, line, dev)) {
+        return;
+    }
+
+    finite_audio_wait_debug(file, func, line, dev);
+}
+
+// moves playback to frame without reopening the file or the device. frame is counted from the start of the file.
+bool finite_audio_seek_debug(const char *file, const char *func, int line, FinitePlaybackDevice *dev, sf_count_t frame) {
+    if (!dev || !dev->file) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to seek NULL device or a device without a file");
+        return false;
+    }
+
+    if (frame < 0 || (dev->sfFrames > 0 && frame > dev->sfFrames)) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to seek to frame %ld (file has %ld frames)", (long) frame, (long) dev->sfFrames);
+        return false;
+    }
+
+    if ((dev->engineRunning || dev->polled) && !dev->isPlaying) {
+        finite_audio_wait_debug(file, func, line, dev);
+    }
+
+    if (!dev->engineRunning && !dev->polled) {
+        // nothing else is touching the file so seek right here
+        if (sf_seek(dev->file, frame, SEEK_SET) < 0) {
+            finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to seek %s (%s)", dev->filename, sf_strerror(dev->file));
+            return false;
+        }
+
+        dev->writePosition = frame;
+        finite_audio_publish_position(dev, 0);
+        return true;
+    }
+
+    atomic_store(&dev->seekTarget, frame);
+    atomic_fetch_add(&dev->seekRequest, 1);
+    finite_audio_engine_command(dev);
+    return true;
+}
+
+// the position of the frame the listener is hearing right now
+sf_count_t finite_audio_get_position_debug(const char *file, const char *func, int line, FinitePlaybackDevice *dev) {
+    if (!dev) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to get position of NULL device");
+        return -1;
+    }
+
+    uint32_t seq;
+    sf_count_t frame, limit;
+    uint64_t time;
+    do {
+        seq = atomic_load_explicit(&dev->positionSeq, memory_order_acquire);
+        frame = atomic_load_explicit(&dev->positionFrame, memory_order_relaxed);
+        limit = atomic_load_explicit(&dev->positionLimit, memory_order_relaxed);
+        time = atomic_load_explicit(&dev->positionTime, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+    } while ((seq & 1) || seq != atomic_load_explicit(&dev->positionSeq, memory_order_relaxed));
+
+    if (dev->isPlaying && !dev->isPaused && dev->sample_rate > 0) {
+        // the device keeps playing between updates so move forward by the time that's passed
+        uint64_t now = finite_audio_now();
+        if (now > time) {
+            frame += (sf_count_t) (((now - time) * dev->sample_rate) / 1000000000ull);
+        }
+        if (frame > limit) {
+            frame = limit;
+        }
+    }
+
+    return frame;
+}
+
+void finite_audio_reset_stats(FinitePlaybackDevice *dev) {
+    atomic_store_explicit(&dev->xruns, 0, memory_order_relaxed);
+    atomic_store_explicit(&dev->writes, 0, memory_order_relaxed);
+    atomic_store_explicit(&dev->fillSum, 0, memory_order_relaxed);
+    atomic_store_explicit(&dev->fillMin, (snd_pcm_uframes_t) -1, memory_order_relaxed);
+    atomic_store_explicit(&dev->fillMax, 0, memory_order_relaxed);
+    atomic_store_explicit(&dev->ringFillSum, 0, memory_order_relaxed);
+    atomic_store_explicit(&dev->ringFillMax, 0, memory_order_relaxed);
+    atomic_store_explicit(&dev->jitterSum, 0, memory_order_relaxed);
+    atomic_store_explicit(&dev->jitterMax, 0, memory_order_relaxed);
+    atomic_store_explicit(&dev->jitterSamples, 0, memory_order_relaxed);
+}
+
+// the counters are read one at a time so a snapshot taken mid write can be off by one write
+bool finite_audio_get_stats_debug(const char *file, const char *func, int line, FinitePlaybackDevice *dev, FiniteAudioStats *stats) {
+    if (!dev || !stats) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to get stats with NULL device or stats");
+        return false;
+    }
+
+    uint64_t writes = atomic_load_explicit(&dev->writes, memory_order_relaxed);
+    uint64_t jitterSamples = atomic_load_explicit(&dev->jitterSamples, memory_order_relaxed);
+
+    stats->xruns = atomic_load_explicit(&dev->xruns, memory_order_relaxed);
+    stats->writes = writes;
+    stats->bufferFrames = dev->bufferFrames;
+    stats->periodFrames = dev->frames;
+    stats->fillMin = writes > 0 ? atomic_load_explicit(&dev->fillMin, memory_order_relaxed) : 0;
+    stats->fillMax = atomic_load_explicit(&dev->fillMax, memory_order_relaxed);
+    stats->fillAvg = writes > 0 ? (double) atomic_load_explicit(&dev->fillSum, memory_order_relaxed) / writes : 0.0;
+    stats->ringFillMax = atomic_load_explicit(&dev->ringFillMax, memory_order_relaxed);
+    stats->ringFillAvg = writes > 0 ? (double) atomic_load_explicit(&dev->ringFillSum, memory_order_relaxed) / writes : 0.0;
+    stats->jitterAvgUs = jitterSamples > 0 ? (double) atomic_load_explicit(&dev->jitterSum, memory_order_relaxed) / jitterSamples / 1000.0 : 0.0;
+    stats->jitterMaxUs = atomic_load_explicit(&dev->jitterMax, memory_order_relaxed) / 1000.0;
+    return true;
 }
 
 bool finite_audio_stop_debug(const char *file, const char *func, int line, FinitePlaybackDevice *dev) {
@@ -199,9 +1368,9 @@ bool finite_audio_stop_debug(const char *file, const char *func, int line, Finit
         return false;
     }
 
+    // the output thread drops the pcm itself so we never touch the device from two threads
     dev->isPlaying = false;
-
-    snd_pcm_drop(dev->device);
+    finite_audio_engine_command(dev);
     return true;
 }
 
@@ -216,13 +1385,8 @@ bool finite_audio_pause_debug(const char *file, const char *func, int line, Fini
         return false;
     }
 
-    if (dev->isPaused == true) {
-        snd_pcm_pause(dev->device, 0);
-        dev->isPaused = false;
-    } else {
-        snd_pcm_pause(dev->device, 1);
-        dev->isPaused = true;
-    }
+    dev->isPaused = !dev->isPaused;
+    finite_audio_engine_command(dev);
     return true;
 }
 
@@ -237,7 +1401,8 @@ bool finite_audio_unpause_debug(const char *file, const char *func, int line, Fi
         return false;
     }
 
-    snd_pcm_pause(dev->device, 0);
+    dev->isPaused = false;
+    finite_audio_engine_command(dev);
     return true;
 }
 
@@ -245,13 +1410,36 @@ void finite_audio_cleanup_debug(const char *file, const char *func, int line, Fi
     if (!dev) {
         finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to cleanup NULL device");
     } else {
-        if (dev->audioBuffer) {
+        if (dev->engineRunning || dev->polled) {
+            dev->isPlaying = false;
+            finite_audio_engine_command(dev);
+            finite_audio_wait_debug(file, func, line, dev);
+        }
+        if (dev->ring.data) {
+            finite_audio_ring_free(&dev->ring);
+        }
+        if (dev->resampler) {
+            finite_audio_resampler_destroy_debug(file, func, line, dev->resampler);
+        }
+        free(dev->decodeBuffer);
+        if (dev->params) {
+            snd_pcm_hw_params_free(dev->params);
+        }
+        if (dev->device) {
             snd_pcm_close(dev->device);
-            free(dev->audioBuffer);
         }
         if (dev->file) {
             sf_close(dev->file);
         }
+        if (dev->stream) {
+            finite_audio_stream_destroy_debug(file, func, line, dev->stream);
+        }
+        close(dev->pollFd);
+        close(dev->eventFd);
+        free(dev->pollFds);
+        pthread_cond_destroy(&dev->wake);
+        pthread_mutex_destroy(&dev->wakeLock);
+        free(dev->name);
         free(dev);
     }
 }
\ No newline at end of file
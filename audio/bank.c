@@ -0,0 +1,225 @@
+#include "../include/audio/audio-bank.h"
+#include "../include/audio/audio-resample.h"
+#include "../include/log.h"
+#include <string.h>
+
+static short *finite_audio_bank_alloc(size_t samples) {
+    size_t bytes = ((samples * sizeof(short)) + 63) & ~(size_t) 63;
+    return aligned_alloc(64, bytes > 0 ? bytes : 64);
+}
+
+// runs the whole clip through the high quality resampler. this only happens at load time.
+static short *finite_audio_bank_resample(const short *src, size_t frames, uint32_t channels, uint32_t from, uint32_t to, size_t *outFrames) {
+    FiniteAudioResampler *rs = finite_audio_resampler_create(from, to, channels, FINITE_AUDIO_RESAMPLE_HIGH);
+    if (!rs) {
+        return NULL;
+    }
+
+    size_t out = finite_audio_resampler_get_output_frames(rs, frames);
+    short *dst = finite_audio_bank_alloc(out * channels);
+    if (!dst) {
+        finite_audio_resampler_destroy(rs);
+        return NULL;
+    }
+
+    size_t inFrames = frames;
+    size_t produced = out;
+    finite_audio_resampler_process_s16(rs, src, &inFrames, dst, &produced);
+    while (produced < out) {
+        size_t tail = finite_audio_resampler_drain_s16(rs, dst + (produced * channels), out - produced);
+        if (tail == 0) {
+            break;
+        }
+        produced += tail;
+    }
+    finite_audio_resampler_destroy(rs);
+
+    *outFrames = produced;
+    return dst;
+}
+
+// reads every frame of the file and keeps at most the first two channels
+static short *finite_audio_bank_decode(SNDFILE *snd, SF_INFO *info, uint32_t channels, size_t *outFrames) {
+    size_t capacity = info->frames > 0 ? (size_t) info->frames : 44100;
+    short *raw = malloc(capacity * info->channels * sizeof(short));
+    if (!raw) {
+        return NULL;
+    }
+
+    size_t frames = 0;
+    while (true) {
+        if (frames == capacity) {
+            // some formats don't report their length up front
+            capacity *= 2;
+            short *tmp = realloc(raw, capacity * info->channels * sizeof(short));
+            if (!tmp) {
+                free(raw);
+                return NULL;
+            }
+            raw = tmp;
+        }
+
+        sf_count_t got = sf_readf_short(snd, raw + (frames * info->channels), capacity - frames);
+        if (got <= 0) {
+            break;
+        }
+        frames += got;
+    }
+
+    short *pcm = finite_audio_bank_alloc(frames * channels);
+    if (!pcm) {
+        free(raw);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < frames; i++) {
+        for (uint32_t c = 0; c < channels; c++) {
+            pcm[i * channels + c] = raw[i * info->channels + c];
+        }
+    }
+
+    free(raw);
+    *outFrames = frames;
+    return pcm;
+}
+
+FiniteAudioBank *finite_audio_bank_create_debug(const char *file, const char *func, int line, uint32_t sampleRate) {
+    FiniteAudioBank *bank = calloc(1, sizeof(FiniteAudioBank));
+    if (!bank) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to create sound bank (no memory available)");
+        return NULL;
+    }
+
+    bank->sampleRate = sampleRate;
+    return bank;
+}
+
+FiniteAudioClipHandle finite_audio_bank_find_debug(const char *file, const char *func, int line, FiniteAudioBank *bank, const char *path) {
+    if (!bank || !path) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to search NULL bank or path");
+        return FINITE_AUDIO_CLIP_NONE;
+    }
+
+    for (uint32_t i = 0; i < bank->_clips; i++) {
+        if (strcmp(bank->clips[i].name, path) == 0) {
+            return i + 1;
+        }
+    }
+
+    return FINITE_AUDIO_CLIP_NONE;
+}
+
+FiniteAudioClipHandle finite_audio_bank_load_debug(const char *file, const char *func, int line, FiniteAudioBank *bank, const char *path) {
+    if (!bank || !path) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to load clip into NULL bank or from NULL path");
+        return FINITE_AUDIO_CLIP_NONE;
+    }
+
+    FiniteAudioClipHandle existing = finite_audio_bank_find_debug(file, func, line, bank, path);
+    if (existing != FINITE_AUDIO_CLIP_NONE) {
+        return existing;
+    }
+
+    SF_INFO info = {0};
+    SNDFILE *snd = sf_open(path, SFM_READ, &info);
+    if (!snd) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to open clip at %s (%s)", path, sf_strerror(NULL));
+        return FINITE_AUDIO_CLIP_NONE;
+    }
+
+    uint32_t channels = info.channels > 2 ? 2 : info.channels;
+    size_t frames = 0;
+    short *pcm = finite_audio_bank_decode(snd, &info, channels, &frames);
+    sf_close(snd);
+
+    if (!pcm || frames == 0) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to decode clip at %s", path);
+        free(pcm);
+        return FINITE_AUDIO_CLIP_NONE;
+    }
+
+    uint32_t rate = (uint32_t) info.samplerate;
+    if (bank->sampleRate != 0 && bank->sampleRate != rate) {
+        size_t resampledFrames;
+        short *resampled = finite_audio_bank_resample(pcm, frames, channels, rate, bank->sampleRate, &resampledFrames);
+        free(pcm);
+        if (!resampled) {
+            finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to resample clip at %s (no memory available)", path);
+            return FINITE_AUDIO_CLIP_NONE;
+        }
+
+        finite_log_internal(LOG_LEVEL_DEBUG, file, line, func, "Resampled %s from %d to %d", path, rate, bank->sampleRate);
+        pcm = resampled;
+        frames = resampledFrames;
+        rate = bank->sampleRate;
+    }
+
+    if (bank->_clips == bank->_capacity) {
+        uint32_t capacity = bank->_capacity == 0 ? 16 : bank->_capacity * 2;
+        FiniteAudioClip *tmp = realloc(bank->clips, capacity * sizeof(FiniteAudioClip));
+        if (!tmp) {
+            finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to add clip to bank (no memory available)");
+            free(pcm);
+            return FINITE_AUDIO_CLIP_NONE;
+        }
+        bank->clips = tmp;
+        bank->_capacity = capacity;
+    }
+
+    FiniteAudioClip *clip = &bank->clips[bank->_clips];
+    clip->name = strdup(path);
+    clip->pcm = pcm;
+    clip->frames = frames;
+    clip->channels = channels;
+    clip->sampleRate = rate;
+    bank->_clips++;
+
+    finite_log_internal(LOG_LEVEL_DEBUG, file, line, func, "Cached %s (%zu frames, %d channel(s))", path, frames, channels);
+    return bank->_clips;
+}
+
+// the pointer is only valid until the next clip is loaded. the clip's pcm never moves.
+FiniteAudioClip *finite_audio_bank_get(FiniteAudioBank *bank, FiniteAudioClipHandle clip) {
+    if (!bank || clip == FINITE_AUDIO_CLIP_NONE || clip > bank->_clips) {
+        return NULL;
+    }
+    return &bank->clips[clip - 1];
+}
+
+FiniteAudioVoice finite_audio_bank_play_debug(const char *file, const char *func, int line, FiniteAudioBank *bank, FiniteAudioMixer *mixer, FiniteAudioClipHandle clip, float gain, float pan, bool loop) {
+    FiniteAudioClip *cached = finite_audio_bank_get(bank, clip);
+    if (!cached || !mixer) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to play clip %d with NULL bank, mixer or clip", clip);
+        return FINITE_AUDIO_VOICE_NONE;
+    }
+
+    if (cached->sampleRate != mixer->sampleRate) {
+        finite_log_internal(LOG_LEVEL_WARN, file, line, func, "Clip %s is %d Hz but the mixer runs at %d Hz. Create the bank with the mixer's rate to avoid this.", cached->name, cached->sampleRate, mixer->sampleRate);
+    }
+
+    FiniteAudioVoiceInfo info = {
+        .pcm = cached->pcm,
+        .frames = cached->frames,
+        .channels = cached->channels,
+        .gain = gain,
+        .pan = pan,
+        .loop = loop
+    };
+
+    return finite_audio_mixer_play_debug(file, func, line, mixer, &info);
+}
+
+void finite_audio_bank_destroy_debug(const char *file, const char *func, int line, FiniteAudioBank *bank) {
+    if (!bank) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to destroy NULL bank");
+        return;
+    }
+
+    for (uint32_t i = 0; i < bank->_clips; i++) {
+        free(bank->clips[i].name);
+        free(bank->clips[i].pcm);
+    }
+
+    free(bank->clips);
+    free(bank);
+}
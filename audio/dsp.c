@@ -0,0 +1,816 @@
+#include "../include/audio/audio-dsp.h"
+#include <math.h>
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define FINITE_DSP_X86 1
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define FINITE_DSP_NEON 1
+#include <arm_neon.h>
+#endif
+
+#define S16_TO_F32 (1.0f / 32768.0f)
+#define F32_TO_S16 32768.0f
+
+static struct {
+    const char *name;
+    void (*mix_s16)(float *acc, const short *src, size_t frames, uint32_t channels, float gainL, float gainR);
+    void (*f32_to_s16)(short *dst, const float *src, size_t samples);
+    void (*s16_to_f32)(float *dst, const short *src, size_t samples);
+    float (*dot_f32)(const float *a, const float *b, size_t n);
+    void (*add_f32)(float *dst, const float *src, size_t samples);
+    void (*ramp_f32)(float *buffer, size_t frames, float gain, float step);
+    void (*delay_f32)(float *out, const float *in, float *line, size_t samples, float feedback, float wet);
+    void (*biquad_f32)(float *buffer, size_t frames, const float *coeffs, float *state);
+    float (*peak_f32)(const float *src, size_t samples);
+    void (*spatialize_f32)(const float *x, const float *y, const float *z, const float *minDistance, const float *maxDistance, const float *rolloff, size_t count, const float *listener, float *gainL, float *gainR);
+} kernels;
+
+static pthread_once_t kernelsOnce = PTHREAD_ONCE_INIT;
+
+// scalar kernels. these also finish off whatever tail the vector kernels leave behind.
+
+static void mix_s16_scalar(float *acc, const short *src, size_t frames, uint32_t channels, float gainL, float gainR) {
+    gainL *= S16_TO_F32;
+    gainR *= S16_TO_F32;
+
+    if (channels == 1) {
+        for (size_t i = 0; i < frames; i++) {
+            acc[i * 2] += src[i] * gainL;
+            acc[i * 2 + 1] += src[i] * gainR;
+        }
+        return;
+    }
+
+    // anything wider than stereo only contributes its front pair
+    for (size_t i = 0; i < frames; i++) {
+        acc[i * 2] += src[i * channels] * gainL;
+        acc[i * 2 + 1] += src[i * channels + 1] * gainR;
+    }
+}
+
+static void f32_to_s16_scalar(short *dst, const float *src, size_t samples) {
+    for (size_t i = 0; i < samples; i++) {
+        float v = src[i] * F32_TO_S16;
+        if (v > 32767.0f) {
+            v = 32767.0f;
+        } else if (v < -32768.0f) {
+            v = -32768.0f;
+        }
+        dst[i] = (short) __builtin_lrintf(v);
+    }
+}
+
+static void s16_to_f32_scalar(float *dst, const short *src, size_t samples) {
+    for (size_t i = 0; i < samples; i++) {
+        dst[i] = src[i] * S16_TO_F32;
+    }
+}
+
+static float dot_f32_scalar(const float *a, const float *b, size_t n) {
+    float sum = 0.0f;
+    for (size_t i = 0; i < n; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+static void add_f32_scalar(float *dst, const float *src, size_t samples) {
+    for (size_t i = 0; i < samples; i++) {
+        dst[i] += src[i];
+    }
+}
+
+static void ramp_f32_scalar(float *buffer, size_t frames, float gain, float step) {
+    for (size_t i = 0; i < frames; i++) {
+        float g = gain + step * i;
+        buffer[i * 2] *= g;
+        buffer[i * 2 + 1] *= g;
+    }
+}
+
+static void delay_f32_scalar(float *out, const float *in, float *line, size_t samples, float feedback, float wet) {
+    for (size_t i = 0; i < samples; i++) {
+        float x = in[i];
+        float d = line[i];
+        line[i] = x + d * feedback;
+        out[i] += d * wet;
+    }
+}
+
+// transposed direct form II. coeffs are b0 b1 b2 a1 a2, state is z1 z2 for the left channel then the right.
+static void biquad_f32_scalar(float *buffer, size_t frames, const float *coeffs, float *state) {
+    for (uint32_t c = 0; c < 2; c++) {
+        float z1 = state[c * 2];
+        float z2 = state[c * 2 + 1];
+        for (size_t i = 0; i < frames; i++) {
+            float x = buffer[i * 2 + c];
+            float y = coeffs[0] * x + z1;
+            z1 = coeffs[1] * x - coeffs[3] * y + z2;
+            z2 = coeffs[2] * x - coeffs[4] * y;
+            buffer[i * 2 + c] = y;
+        }
+        state[c * 2] = z1;
+        state[c * 2 + 1] = z2;
+    }
+}
+
+static float peak_f32_scalar(const float *src, size_t samples) {
+    float peak = 0.0f;
+    for (size_t i = 0; i < samples; i++) {
+        float v = src[i] < 0.0f ? -src[i] : src[i];
+        peak = v > peak ? v : peak;
+    }
+    return peak;
+}
+
+// inverse distance between min and max, then an equal power pan from how far the emitter is to the listener's right.
+// |dot(rel, right)| <= distance so dividing by a floored distance keeps the pan in range when they overlap.
+static void spatialize_f32_scalar(const float *x, const float *y, const float *z, const float *minDistance, const float *maxDistance, const float *rolloff, size_t count, const float *listener, float *gainL, float *gainR) {
+    for (size_t i = 0; i < count; i++) {
+        float dx = x[i] - listener[0];
+        float dy = y[i] - listener[1];
+        float dz = z[i] - listener[2];
+        float d = sqrtf(dx * dx + dy * dy + dz * dz);
+        float c = d < minDistance[i] ? minDistance[i] : (d > maxDistance[i] ? maxDistance[i] : d);
+        float att = minDistance[i] / (minDistance[i] + rolloff[i] * (c - minDistance[i]));
+        float side = (dx * listener[3] + dy * listener[4] + dz * listener[5]) / (d > 1e-6f ? d : 1e-6f);
+        side = side < -1.0f ? -1.0f : (side > 1.0f ? 1.0f : side);
+        gainL[i] = att * sqrtf(0.5f - 0.5f * side);
+        gainR[i] = att * sqrtf(0.5f + 0.5f * side);
+    }
+}
+
+#ifdef FINITE_DSP_X86
+
+__attribute__((target("sse2")))
+static void mix_s16_sse2(float *acc, const short *src, size_t frames, uint32_t channels, float gainL, float gainR) {
+    size_t i = 0;
+    __m128 g = _mm_setr_ps(gainL * S16_TO_F32, gainR * S16_TO_F32, gainL * S16_TO_F32, gainR * S16_TO_F32);
+
+    if (channels == 2) {
+        for (; i + 4 <= frames; i += 4) {
+            __m128i s = _mm_loadu_si128((const __m128i *) (src + i * 2));
+            __m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16));
+            __m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16));
+            _mm_storeu_ps(acc + i * 2, _mm_add_ps(_mm_loadu_ps(acc + i * 2), _mm_mul_ps(lo, g)));
+            _mm_storeu_ps(acc + i * 2 + 4, _mm_add_ps(_mm_loadu_ps(acc + i * 2 + 4), _mm_mul_ps(hi, g)));
+        }
+    } else if (channels == 1) {
+        for (; i + 8 <= frames; i += 8) {
+            __m128i s = _mm_loadu_si128((const __m128i *) (src + i));
+            __m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16));
+            __m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16));
+            // duplicate every mono sample into a left/right pair
+            float *out = acc + i * 2;
+            _mm_storeu_ps(out, _mm_add_ps(_mm_loadu_ps(out), _mm_mul_ps(_mm_unpacklo_ps(lo, lo), g)));
+            _mm_storeu_ps(out + 4, _mm_add_ps(_mm_loadu_ps(out + 4), _mm_mul_ps(_mm_unpackhi_ps(lo, lo), g)));
+            _mm_storeu_ps(out + 8, _mm_add_ps(_mm_loadu_ps(out + 8), _mm_mul_ps(_mm_unpacklo_ps(hi, hi), g)));
+            _mm_storeu_ps(out + 12, _mm_add_ps(_mm_loadu_ps(out + 12), _mm_mul_ps(_mm_unpackhi_ps(hi, hi), g)));
+        }
+    }
+
+    if (i < frames) {
+        mix_s16_scalar(acc + i * 2, src + i * channels, frames - i, channels, gainL, gainR);
+    }
+}
+
+__attribute__((target("sse2")))
+static void f32_to_s16_sse2(short *dst, const float *src, size_t samples) {
+    size_t i = 0;
+    __m128 scale = _mm_set1_ps(F32_TO_S16);
+    __m128 lo = _mm_set1_ps(-32768.0f);
+    __m128 hi = _mm_set1_ps(32767.0f);
+
+    for (; i + 8 <= samples; i += 8) {
+        __m128 a = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i), scale), lo), hi);
+        __m128 b = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i + 4), scale), lo), hi);
+        __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+        _mm_storeu_si128((__m128i *) (dst + i), packed);
+    }
+
+    f32_to_s16_scalar(dst + i, src + i, samples - i);
+}
+
+__attribute__((target("sse2")))
+static void s16_to_f32_sse2(float *dst, const short *src, size_t samples) {
+    size_t i = 0;
+    __m128 scale = _mm_set1_ps(S16_TO_F32);
+
+    for (; i + 8 <= samples; i += 8) {
+        __m128i s = _mm_loadu_si128((const __m128i *) (src + i));
+        __m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16));
+        __m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16));
+        _mm_storeu_ps(dst + i, _mm_mul_ps(lo, scale));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(hi, scale));
+    }
+
+    s16_to_f32_scalar(dst + i, src + i, samples - i);
+}
+
+__attribute__((target("sse2")))
+static float dot_f32_sse2(const float *a, const float *b, size_t n) {
+    size_t i = 0;
+    __m128 sum0 = _mm_setzero_ps();
+    __m128 sum1 = _mm_setzero_ps();
+
+    for (; i + 8 <= n; i += 8) {
+        sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+
+    __m128 sum = _mm_add_ps(sum0, sum1);
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 0x55));
+    return _mm_cvtss_f32(sum) + dot_f32_scalar(a + i, b + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static void add_f32_sse2(float *dst, const float *src, size_t samples) {
+    size_t i = 0;
+    for (; i + 8 <= samples; i += 8) {
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_loadu_ps(src + i)));
+        _mm_storeu_ps(dst + i + 4, _mm_add_ps(_mm_loadu_ps(dst + i + 4), _mm_loadu_ps(src + i + 4)));
+    }
+
+    add_f32_scalar(dst + i, src + i, samples - i);
+}
+
+__attribute__((target("sse2")))
+static void ramp_f32_sse2(float *buffer, size_t frames, float gain, float step) {
+    size_t i = 0;
+    // two stereo frames per vector, each pair shares a gain
+    __m128 g = _mm_setr_ps(gain, gain, gain + step, gain + step);
+    __m128 inc = _mm_set1_ps(step * 2.0f);
+
+    for (; i + 2 <= frames; i += 2) {
+        _mm_storeu_ps(buffer + i * 2, _mm_mul_ps(_mm_loadu_ps(buffer + i * 2), g));
+        g = _mm_add_ps(g, inc);
+    }
+
+    ramp_f32_scalar(buffer + i * 2, frames - i, gain + step * i, step);
+}
+
+__attribute__((target("sse2")))
+static void delay_f32_sse2(float *out, const float *in, float *line, size_t samples, float feedback, float wet) {
+    size_t i = 0;
+    __m128 fb = _mm_set1_ps(feedback);
+    __m128 w = _mm_set1_ps(wet);
+
+    for (; i + 4 <= samples; i += 4) {
+        __m128 x = _mm_loadu_ps(in + i);
+        __m128 d = _mm_loadu_ps(line + i);
+        _mm_storeu_ps(line + i, _mm_add_ps(x, _mm_mul_ps(d, fb)));
+        _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(d, w)));
+    }
+
+    delay_f32_scalar(out + i, in + i, line + i, samples - i, feedback, wet);
+}
+
+// the filter is recursive in time so the vector runs across the two channels instead
+__attribute__((target("sse2")))
+static void biquad_f32_sse2(float *buffer, size_t frames, const float *coeffs, float *state) {
+    __m128 b0 = _mm_set1_ps(coeffs[0]);
+    __m128 b1 = _mm_set1_ps(coeffs[1]);
+    __m128 b2 = _mm_set1_ps(coeffs[2]);
+    __m128 a1 = _mm_set1_ps(coeffs[3]);
+    __m128 a2 = _mm_set1_ps(coeffs[4]);
+    __m128 z1 = _mm_setr_ps(state[0], state[2], 0.0f, 0.0f);
+    __m128 z2 = _mm_setr_ps(state[1], state[3], 0.0f, 0.0f);
+
+    for (size_t i = 0; i < frames; i++) {
+        __m128 x = _mm_castpd_ps(_mm_load_sd((const double *) (buffer + i * 2)));
+        __m128 y = _mm_add_ps(_mm_mul_ps(b0, x), z1);
+        z1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1, x), _mm_mul_ps(a1, y)), z2);
+        z2 = _mm_sub_ps(_mm_mul_ps(b2, x), _mm_mul_ps(a2, y));
+        _mm_store_sd((double *) (buffer + i * 2), _mm_castps_pd(y));
+    }
+
+    float z[8];
+    _mm_storeu_ps(z, z1);
+    _mm_storeu_ps(z + 4, z2);
+    state[0] = z[0];
+    state[1] = z[4];
+    state[2] = z[1];
+    state[3] = z[5];
+}
+
+__attribute__((target("sse2")))
+static float peak_f32_sse2(const float *src, size_t samples) {
+    size_t i = 0;
+    __m128 mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    __m128 peak = _mm_setzero_ps();
+
+    for (; i + 4 <= samples; i += 4) {
+        peak = _mm_max_ps(peak, _mm_and_ps(_mm_loadu_ps(src + i), mask));
+    }
+
+    peak = _mm_max_ps(peak, _mm_movehl_ps(peak, peak));
+    peak = _mm_max_ss(peak, _mm_shuffle_ps(peak, peak, 0x55));
+    float tail = peak_f32_scalar(src + i, samples - i);
+    float v = _mm_cvtss_f32(peak);
+    return v > tail ? v : tail;
+}
+
+__attribute__((target("sse2")))
+static void spatialize_f32_sse2(const float *x, const float *y, const float *z, const float *minDistance, const float *maxDistance, const float *rolloff, size_t count, const float *listener, float *gainL, float *gainR) {
+    size_t i = 0;
+    __m128 lx = _mm_set1_ps(listener[0]);
+    __m128 ly = _mm_set1_ps(listener[1]);
+    __m128 lz = _mm_set1_ps(listener[2]);
+    __m128 rx = _mm_set1_ps(listener[3]);
+    __m128 ry = _mm_set1_ps(listener[4]);
+    __m128 rz = _mm_set1_ps(listener[5]);
+    __m128 half = _mm_set1_ps(0.5f);
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 floor = _mm_set1_ps(1e-6f);
+
+    for (; i + 4 <= count; i += 4) {
+        __m128 dx = _mm_sub_ps(_mm_loadu_ps(x + i), lx);
+        __m128 dy = _mm_sub_ps(_mm_loadu_ps(y + i), ly);
+        __m128 dz = _mm_sub_ps(_mm_loadu_ps(z + i), lz);
+        __m128 d = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+        __m128 lo = _mm_loadu_ps(minDistance + i);
+        __m128 c = _mm_min_ps(_mm_max_ps(d, lo), _mm_loadu_ps(maxDistance + i));
+        __m128 att = _mm_div_ps(lo, _mm_add_ps(lo, _mm_mul_ps(_mm_loadu_ps(rolloff + i), _mm_sub_ps(c, lo))));
+        __m128 side = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, rx), _mm_mul_ps(dy, ry)), _mm_mul_ps(dz, rz));
+        side = _mm_div_ps(side, _mm_max_ps(d, floor));
+        side = _mm_mul_ps(half, _mm_min_ps(_mm_max_ps(side, _mm_sub_ps(_mm_setzero_ps(), one)), one));
+        _mm_storeu_ps(gainL + i, _mm_mul_ps(att, _mm_sqrt_ps(_mm_sub_ps(half, side))));
+        _mm_storeu_ps(gainR + i, _mm_mul_ps(att, _mm_sqrt_ps(_mm_add_ps(half, side))));
+    }
+
+    spatialize_f32_scalar(x + i, y + i, z + i, minDistance + i, maxDistance + i, rolloff + i, count - i, listener, gainL + i, gainR + i);
+}
+
+__attribute__((target("avx2")))
+static void mix_s16_avx2(float *acc, const short *src, size_t frames, uint32_t channels, float gainL, float gainR) {
+    size_t i = 0;
+    float l = gainL * S16_TO_F32;
+    float r = gainR * S16_TO_F32;
+    __m256 g = _mm256_setr_ps(l, r, l, r, l, r, l, r);
+
+    if (channels == 2) {
+        for (; i + 8 <= frames; i += 8) {
+            __m256 a = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) (src + i * 2))));
+            __m256 b = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) (src + i * 2 + 8))));
+            _mm256_storeu_ps(acc + i * 2, _mm256_add_ps(_mm256_loadu_ps(acc + i * 2), _mm256_mul_ps(a, g)));
+            _mm256_storeu_ps(acc + i * 2 + 8, _mm256_add_ps(_mm256_loadu_ps(acc + i * 2 + 8), _mm256_mul_ps(b, g)));
+        }
+    } else if (channels == 1) {
+        for (; i + 8 <= frames; i += 8) {
+            __m256 s = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) (src + i))));
+            // unpack works per 128 bit lane so the halves get put back in order afterwards
+            __m256 lo = _mm256_unpacklo_ps(s, s);
+            __m256 hi = _mm256_unpackhi_ps(s, s);
+            __m256 first = _mm256_permute2f128_ps(lo, hi, 0x20);
+            __m256 second = _mm256_permute2f128_ps(lo, hi, 0x31);
+            _mm256_storeu_ps(acc + i * 2, _mm256_add_ps(_mm256_loadu_ps(acc + i * 2), _mm256_mul_ps(first, g)));
+            _mm256_storeu_ps(acc + i * 2 + 8, _mm256_add_ps(_mm256_loadu_ps(acc + i * 2 + 8), _mm256_mul_ps(second, g)));
+        }
+    }
+
+    if (i < frames) {
+        mix_s16_scalar(acc + i * 2, src + i * channels, frames - i, channels, gainL, gainR);
+    }
+}
+
+__attribute__((target("avx2")))
+static void f32_to_s16_avx2(short *dst, const float *src, size_t samples) {
+    size_t i = 0;
+    __m256 scale = _mm256_set1_ps(F32_TO_S16);
+    __m256 lo = _mm256_set1_ps(-32768.0f);
+    __m256 hi = _mm256_set1_ps(32767.0f);
+
+    for (; i + 16 <= samples; i += 16) {
+        __m256 a = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i), scale), lo), hi);
+        __m256 b = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i + 8), scale), lo), hi);
+        // packs interleaves the 128 bit lanes, permute puts them back in order
+        __m256i packed = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+        _mm256_storeu_si256((__m256i *) (dst + i), _mm256_permute4x64_epi64(packed, 0xD8));
+    }
+
+    f32_to_s16_sse2(dst + i, src + i, samples - i);
+}
+
+__attribute__((target("avx2")))
+static void s16_to_f32_avx2(float *dst, const short *src, size_t samples) {
+    size_t i = 0;
+    __m256 scale = _mm256_set1_ps(S16_TO_F32);
+
+    for (; i + 8 <= samples; i += 8) {
+        __m256 s = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) (src + i))));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(s, scale));
+    }
+
+    s16_to_f32_scalar(dst + i, src + i, samples - i);
+}
+
+__attribute__((target("avx2")))
+static float dot_f32_avx2(const float *a, const float *b, size_t n) {
+    size_t i = 0;
+    __m256 sum0 = _mm256_setzero_ps();
+    __m256 sum1 = _mm256_setzero_ps();
+
+    for (; i + 16 <= n; i += 16) {
+        sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+        sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8)));
+    }
+
+    __m256 sum = _mm256_add_ps(sum0, sum1);
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 0x55));
+    return _mm_cvtss_f32(half) + dot_f32_sse2(a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void add_f32_avx2(float *dst, const float *src, size_t samples) {
+    size_t i = 0;
+    for (; i + 16 <= samples; i += 16) {
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), _mm256_loadu_ps(src + i)));
+        _mm256_storeu_ps(dst + i + 8, _mm256_add_ps(_mm256_loadu_ps(dst + i + 8), _mm256_loadu_ps(src + i + 8)));
+    }
+
+    add_f32_sse2(dst + i, src + i, samples - i);
+}
+
+__attribute__((target("avx2")))
+static void ramp_f32_avx2(float *buffer, size_t frames, float gain, float step) {
+    size_t i = 0;
+    __m256 g = _mm256_setr_ps(gain, gain, gain + step, gain + step, gain + step * 2.0f, gain + step * 2.0f, gain + step * 3.0f, gain + step * 3.0f);
+    __m256 inc = _mm256_set1_ps(step * 4.0f);
+
+    for (; i + 4 <= frames; i += 4) {
+        _mm256_storeu_ps(buffer + i * 2, _mm256_mul_ps(_mm256_loadu_ps(buffer + i * 2), g));
+        g = _mm256_add_ps(g, inc);
+    }
+
+    ramp_f32_scalar(buffer + i * 2, frames - i, gain + step * i, step);
+}
+
+__attribute__((target("avx2")))
+static void delay_f32_avx2(float *out, const float *in, float *line, size_t samples, float feedback, float wet) {
+    size_t i = 0;
+    __m256 fb = _mm256_set1_ps(feedback);
+    __m256 w = _mm256_set1_ps(wet);
+
+    for (; i + 8 <= samples; i += 8) {
+        __m256 x = _mm256_loadu_ps(in + i);
+        __m256 d = _mm256_loadu_ps(line + i);
+        _mm256_storeu_ps(line + i, _mm256_add_ps(x, _mm256_mul_ps(d, fb)));
+        _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_loadu_ps(out + i), _mm256_mul_ps(d, w)));
+    }
+
+    delay_f32_sse2(out + i, in + i, line + i, samples - i, feedback, wet);
+}
+
+__attribute__((target("avx2")))
+static float peak_f32_avx2(const float *src, size_t samples) {
+    size_t i = 0;
+    __m256 mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+    __m256 peak = _mm256_setzero_ps();
+
+    for (; i + 8 <= samples; i += 8) {
+        peak = _mm256_max_ps(peak, _mm256_and_ps(_mm256_loadu_ps(src + i), mask));
+    }
+
+    __m128 half = _mm_max_ps(_mm256_castps256_ps128(peak), _mm256_extractf128_ps(peak, 1));
+    half = _mm_max_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_max_ss(half, _mm_shuffle_ps(half, half, 0x55));
+    float tail = peak_f32_sse2(src + i, samples - i);
+    float v = _mm_cvtss_f32(half);
+    return v > tail ? v : tail;
+}
+
+__attribute__((target("avx2")))
+static void spatialize_f32_avx2(const float *x, const float *y, const float *z, const float *minDistance, const float *maxDistance, const float *rolloff, size_t count, const float *listener, float *gainL, float *gainR) {
+    size_t i = 0;
+    __m256 lx = _mm256_set1_ps(listener[0]);
+    __m256 ly = _mm256_set1_ps(listener[1]);
+    __m256 lz = _mm256_set1_ps(listener[2]);
+    __m256 rx = _mm256_set1_ps(listener[3]);
+    __m256 ry = _mm256_set1_ps(listener[4]);
+    __m256 rz = _mm256_set1_ps(listener[5]);
+    __m256 half = _mm256_set1_ps(0.5f);
+    __m256 one = _mm256_set1_ps(1.0f);
+    __m256 floor = _mm256_set1_ps(1e-6f);
+
+    for (; i + 8 <= count; i += 8) {
+        __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(x + i), lx);
+        __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(y + i), ly);
+        __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(z + i), lz);
+        __m256 d = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz)));
+        __m256 lo = _mm256_loadu_ps(minDistance + i);
+        __m256 c = _mm256_min_ps(_mm256_max_ps(d, lo), _mm256_loadu_ps(maxDistance + i));
+        __m256 att = _mm256_div_ps(lo, _mm256_add_ps(lo, _mm256_mul_ps(_mm256_loadu_ps(rolloff + i), _mm256_sub_ps(c, lo))));
+        __m256 side = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, rx), _mm256_mul_ps(dy, ry)), _mm256_mul_ps(dz, rz));
+        side = _mm256_div_ps(side, _mm256_max_ps(d, floor));
+        side = _mm256_mul_ps(half, _mm256_min_ps(_mm256_max_ps(side, _mm256_sub_ps(_mm256_setzero_ps(), one)), one));
+        _mm256_storeu_ps(gainL + i, _mm256_mul_ps(att, _mm256_sqrt_ps(_mm256_sub_ps(half, side))));
+        _mm256_storeu_ps(gainR + i, _mm256_mul_ps(att, _mm256_sqrt_ps(_mm256_add_ps(half, side))));
+    }
+
+    spatialize_f32_sse2(x + i, y + i, z + i, minDistance + i, maxDistance + i, rolloff + i, count - i, listener, gainL + i, gainR + i);
+}
+
+#endif
+
+#ifdef FINITE_DSP_NEON
+
+static void mix_s16_neon(float *acc, const short *src, size_t frames, uint32_t channels, float gainL, float gainR) {
+    size_t i = 0;
+    const float gains[4] = { gainL * S16_TO_F32, gainR * S16_TO_F32, gainL * S16_TO_F32, gainR * S16_TO_F32 };
+    float32x4_t g = vld1q_f32(gains);
+
+    if (channels == 2) {
+        for (; i + 4 <= frames; i += 4) {
+            int16x8_t s = vld1q_s16(src + i * 2);
+            float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(s)));
+            float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(s)));
+            vst1q_f32(acc + i * 2, vmlaq_f32(vld1q_f32(acc + i * 2), lo, g));
+            vst1q_f32(acc + i * 2 + 4, vmlaq_f32(vld1q_f32(acc + i * 2 + 4), hi, g));
+        }
+    } else if (channels == 1) {
+        for (; i + 4 <= frames; i += 4) {
+            float32x4_t s = vcvtq_f32_s32(vmovl_s16(vld1_s16(src + i)));
+            float32x4x2_t pairs = vzipq_f32(s, s);
+            vst1q_f32(acc + i * 2, vmlaq_f32(vld1q_f32(acc + i * 2), pairs.val[0], g));
+            vst1q_f32(acc + i * 2 + 4, vmlaq_f32(vld1q_f32(acc + i * 2 + 4), pairs.val[1], g));
+        }
+    }
+
+    if (i < frames) {
+        mix_s16_scalar(acc + i * 2, src + i * channels, frames - i, channels, gainL, gainR);
+    }
+}
+
+static void f32_to_s16_neon(short *dst, const float *src, size_t samples) {
+    size_t i = 0;
+    float32x4_t scale = vdupq_n_f32(F32_TO_S16);
+
+    for (; i + 8 <= samples; i += 8) {
+#if defined(__aarch64__)
+        int32x4_t a = vcvtnq_s32_f32(vmulq_f32(vld1q_f32(src + i), scale));
+        int32x4_t b = vcvtnq_s32_f32(vmulq_f32(vld1q_f32(src + i + 4), scale));
+#else
+        int32x4_t a = vcvtq_s32_f32(vmulq_f32(vld1q_f32(src + i), scale));
+        int32x4_t b = vcvtq_s32_f32(vmulq_f32(vld1q_f32(src + i + 4), scale));
+#endif
+        // vqmovn saturates so out of range samples clamp instead of wrapping
+        vst1q_s16(dst + i, vcombine_s16(vqmovn_s32(a), vqmovn_s32(b)));
+    }
+
+    f32_to_s16_scalar(dst + i, src + i, samples - i);
+}
+
+static void s16_to_f32_neon(float *dst, const short *src, size_t samples) {
+    size_t i = 0;
+    float32x4_t scale = vdupq_n_f32(S16_TO_F32);
+
+    for (; i + 8 <= samples; i += 8) {
+        int16x8_t s = vld1q_s16(src + i);
+        vst1q_f32(dst + i, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(s))), scale));
+        vst1q_f32(dst + i + 4, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(s))), scale));
+    }
+
+    s16_to_f32_scalar(dst + i, src + i, samples - i);
+}
+
+static float dot_f32_neon(const float *a, const float *b, size_t n) {
+    size_t i = 0;
+    float32x4_t sum0 = vdupq_n_f32(0.0f);
+    float32x4_t sum1 = vdupq_n_f32(0.0f);
+
+    for (; i + 8 <= n; i += 8) {
+        sum0 = vmlaq_f32(sum0, vld1q_f32(a + i), vld1q_f32(b + i));
+        sum1 = vmlaq_f32(sum1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    }
+
+    float32x4_t sum = vaddq_f32(sum0, sum1);
+    float32x2_t pair = vadd_f32(vget_low_f32(sum), vget_high_f32(sum));
+    return vget_lane_f32(vpadd_f32(pair, pair), 0) + dot_f32_scalar(a + i, b + i, n - i);
+}
+
+static void add_f32_neon(float *dst, const float *src, size_t samples) {
+    size_t i = 0;
+    for (; i + 8 <= samples; i += 8) {
+        vst1q_f32(dst + i, vaddq_f32(vld1q_f32(dst + i), vld1q_f32(src + i)));
+        vst1q_f32(dst + i + 4, vaddq_f32(vld1q_f32(dst + i + 4), vld1q_f32(src + i + 4)));
+    }
+
+    add_f32_scalar(dst + i, src + i, samples - i);
+}
+
+static void ramp_f32_neon(float *buffer, size_t frames, float gain, float step) {
+    size_t i = 0;
+    const float start[4] = { gain, gain, gain + step, gain + step };
+    float32x4_t g = vld1q_f32(start);
+    float32x4_t inc = vdupq_n_f32(step * 2.0f);
+
+    for (; i + 2 <= frames; i += 2) {
+        vst1q_f32(buffer + i * 2, vmulq_f32(vld1q_f32(buffer + i * 2), g));
+        g = vaddq_f32(g, inc);
+    }
+
+    ramp_f32_scalar(buffer + i * 2, frames - i, gain + step * i, step);
+}
+
+static void delay_f32_neon(float *out, const float *in, float *line, size_t samples, float feedback, float wet) {
+    size_t i = 0;
+    float32x4_t fb = vdupq_n_f32(feedback);
+    float32x4_t w = vdupq_n_f32(wet);
+
+    for (; i + 4 <= samples; i += 4) {
+        float32x4_t x = vld1q_f32(in + i);
+        float32x4_t d = vld1q_f32(line + i);
+        vst1q_f32(line + i, vmlaq_f32(x, d, fb));
+        vst1q_f32(out + i, vmlaq_f32(vld1q_f32(out + i), d, w));
+    }
+
+    delay_f32_scalar(out + i, in + i, line + i, samples - i, feedback, wet);
+}
+
+static void biquad_f32_neon(float *buffer, size_t frames, const float *coeffs, float *state) {
+    float32x2_t b0 = vdup_n_f32(coeffs[0]);
+    float32x2_t b1 = vdup_n_f32(coeffs[1]);
+    float32x2_t b2 = vdup_n_f32(coeffs[2]);
+    float32x2_t a1 = vdup_n_f32(coeffs[3]);
+    float32x2_t a2 = vdup_n_f32(coeffs[4]);
+    const float s1[2] = { state[0], state[2] };
+    const float s2[2] = { state[1], state[3] };
+    float32x2_t z1 = vld1_f32(s1);
+    float32x2_t z2 = vld1_f32(s2);
+
+    for (size_t i = 0; i < frames; i++) {
+        float32x2_t x = vld1_f32(buffer + i * 2);
+        float32x2_t y = vmla_f32(z1, b0, x);
+        z1 = vmls_f32(vmla_f32(z2, b1, x), a1, y);
+        z2 = vmls_f32(vmul_f32(b2, x), a2, y);
+        vst1_f32(buffer + i * 2, y);
+    }
+
+    state[0] = vget_lane_f32(z1, 0);
+    state[1] = vget_lane_f32(z2, 0);
+    state[2] = vget_lane_f32(z1, 1);
+    state[3] = vget_lane_f32(z2, 1);
+}
+
+static float peak_f32_neon(const float *src, size_t samples) {
+    size_t i = 0;
+    float32x4_t peak = vdupq_n_f32(0.0f);
+
+    for (; i + 4 <= samples; i += 4) {
+        peak = vmaxq_f32(peak, vabsq_f32(vld1q_f32(src + i)));
+    }
+
+    float32x2_t pair = vpmax_f32(vget_low_f32(peak), vget_high_f32(peak));
+    float v = vget_lane_f32(vpmax_f32(pair, pair), 0);
+    float tail = peak_f32_scalar(src + i, samples - i);
+    return v > tail ? v : tail;
+}
+
+static void spatialize_f32_neon(const float *x, const float *y, const float *z, const float *minDistance, const float *maxDistance, const float *rolloff, size_t count, const float *listener, float *gainL, float *gainR) {
+    size_t i = 0;
+#if defined(__aarch64__)
+    // 32 bit neon has no vector sqrt or divide so it stays on the scalar loop
+    float32x4_t lx = vdupq_n_f32(listener[0]);
+    float32x4_t ly = vdupq_n_f32(listener[1]);
+    float32x4_t lz = vdupq_n_f32(listener[2]);
+    float32x4_t rx = vdupq_n_f32(listener[3]);
+    float32x4_t ry = vdupq_n_f32(listener[4]);
+    float32x4_t rz = vdupq_n_f32(listener[5]);
+    float32x4_t half = vdupq_n_f32(0.5f);
+    float32x4_t floor = vdupq_n_f32(1e-6f);
+
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t dx = vsubq_f32(vld1q_f32(x + i), lx);
+        float32x4_t dy = vsubq_f32(vld1q_f32(y + i), ly);
+        float32x4_t dz = vsubq_f32(vld1q_f32(z + i), lz);
+        float32x4_t d = vsqrtq_f32(vmlaq_f32(vmlaq_f32(vmulq_f32(dx, dx), dy, dy), dz, dz));
+        float32x4_t lo = vld1q_f32(minDistance + i);
+        float32x4_t c = vminq_f32(vmaxq_f32(d, lo), vld1q_f32(maxDistance + i));
+        float32x4_t att = vdivq_f32(lo, vmlaq_f32(lo, vld1q_f32(rolloff + i), vsubq_f32(c, lo)));
+        float32x4_t side = vmlaq_f32(vmlaq_f32(vmulq_f32(dx, rx), dy, ry), dz, rz);
+        side = vdivq_f32(side, vmaxq_f32(d, floor));
+        side = vmulq_f32(half, vminq_f32(vmaxq_f32(side, vdupq_n_f32(-1.0f)), vdupq_n_f32(1.0f)));
+        vst1q_f32(gainL + i, vmulq_f32(att, vsqrtq_f32(vsubq_f32(half, side))));
+        vst1q_f32(gainR + i, vmulq_f32(att, vsqrtq_f32(vaddq_f32(half, side))));
+    }
+#endif
+
+    spatialize_f32_scalar(x + i, y + i, z + i, minDistance + i, maxDistance + i, rolloff + i, count - i, listener, gainL + i, gainR + i);
+}
+
+#endif
+
+static void finite_audio_dsp_pick(void) {
+    kernels.name = "scalar";
+    kernels.mix_s16 = mix_s16_scalar;
+    kernels.f32_to_s16 = f32_to_s16_scalar;
+    kernels.s16_to_f32 = s16_to_f32_scalar;
+    kernels.dot_f32 = dot_f32_scalar;
+    kernels.add_f32 = add_f32_scalar;
+    kernels.ramp_f32 = ramp_f32_scalar;
+    kernels.delay_f32 = delay_f32_scalar;
+    kernels.biquad_f32 = biquad_f32_scalar;
+    kernels.peak_f32 = peak_f32_scalar;
+    kernels.spatialize_f32 = spatialize_f32_scalar;
+
+#ifdef FINITE_DSP_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) {
+        kernels.name = "sse2";
+        kernels.mix_s16 = mix_s16_sse2;
+        kernels.f32_to_s16 = f32_to_s16_sse2;
+        kernels.s16_to_f32 = s16_to_f32_sse2;
+        kernels.dot_f32 = dot_f32_sse2;
+        kernels.add_f32 = add_f32_sse2;
+        kernels.ramp_f32 = ramp_f32_sse2;
+        kernels.delay_f32 = delay_f32_sse2;
+        kernels.biquad_f32 = biquad_f32_sse2;
+        kernels.peak_f32 = peak_f32_sse2;
+        kernels.spatialize_f32 = spatialize_f32_sse2;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        kernels.name = "avx2";
+        kernels.mix_s16 = mix_s16_avx2;
+        kernels.f32_to_s16 = f32_to_s16_avx2;
+        kernels.s16_to_f32 = s16_to_f32_avx2;
+        kernels.dot_f32 = dot_f32_avx2;
+        kernels.add_f32 = add_f32_avx2;
+        kernels.ramp_f32 = ramp_f32_avx2;
+        kernels.delay_f32 = delay_f32_avx2;
+        kernels.peak_f32 = peak_f32_avx2;
+        kernels.spatialize_f32 = spatialize_f32_avx2;
+    }
+#elif defined(FINITE_DSP_NEON)
+    kernels.name = "neon";
+    kernels.mix_s16 = mix_s16_neon;
+    kernels.f32_to_s16 = f32_to_s16_neon;
+    kernels.s16_to_f32 = s16_to_f32_neon;
+    kernels.dot_f32 = dot_f32_neon;
+    kernels.add_f32 = add_f32_neon;
+    kernels.ramp_f32 = ramp_f32_neon;
+    kernels.delay_f32 = delay_f32_neon;
+    kernels.biquad_f32 = biquad_f32_neon;
+    kernels.peak_f32 = peak_f32_neon;
+    kernels.spatialize_f32 = spatialize_f32_neon;
+#endif
+}
+
+void finite_audio_dsp_mix_s16(float *acc, const short *src, size_t frames, uint32_t channels, float gainL, float gainR) {
+    pthread_once(&kernelsOnce, finite_audio_dsp_pick);
+    kernels.mix_s16(acc, src, frames, channels, gainL, gainR);
+}
+
+void finite_audio_dsp_f32_to_s16(short *dst, const float *src, size_t samples) {
+    pthread_once(&kernelsOnce, finite_audio_dsp_pick);
+    kernels.f32_to_s16(dst, src, samples);
+}
+
+void finite_audio_dsp_s16_to_f32(float *dst, const short *src, size_t samples) {
+    pthread_once(&kernelsOnce, finite_audio_dsp_pick);
+    kernels.s16_to_f32(dst, src, samples);
+}
+
+float finite_audio_dsp_dot_f32(const float *a, const float *b, size_t n) {
+    pthread_once(&kernelsOnce, finite_audio_dsp_pick);
+    return kernels.dot_f32(a, b, n);
+}
+
+void finite_audio_dsp_add_f32(float *dst, const float *src, size_t samples) {
+    pthread_once(&kernelsOnce, finite_audio_dsp_pick);
+    kernels.add_f32(dst, src, samples);
+}
+
+void finite_audio_dsp_ramp_f32(float *buffer, size_t frames, float gain, float step) {
+    pthread_once(&kernelsOnce, finite_audio_dsp_pick);
+    kernels.ramp_f32(buffer, frames, gain, step);
+}
+
+void finite_audio_dsp_delay_f32(float *out, const float *in, float *line, size_t samples, float feedback, float wet) {
+    pthread_once(&kernelsOnce, finite_audio_dsp_pick);
+    kernels.delay_f32(out, in, line, samples, feedback, wet);
+}
+
+void finite_audio_dsp_biquad_f32(float *buffer, size_t frames, const float *coeffs, float *state) {
+    pthread_once(&kernelsOnce, finite_audio_dsp_pick);
+    kernels.biquad_f32(buffer, frames, coeffs, state);
+}
+
+float finite_audio_dsp_peak_f32(const float *src, size_t samples) {
+    pthread_once(&kernelsOnce, finite_audio_dsp_pick);
+    return kernels.peak_f32(src, samples);
+}
+
+void finite_audio_dsp_spatialize_f32(const float *x, const float *y, const float *z, const float *minDistance, const float *maxDistance, const float *rolloff, size_t count, const float *listener, float *gainL, float *gainR) {
+    pthread_once(&kernelsOnce, finite_audio_dsp_pick);
+    kernels.spatialize_f32(x, y, z, minDistance, maxDistance, rolloff, count, listener, gainL, gainR);
+}
+
+const char *finite_audio_dsp_backend(void) {
+    pthread_once(&kernelsOnce, finite_audio_dsp_pick);
+    return kernels.name;
+}
@@ -0,0 +1,441 @@
+#include "../include/audio/audio-effect.h"
+#include "../include/audio/audio-dsp.h"
+#include "../include/log.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// frames the limiter looks at per gain step
+#define FINITE_AUDIO_LIMITER_STEP 32
+
+// comb lengths in frames at 44100 Hz. mutually prime so the echoes don't line up.
+static const uint32_t reverbLengths[FINITE_AUDIO_EFFECT_REVERB_LINES] = { 1116, 1188, 1277, 1356 };
+
+static float clampf(float v, float lo, float hi) {
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+static FiniteAudioEffect *finite_audio_effect_alloc(const char *file, const char *func, int line, uint32_t sampleRate, FiniteAudioEffectType type) {
+    if (sampleRate == 0 && type != FINITE_AUDIO_EFFECT_CUSTOM) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to create effect with no sample rate");
+        return NULL;
+    }
+
+    FiniteAudioEffect *effect = calloc(1, sizeof(FiniteAudioEffect));
+    if (!effect) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to create effect (no memory available)");
+        return NULL;
+    }
+
+    effect->type = type;
+    effect->sampleRate = sampleRate;
+    return effect;
+}
+
+// stores new parameters for the audio thread to pick up
+static void finite_audio_effect_store(FiniteAudioEffect *effect, float a, float b, float c) {
+    atomic_store_explicit(&effect->params[0], a, memory_order_relaxed);
+    atomic_store_explicit(&effect->params[1], b, memory_order_relaxed);
+    atomic_store_explicit(&effect->params[2], c, memory_order_relaxed);
+    atomic_fetch_add_explicit(&effect->changed, 1, memory_order_release);
+}
+
+// RBJ cookbook filters, normalised so a0 is 1
+static void finite_audio_effect_design_filter(FiniteAudioEffect *effect, float cutoff, float q) {
+    double w0 = 2.0 * M_PI * clampf(cutoff, 10.0f, effect->sampleRate * 0.45f) / effect->sampleRate;
+    double alpha = sin(w0) / (2.0 * clampf(q, 0.1f, 20.0f));
+    double cosw = cos(w0);
+    double a0 = 1.0 + alpha;
+    float *coeffs = effect->biquad.coeffs;
+
+    if (effect->type == FINITE_AUDIO_EFFECT_LOWPASS) {
+        coeffs[0] = (float) (((1.0 - cosw) / 2.0) / a0);
+        coeffs[1] = (float) ((1.0 - cosw) / a0);
+    } else {
+        coeffs[0] = (float) (((1.0 + cosw) / 2.0) / a0);
+        coeffs[1] = (float) (-(1.0 + cosw) / a0);
+    }
+    coeffs[2] = coeffs[0];
+    coeffs[3] = (float) ((-2.0 * cosw) / a0);
+    coeffs[4] = (float) ((1.0 - alpha) / a0);
+}
+
+// runs on the audio thread before every block. cheap when nothing changed.
+static void finite_audio_effect_update(FiniteAudioEffect *effect) {
+    uint32_t changed = atomic_load_explicit(&effect->changed, memory_order_acquire);
+    if (changed == effect->applied) {
+        return;
+    }
+    effect->applied = changed;
+
+    float a = atomic_load_explicit(&effect->params[0], memory_order_relaxed);
+    float b = atomic_load_explicit(&effect->params[1], memory_order_relaxed);
+    float c = atomic_load_explicit(&effect->params[2], memory_order_relaxed);
+
+    switch (effect->type) {
+        case FINITE_AUDIO_EFFECT_GAIN: {
+            uint32_t ramp = (uint32_t) (b * effect->sampleRate / 1000.0f);
+            effect->gain.target = a;
+            effect->gain.rampLeft = ramp > 0 ? ramp : 1;
+            effect->gain.step = (a - effect->gain.current) / effect->gain.rampLeft;
+            break;
+        }
+        case FINITE_AUDIO_EFFECT_LOWPASS:
+        case FINITE_AUDIO_EFFECT_HIGHPASS:
+            finite_audio_effect_design_filter(effect, a, b);
+            break;
+        case FINITE_AUDIO_EFFECT_DELAY: {
+            size_t frames = (size_t) (a * effect->sampleRate / 1000.0f);
+            frames = frames < 1 ? 1 : (frames > effect->delay.capacity / 2 ? effect->delay.capacity / 2 : frames);
+            effect->delay.lengths[0] = frames * 2;
+            effect->delay.positions[0] %= effect->delay.lengths[0];
+            effect->delay.feedback = clampf(b, 0.0f, 0.95f);
+            effect->delay.wet = clampf(c, 0.0f, 1.0f);
+            break;
+        }
+        case FINITE_AUDIO_EFFECT_REVERB:
+            effect->delay.feedback = 0.7f + (0.28f * clampf(a, 0.0f, 1.0f));
+            effect->delay.wet = clampf(b, 0.0f, 1.0f);
+            break;
+        case FINITE_AUDIO_EFFECT_LIMITER: {
+            float release = b * effect->sampleRate / 1000.0f;
+            effect->limiter.threshold = clampf(a, 0.01f, 1.0f);
+            effect->limiter.release = release > 1.0f ? 1.0f - expf(-FINITE_AUDIO_LIMITER_STEP / release) : 1.0f;
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+static void finite_audio_effect_process_gain(FiniteAudioEffect *effect, float *buffer, size_t frames) {
+    size_t done = 0;
+
+    if (effect->gain.rampLeft > 0) {
+        done = frames < effect->gain.rampLeft ? frames : effect->gain.rampLeft;
+        finite_audio_dsp_ramp_f32(buffer, done, effect->gain.current, effect->gain.step);
+        effect->gain.current += effect->gain.step * done;
+        effect->gain.rampLeft -= done;
+        if (effect->gain.rampLeft == 0) {
+            effect->gain.current = effect->gain.target;
+        }
+    }
+
+    if (done < frames && effect->gain.current != 1.0f) {
+        finite_audio_dsp_ramp_f32(buffer + (done * 2), frames - done, effect->gain.current, 0.0f);
+    }
+}
+
+// runs samples through one circular delay line. the line's length is the delay.
+static void finite_audio_effect_run_line(FiniteAudioEffect *effect, uint32_t index, float *out, const float *in, size_t samples, float wet) {
+    float *line = effect->delay.lines[index];
+    size_t length = effect->delay.lengths[index];
+    size_t pos = effect->delay.positions[index];
+    size_t done = 0;
+
+    while (done < samples) {
+        size_t n = samples - done < length - pos ? samples - done : length - pos;
+        finite_audio_dsp_delay_f32(out + done, in + done, line + pos, n, effect->delay.feedback, wet);
+        done += n;
+        pos += n;
+        if (pos == length) {
+            pos = 0;
+        }
+    }
+
+    effect->delay.positions[index] = pos;
+}
+
+static void finite_audio_effect_process_reverb(FiniteAudioEffect *effect, float *buffer, size_t frames) {
+    float wet = effect->delay.wet / effect->delay._lines;
+
+    for (size_t done = 0; done < frames; done += FINITE_AUDIO_EFFECT_BLOCK) {
+        size_t n = frames - done < FINITE_AUDIO_EFFECT_BLOCK ? frames - done : FINITE_AUDIO_EFFECT_BLOCK;
+        float *block = buffer + (done * 2);
+
+        // every comb is fed the dry signal and they all sum into the output
+        memcpy(effect->delay.dry, block, n * 2 * sizeof(float));
+        for (uint32_t i = 0; i < effect->delay._lines; i++) {
+            finite_audio_effect_run_line(effect, i, block, effect->delay.dry, n * 2, wet);
+        }
+    }
+}
+
+static void finite_audio_effect_process_limiter(FiniteAudioEffect *effect, float *buffer, size_t frames) {
+    float gain = effect->limiter.gain;
+
+    for (size_t done = 0; done < frames; done += FINITE_AUDIO_LIMITER_STEP) {
+        size_t n = frames - done < FINITE_AUDIO_LIMITER_STEP ? frames - done : FINITE_AUDIO_LIMITER_STEP;
+        float *block = buffer + (done * 2);
+        float peak = finite_audio_dsp_peak_f32(block, n * 2);
+        float target = peak > effect->limiter.threshold ? effect->limiter.threshold / peak : 1.0f;
+
+        if (target < gain) {
+            // attack is instant, anything slower would let the peak through
+            gain = target;
+            finite_audio_dsp_ramp_f32(block, n, gain, 0.0f);
+        } else {
+            float next = gain + ((target - gain) * effect->limiter.release);
+            if (gain != 1.0f || next != 1.0f) {
+                finite_audio_dsp_ramp_f32(block, n, gain, (next - gain) / n);
+            }
+            gain = next;
+        }
+    }
+
+    effect->limiter.gain = gain;
+}
+
+void finite_audio_effect_process(FiniteAudioEffect *effect, float *buffer, size_t frames) {
+    finite_audio_effect_update(effect);
+
+    if (atomic_load_explicit(&effect->bypass, memory_order_relaxed) || frames == 0) {
+        return;
+    }
+
+    switch (effect->type) {
+        case FINITE_AUDIO_EFFECT_GAIN:
+            finite_audio_effect_process_gain(effect, buffer, frames);
+            break;
+        case FINITE_AUDIO_EFFECT_LOWPASS:
+        case FINITE_AUDIO_EFFECT_HIGHPASS:
+            finite_audio_dsp_biquad_f32(buffer, frames, effect->biquad.coeffs, effect->biquad.state);
+            break;
+        case FINITE_AUDIO_EFFECT_DELAY:
+            finite_audio_effect_run_line(effect, 0, buffer, buffer, frames * 2, effect->delay.wet);
+            break;
+        case FINITE_AUDIO_EFFECT_REVERB:
+            finite_audio_effect_process_reverb(effect, buffer, frames);
+            break;
+        case FINITE_AUDIO_EFFECT_LIMITER:
+            finite_audio_effect_process_limiter(effect, buffer, frames);
+            break;
+        case FINITE_AUDIO_EFFECT_CUSTOM:
+            effect->custom.process(effect, buffer, frames, effect->custom.data);
+            break;
+    }
+}
+
+FiniteAudioEffect *finite_audio_effect_create_gain_debug(const char *file, const char *func, int line, uint32_t sampleRate, float gain, float rampMs) {
+    FiniteAudioEffect *effect = finite_audio_effect_alloc(file, func, line, sampleRate, FINITE_AUDIO_EFFECT_GAIN);
+    if (!effect) {
+        return NULL;
+    }
+
+    effect->gain.current = gain;
+    effect->gain.target = gain;
+    finite_audio_effect_store(effect, gain, rampMs, 0.0f);
+    return effect;
+}
+
+FiniteAudioEffect *finite_audio_effect_create_filter_debug(const char *file, const char *func, int line, uint32_t sampleRate, FiniteAudioEffectType type, float cutoff, float q) {
+    if (type != FINITE_AUDIO_EFFECT_LOWPASS && type != FINITE_AUDIO_EFFECT_HIGHPASS) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to create filter of type %d", type);
+        return NULL;
+    }
+
+    FiniteAudioEffect *effect = finite_audio_effect_alloc(file, func, line, sampleRate, type);
+    if (!effect) {
+        return NULL;
+    }
+
+    finite_audio_effect_store(effect, cutoff, q, 0.0f);
+    return effect;
+}
+
+static bool finite_audio_effect_alloc_lines(FiniteAudioEffect *effect, uint32_t lines, size_t capacity) {
+    effect->delay._lines = lines;
+    effect->delay.capacity = capacity;
+    for (uint32_t i = 0; i < lines; i++) {
+        effect->delay.lines[i] = calloc(capacity, sizeof(float));
+        if (!effect->delay.lines[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+FiniteAudioEffect *finite_audio_effect_create_delay_debug(const char *file, const char *func, int line, uint32_t sampleRate, float delayMs, float feedback, float wet, float maxDelayMs) {
+    FiniteAudioEffect *effect = finite_audio_effect_alloc(file, func, line, sampleRate, FINITE_AUDIO_EFFECT_DELAY);
+    if (!effect) {
+        return NULL;
+    }
+
+    if (maxDelayMs < delayMs) {
+        maxDelayMs = delayMs;
+    }
+
+    size_t frames = (size_t) (maxDelayMs * sampleRate / 1000.0f) + 1;
+    if (!finite_audio_effect_alloc_lines(effect, 1, frames * 2)) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to allocate %zu frame delay line", frames);
+        finite_audio_effect_destroy_debug(file, func, line, effect);
+        return NULL;
+    }
+
+    effect->delay.lengths[0] = 2;
+    finite_audio_effect_store(effect, delayMs, feedback, wet);
+    return effect;
+}
+
+FiniteAudioEffect *finite_audio_effect_create_reverb_debug(const char *file, const char *func, int line, uint32_t sampleRate, float size, float wet) {
+    FiniteAudioEffect *effect = finite_audio_effect_alloc(file, func, line, sampleRate, FINITE_AUDIO_EFFECT_REVERB);
+    if (!effect) {
+        return NULL;
+    }
+
+    size_t longest = ((size_t) reverbLengths[FINITE_AUDIO_EFFECT_REVERB_LINES - 1] * sampleRate / 44100) + 1;
+    bool ok = finite_audio_effect_alloc_lines(effect, FINITE_AUDIO_EFFECT_REVERB_LINES, longest * 2);
+    effect->delay.dry = malloc(FINITE_AUDIO_EFFECT_BLOCK * 2 * sizeof(float));
+    if (!ok || !effect->delay.dry) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to create reverb (no memory available)");
+        finite_audio_effect_destroy_debug(file, func, line, effect);
+        return NULL;
+    }
+
+    for (uint32_t i = 0; i < FINITE_AUDIO_EFFECT_REVERB_LINES; i++) {
+        size_t frames = (size_t) reverbLengths[i] * sampleRate / 44100;
+        effect->delay.lengths[i] = (frames > 0 ? frames : 1) * 2;
+    }
+
+    finite_audio_effect_store(effect, size, wet, 0.0f);
+    return effect;
+}
+
+FiniteAudioEffect *finite_audio_effect_create_limiter_debug(const char *file, const char *func, int line, uint32_t sampleRate, float threshold, float releaseMs) {
+    FiniteAudioEffect *effect = finite_audio_effect_alloc(file, func, line, sampleRate, FINITE_AUDIO_EFFECT_LIMITER);
+    if (!effect) {
+        return NULL;
+    }
+
+    effect->limiter.gain = 1.0f;
+    finite_audio_effect_store(effect, threshold, releaseMs, 0.0f);
+    return effect;
+}
+
+FiniteAudioEffect *finite_audio_effect_create_custom_debug(const char *file, const char *func, int line, FiniteAudioEffectProcess process, void *data) {
+    if (!process) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to create custom effect with NULL process function");
+        return NULL;
+    }
+
+    FiniteAudioEffect *effect = finite_audio_effect_alloc(file, func, line, 0, FINITE_AUDIO_EFFECT_CUSTOM);
+    if (!effect) {
+        return NULL;
+    }
+
+    effect->custom.process = process;
+    effect->custom.data = data;
+    return effect;
+}
+
+void finite_audio_effect_set_gain(FiniteAudioEffect *effect, float gain) {
+    finite_audio_effect_store(effect, gain, atomic_load_explicit(&effect->params[1], memory_order_relaxed), 0.0f);
+}
+
+void finite_audio_effect_set_filter(FiniteAudioEffect *effect, float cutoff, float q) {
+    finite_audio_effect_store(effect, cutoff, q, 0.0f);
+}
+
+void finite_audio_effect_set_delay(FiniteAudioEffect *effect, float delayMs, float feedback, float wet) {
+    finite_audio_effect_store(effect, delayMs, feedback, wet);
+}
+
+void finite_audio_effect_set_reverb(FiniteAudioEffect *effect, float size, float wet) {
+    finite_audio_effect_store(effect, size, wet, 0.0f);
+}
+
+void finite_audio_effect_set_limiter(FiniteAudioEffect *effect, float threshold, float releaseMs) {
+    finite_audio_effect_store(effect, threshold, releaseMs, 0.0f);
+}
+
+void finite_audio_effect_set_bypass(FiniteAudioEffect *effect, bool bypass) {
+    atomic_store_explicit(&effect->bypass, bypass, memory_order_relaxed);
+}
+
+void finite_audio_effect_reset(FiniteAudioEffect *effect) {
+    switch (effect->type) {
+        case FINITE_AUDIO_EFFECT_GAIN:
+            effect->gain.current = effect->gain.target;
+            effect->gain.rampLeft = 0;
+            break;
+        case FINITE_AUDIO_EFFECT_LOWPASS:
+        case FINITE_AUDIO_EFFECT_HIGHPASS:
+            memset(effect->biquad.state, 0, sizeof(effect->biquad.state));
+            break;
+        case FINITE_AUDIO_EFFECT_DELAY:
+        case FINITE_AUDIO_EFFECT_REVERB:
+            for (uint32_t i = 0; i < effect->delay._lines; i++) {
+                memset(effect->delay.lines[i], 0, effect->delay.capacity * sizeof(float));
+                effect->delay.positions[i] = 0;
+            }
+            break;
+        case FINITE_AUDIO_EFFECT_LIMITER:
+            effect->limiter.gain = 1.0f;
+            break;
+        default:
+            break;
+    }
+}
+
+void finite_audio_effect_destroy_debug(const char *file, const char *func, int line, FiniteAudioEffect *effect) {
+    if (!effect) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to destroy NULL effect");
+        return;
+    }
+
+    if (effect->type == FINITE_AUDIO_EFFECT_DELAY || effect->type == FINITE_AUDIO_EFFECT_REVERB) {
+        for (uint32_t i = 0; i < effect->delay._lines; i++) {
+            free(effect->delay.lines[i]);
+        }
+        free(effect->delay.dry);
+    }
+
+    free(effect);
+}
+
+FiniteAudioEffectChain *finite_audio_effect_chain_create_debug(const char *file, const char *func, int line) {
+    FiniteAudioEffectChain *chain = calloc(1, sizeof(FiniteAudioEffectChain));
+    if (!chain) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to create effect chain (no memory available)");
+        return NULL;
+    }
+    return chain;
+}
+
+bool finite_audio_effect_chain_add_debug(const char *file, const char *func, int line, FiniteAudioEffectChain *chain, FiniteAudioEffect *effect) {
+    if (!chain || !effect) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to add to effect chain with NULL chain or effect");
+        return false;
+    }
+
+    uint32_t count = atomic_load_explicit(&chain->_effects, memory_order_relaxed);
+    if (count == FINITE_AUDIO_EFFECT_CHAIN_MAX) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to add to effect chain (it already has %d effects)", FINITE_AUDIO_EFFECT_CHAIN_MAX);
+        return false;
+    }
+
+    // the slot is filled before the count is published so the audio thread never sees an empty one
+    chain->effects[count] = effect;
+    atomic_store_explicit(&chain->_effects, count + 1, memory_order_release);
+    return true;
+}
+
+void finite_audio_effect_chain_process(FiniteAudioEffectChain *chain, float *buffer, size_t frames) {
+    uint32_t count = atomic_load_explicit(&chain->_effects, memory_order_acquire);
+    for (uint32_t i = 0; i < count; i++) {
+        finite_audio_effect_process(chain->effects[i], buffer, frames);
+    }
+}
+
+void finite_audio_effect_chain_destroy_debug(const char *file, const char *func, int line, FiniteAudioEffectChain *chain) {
+    if (!chain) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to destroy NULL effect chain");
+        return;
+    }
+
+    uint32_t count = atomic_load_explicit(&chain->_effects, memory_order_relaxed);
+    for (uint32_t i = 0; i < count; i++) {
+        finite_audio_effect_destroy_debug(file, func, line, chain->effects[i]);
+    }
+    free(chain);
+}
@@ -0,0 +1,496 @@
+#include "../include/audio/audio-mixer.h"
+#include "../include/log.h"
+#include <math.h>
+#include <string.h>
+
+static size_t finite_audio_mixer_fill(FinitePlaybackDevice *dev, short *out, size_t frames, void *data) {
+    return finite_audio_mixer_render(data, out, frames);
+}
+
+// bounded multi-producer queue (Vyukov style). any game thread may push, only the mixer thread pops.
+static bool finite_audio_mixer_push(FiniteAudioMixer *mixer, FiniteAudioMixerCommand *command) {
+    size_t pos = atomic_load_explicit(&mixer->enqueuePos, memory_order_relaxed);
+    FiniteAudioMixerSlot *slot;
+
+    while (true) {
+        slot = &mixer->queue[pos & mixer->queueMask];
+        size_t seq = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t) seq - (intptr_t) pos;
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&mixer->enqueuePos, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false; // full
+        } else {
+            pos = atomic_load_explicit(&mixer->enqueuePos, memory_order_relaxed);
+        }
+    }
+
+    slot->command = *command;
+    atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release);
+    return true;
+}
+
+static bool finite_audio_mixer_pop(FiniteAudioMixer *mixer, FiniteAudioMixerCommand *command) {
+    FiniteAudioMixerSlot *slot = &mixer->queue[mixer->dequeuePos & mixer->queueMask];
+    size_t seq = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+
+    if (seq != mixer->dequeuePos + 1) {
+        return false; // empty
+    }
+
+    *command = slot->command;
+    atomic_store_explicit(&slot->sequence, mixer->dequeuePos + mixer->queueMask + 1, memory_order_release);
+    mixer->dequeuePos++;
+    return true;
+}
+
+static FiniteAudioMixerVoice *finite_audio_mixer_find(FiniteAudioMixer *mixer, FiniteAudioVoice id) {
+    for (uint32_t i = 0; i < mixer->_voices; i++) {
+        if (atomic_load_explicit(&mixer->voices[i].id, memory_order_relaxed) == id) {
+            return &mixer->voices[i];
+        }
+    }
+    return NULL;
+}
+
+static void finite_audio_mixer_release(FiniteAudioMixer *mixer, FiniteAudioMixerVoice *voice) {
+    atomic_store_explicit(&voice->id, FINITE_AUDIO_VOICE_NONE, memory_order_release);
+    atomic_fetch_sub_explicit(&mixer->_activeVoices, 1, memory_order_relaxed);
+}
+
+// copies a new voice's emitter into the slot's arrays. non positional slots get values that give a gain of 1 so the batch never makes NaNs.
+static void finite_audio_mixer_place(FiniteAudioMixer *mixer, FiniteAudioMixerVoice *voice) {
+    FiniteAudioMixerEmitters *e = &mixer->emitters;
+    FiniteAudioVoiceInfo *info = &voice->info;
+    size_t i = voice - mixer->voices;
+
+    if (!info->positional) {
+        e->x[i] = mixer->listener[0];
+        e->y[i] = mixer->listener[1];
+        e->z[i] = mixer->listener[2];
+        e->minDistance[i] = 1.0f;
+        e->maxDistance[i] = 1.0f;
+        e->rolloff[i] = 0.0f;
+        return;
+    }
+
+    float minDistance = info->minDistance > 0.0f ? info->minDistance : 1.0f;
+    e->x[i] = info->position[0];
+    e->y[i] = info->position[1];
+    e->z[i] = info->position[2];
+    e->minDistance[i] = minDistance;
+    e->maxDistance[i] = info->maxDistance >= minDistance ? info->maxDistance : INFINITY;
+    e->rolloff[i] = info->rolloff > 0.0f ? info->rolloff : 1.0f;
+}
+
+static void finite_audio_mixer_apply_commands(FiniteAudioMixer *mixer) {
+    FiniteAudioMixerCommand command;
+    while (finite_audio_mixer_pop(mixer, &command)) {
+        FiniteAudioMixerVoice *voice = NULL;
+
+        switch (command.type) {
+            case FINITE_AUDIO_MIXER_PLAY:
+                voice = finite_audio_mixer_find(mixer, FINITE_AUDIO_VOICE_NONE);
+                if (!voice) {
+                    break; // every voice is busy, drop the new one
+                }
+                voice->info = command.info;
+                voice->position = 0;
+                finite_audio_mixer_place(mixer, voice);
+                atomic_fetch_add_explicit(&mixer->_activeVoices, 1, memory_order_relaxed);
+                atomic_store_explicit(&voice->id, command.voice, memory_order_release);
+                break;
+            case FINITE_AUDIO_MIXER_SET_BUS_EFFECTS:
+                mixer->busEffects = command.effects;
+                break;
+            case FINITE_AUDIO_MIXER_SET_LISTENER:
+                memcpy(mixer->listener, command.vector, sizeof(mixer->listener));
+                break;
+            case FINITE_AUDIO_MIXER_STOP_ALL:
+                for (uint32_t i = 0; i < mixer->_voices; i++) {
+                    if (atomic_load_explicit(&mixer->voices[i].id, memory_order_relaxed) != FINITE_AUDIO_VOICE_NONE) {
+                        finite_audio_mixer_release(mixer, &mixer->voices[i]);
+                    }
+                }
+                break;
+            default:
+                voice = finite_audio_mixer_find(mixer, command.voice);
+                if (!voice) {
+                    break; // already finished
+                }
+                if (command.type == FINITE_AUDIO_MIXER_STOP) {
+                    finite_audio_mixer_release(mixer, voice);
+                } else if (command.type == FINITE_AUDIO_MIXER_SET_GAIN) {
+                    voice->info.gain = command.value;
+                } else if (command.type == FINITE_AUDIO_MIXER_SET_PAN) {
+                    voice->info.pan = command.value;
+                } else if (command.type == FINITE_AUDIO_MIXER_SET_LOOP) {
+                    voice->info.loop = command.value != 0.0f;
+                } else if (command.type == FINITE_AUDIO_MIXER_SET_EFFECTS) {
+                    voice->info.effects = command.effects;
+                } else if (command.type == FINITE_AUDIO_MIXER_SET_POSITION && voice->info.positional) {
+                    size_t index = voice - mixer->voices;
+                    memcpy(voice->info.position, command.vector, sizeof(voice->info.position));
+                    mixer->emitters.x[index] = command.vector[0];
+                    mixer->emitters.y[index] = command.vector[1];
+                    mixer->emitters.z[index] = command.vector[2];
+                }
+                break;
+        }
+    }
+}
+
+// gains are worked out once per block, never per sample
+static void finite_audio_mixer_voice_gains(FiniteAudioMixer *mixer, FiniteAudioMixerVoice *voice, float master, float *gainL, float *gainR) {
+    float gain = voice->info.gain * master;
+
+    if (voice->info.positional) {
+        size_t i = voice - mixer->voices;
+        float l = mixer->emitters.gainL[i];
+        float r = mixer->emitters.gainR[i];
+        if (voice->info.channels == 2) {
+            // a centred equal power pan would leave both sides of a stereo source 3dB down, so lift it back to a balance
+            float att = sqrtf(l * l + r * r);
+            l = fminf(l * (float) M_SQRT2, att);
+            r = fminf(r * (float) M_SQRT2, att);
+        }
+        *gainL = gain * l;
+        *gainR = gain * r;
+        return;
+    }
+
+    float pan = voice->info.pan < -1.0f ? -1.0f : (voice->info.pan > 1.0f ? 1.0f : voice->info.pan);
+
+    if (voice->info.channels == 1) {
+        // equal power so a centred mono voice isn't louder than a hard panned one
+        float angle = (pan + 1.0f) * (float) M_PI * 0.25f;
+        *gainL = gain * cosf(angle);
+        *gainR = gain * sinf(angle);
+    } else {
+        // stereo sources just get balanced
+        *gainL = gain * (pan > 0.0f ? 1.0f - pan : 1.0f);
+        *gainR = gain * (pan < 0.0f ? 1.0f + pan : 1.0f);
+    }
+}
+
+size_t finite_audio_mixer_render(FiniteAudioMixer *mixer, short *out, size_t frames) {
+    finite_audio_mixer_apply_commands(mixer);
+
+    if (frames > FINITE_AUDIO_MIXER_BLOCK) {
+        frames = FINITE_AUDIO_MIXER_BLOCK;
+    }
+
+    memset(mixer->bus, 0, frames * 2 * sizeof(float));
+    float master = atomic_load_explicit(&mixer->masterGain, memory_order_relaxed);
+
+    // every slot in one pass. free and non positional slots are cheaper to compute than to skip.
+    FiniteAudioMixerEmitters *e = &mixer->emitters;
+    finite_audio_dsp_spatialize_f32(e->x, e->y, e->z, e->minDistance, e->maxDistance, e->rolloff, mixer->_voices, mixer->listener, e->gainL, e->gainR);
+
+    for (uint32_t i = 0; i < mixer->_voices; i++) {
+        FiniteAudioMixerVoice *voice = &mixer->voices[i];
+        if (atomic_load_explicit(&voice->id, memory_order_relaxed) == FINITE_AUDIO_VOICE_NONE) {
+            continue;
+        }
+
+        float gainL, gainR;
+        finite_audio_mixer_voice_gains(mixer, voice, master, &gainL, &gainR);
+
+        // voices with effects are mixed on their own first so the chain only hears that voice
+        FiniteAudioEffectChain *effects = voice->info.effects;
+        float *target = mixer->bus;
+        if (effects) {
+            target = mixer->voiceBus;
+            memset(target, 0, frames * 2 * sizeof(float));
+        }
+
+        size_t done = 0;
+        while (done < frames) {
+            size_t left = voice->info.frames - voice->position;
+            size_t todo = left < frames - done ? left : frames - done;
+
+            finite_audio_dsp_mix_s16(target + (done * 2), voice->info.pcm + (voice->position * voice->info.channels), todo, voice->info.channels, gainL, gainR);
+            voice->position += todo;
+            done += todo;
+
+            if (voice->position >= voice->info.frames) {
+                if (!voice->info.loop) {
+                    finite_audio_mixer_release(mixer, voice);
+                    break;
+                }
+                voice->position = 0;
+            }
+        }
+
+        if (effects) {
+            // the whole block goes through the chain even when the voice ended partway into it
+            finite_audio_effect_chain_process(effects, target, frames);
+            finite_audio_dsp_add_f32(mixer->bus, target, frames * 2);
+        }
+    }
+
+    if (mixer->busEffects) {
+        finite_audio_effect_chain_process(mixer->busEffects, mixer->bus, frames);
+    }
+
+    finite_audio_dsp_f32_to_s16(out, mixer->bus, frames * 2);
+    return frames;
+}
+
+FiniteAudioMixer *finite_audio_mixer_create_debug(const char *file, const char *func, int line, FinitePlaybackDevice *dev, uint32_t sampleRate, uint32_t maxVoices) {
+    if (sampleRate == 0 || maxVoices == 0) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to create mixer with no sample rate or voices (Rate: %d Voices: %d)", sampleRate, maxVoices);
+        return NULL;
+    }
+
+    FiniteAudioMixer *mixer = calloc(1, sizeof(FiniteAudioMixer));
+    if (!mixer) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to create mixer (no memory available)");
+        return NULL;
+    }
+
+    size_t queueSize = FINITE_AUDIO_MIXER_QUEUE;
+    while (queueSize < maxVoices * 2) {
+        queueSize <<= 1;
+    }
+
+    mixer->voices = calloc(maxVoices, sizeof(FiniteAudioMixerVoice));
+    mixer->queue = calloc(queueSize, sizeof(FiniteAudioMixerSlot));
+    mixer->bus = aligned_alloc(64, FINITE_AUDIO_MIXER_BLOCK * 2 * sizeof(float));
+    mixer->voiceBus = aligned_alloc(64, FINITE_AUDIO_MIXER_BLOCK * 2 * sizeof(float));
+    // the emitter arrays share one block, each padded to a cache line
+    size_t stride = (maxVoices + 15) & ~(size_t) 15;
+    float *emitters = aligned_alloc(64, stride * 8 * sizeof(float));
+    if (!mixer->voices || !mixer->queue || !mixer->bus || !mixer->voiceBus || !emitters) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to create mixer (no memory available)");
+        free(mixer->voices);
+        free(mixer->queue);
+        free(mixer->bus);
+        free(mixer->voiceBus);
+        free(emitters);
+        free(mixer);
+        return NULL;
+    }
+
+    float **arrays[] = {&mixer->emitters.x, &mixer->emitters.y, &mixer->emitters.z, &mixer->emitters.minDistance, &mixer->emitters.maxDistance, &mixer->emitters.rolloff, &mixer->emitters.gainL, &mixer->emitters.gainR};
+    for (size_t i = 0; i < 8; i++) {
+        *arrays[i] = emitters + i * stride;
+    }
+    for (uint32_t i = 0; i < maxVoices; i++) {
+        finite_audio_mixer_place(mixer, &mixer->voices[i]);
+    }
+    // the default listener faces -z with +y up, so its right is +x
+    mixer->listener[3] = 1.0f;
+
+    for (size_t i = 0; i < queueSize; i++) {
+        atomic_init(&mixer->queue[i].sequence, i);
+    }
+
+    mixer->dev = dev;
+    mixer->sampleRate = sampleRate;
+    mixer->_voices = maxVoices;
+    mixer->queueMask = queueSize - 1;
+    atomic_init(&mixer->nextVoice, 1);
+    atomic_init(&mixer->masterGain, 1.0f);
+
+    if (dev) {
+        if (!finite_audio_init_output_debug(file, func, line, dev, sampleRate, 2, finite_audio_mixer_fill, mixer)) {
+            finite_audio_mixer_destroy_debug(file, func, line, mixer);
+            return NULL;
+        }
+
+        // keep the ring short. anything queued in it is latency between a trigger and the speaker.
+        snd_pcm_uframes_t period;
+        snd_pcm_hw_params_get_period_size(dev->params, &period, 0);
+        dev->ringFrames = period * 2;
+    }
+
+    finite_log_internal(LOG_LEVEL_DEBUG, file, line, func, "Created mixer with %d voices using %s kernels", maxVoices, finite_audio_dsp_backend());
+    return mixer;
+}
+
+bool finite_audio_mixer_start_debug(const char *file, const char *func, int line, FiniteAudioMixer *mixer) {
+    if (!mixer || !mixer->dev) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to start mixer with NULL mixer or device");
+        return false;
+    }
+
+    return finite_audio_play_async_debug(file, func, line, mixer->dev);
+}
+
+FiniteAudioVoice finite_audio_mixer_play_debug(const char *file, const char *func, int line, FiniteAudioMixer *mixer, FiniteAudioVoiceInfo *info) {
+    if (!mixer || !info || !info->pcm) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to play voice with NULL mixer or info");
+        return FINITE_AUDIO_VOICE_NONE;
+    }
+
+    if (info->frames == 0 || info->channels == 0 || info->channels > 2) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to play voice with %d channel(s) and %zu frame(s)", info->channels, info->frames);
+        return FINITE_AUDIO_VOICE_NONE;
+    }
+
+    FiniteAudioVoice id = atomic_fetch_add_explicit(&mixer->nextVoice, 1, memory_order_relaxed);
+    if (id == FINITE_AUDIO_VOICE_NONE) {
+        id = atomic_fetch_add_explicit(&mixer->nextVoice, 1, memory_order_relaxed);
+    }
+
+    FiniteAudioMixerCommand command = {
+        .type = FINITE_AUDIO_MIXER_PLAY,
+        .voice = id,
+        .info = *info
+    };
+
+    if (!finite_audio_mixer_push(mixer, &command)) {
+        finite_log_internal(LOG_LEVEL_WARN, file, line, func, "Unable to play voice (mixer queue is full)");
+        return FINITE_AUDIO_VOICE_NONE;
+    }
+
+    return id;
+}
+
+static bool finite_audio_mixer_send(const char *file, const char *func, int line, FiniteAudioMixer *mixer, FiniteAudioMixerCommandType type, FiniteAudioVoice voice, float value, FiniteAudioEffectChain *effects) {
+    if (!mixer) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to update voice on NULL mixer");
+        return false;
+    }
+
+    FiniteAudioMixerCommand command = {
+        .type = type,
+        .voice = voice,
+        .value = value,
+        .effects = effects
+    };
+
+    if (!finite_audio_mixer_push(mixer, &command)) {
+        finite_log_internal(LOG_LEVEL_WARN, file, line, func, "Unable to update voice %d (mixer queue is full)", voice);
+        return false;
+    }
+
+    return true;
+}
+
+bool finite_audio_mixer_stop_voice_debug(const char *file, const char *func, int line, FiniteAudioMixer *mixer, FiniteAudioVoice voice) {
+    return finite_audio_mixer_send(file, func, line, mixer, FINITE_AUDIO_MIXER_STOP, voice, 0.0f, NULL);
+}
+
+bool finite_audio_mixer_stop_all_debug(const char *file, const char *func, int line, FiniteAudioMixer *mixer) {
+    return finite_audio_mixer_send(file, func, line, mixer, FINITE_AUDIO_MIXER_STOP_ALL, FINITE_AUDIO_VOICE_NONE, 0.0f, NULL);
+}
+
+bool finite_audio_mixer_set_gain_debug(const char *file, const char *func, int line, FiniteAudioMixer *mixer, FiniteAudioVoice voice, float gain) {
+    return finite_audio_mixer_send(file, func, line, mixer, FINITE_AUDIO_MIXER_SET_GAIN, voice, gain, NULL);
+}
+
+bool finite_audio_mixer_set_pan_debug(const char *file, const char *func, int line, FiniteAudioMixer *mixer, FiniteAudioVoice voice, float pan) {
+    return finite_audio_mixer_send(file, func, line, mixer, FINITE_AUDIO_MIXER_SET_PAN, voice, pan, NULL);
+}
+
+bool finite_audio_mixer_set_loop_debug(const char *file, const char *func, int line, FiniteAudioMixer *mixer, FiniteAudioVoice voice, bool loop) {
+    return finite_audio_mixer_send(file, func, line, mixer, FINITE_AUDIO_MIXER_SET_LOOP, voice, loop ? 1.0f : 0.0f, NULL);
+}
+
+bool finite_audio_mixer_set_effects_debug(const char *file, const char *func, int line, FiniteAudioMixer *mixer, FiniteAudioVoice voice, FiniteAudioEffectChain *chain) {
+    return finite_audio_mixer_send(file, func, line, mixer, FINITE_AUDIO_MIXER_SET_EFFECTS, voice, 0.0f, chain);
+}
+
+bool finite_audio_mixer_set_bus_effects_debug(const char *file, const char *func, int line, FiniteAudioMixer *mixer, FiniteAudioEffectChain *chain) {
+    return finite_audio_mixer_send(file, func, line, mixer, FINITE_AUDIO_MIXER_SET_BUS_EFFECTS, FINITE_AUDIO_VOICE_NONE, 0.0f, chain);
+}
+
+bool finite_audio_mixer_set_position_debug(const char *file, const char *func, int line, FiniteAudioMixer *mixer, FiniteAudioVoice voice, float x, float y, float z) {
+    if (!mixer) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to update voice on NULL mixer");
+        return false;
+    }
+
+    FiniteAudioMixerCommand command = {
+        .type = FINITE_AUDIO_MIXER_SET_POSITION,
+        .voice = voice,
+        .vector = {x, y, z}
+    };
+
+    if (!finite_audio_mixer_push(mixer, &command)) {
+        finite_log_internal(LOG_LEVEL_WARN, file, line, func, "Unable to update voice %d (mixer queue is full)", voice);
+        return false;
+    }
+
+    return true;
+}
+
+bool finite_audio_mixer_set_listener_debug(const char *file, const char *func, int line, FiniteAudioMixer *mixer, const float *position, const float *forward, const float *up) {
+    if (!mixer || !position || !forward || !up) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to set listener with NULL mixer or vectors");
+        return false;
+    }
+
+    // right = forward x up. the mixer only needs this one axis to pan.
+    float rx = forward[1] * up[2] - forward[2] * up[1];
+    float ry = forward[2] * up[0] - forward[0] * up[2];
+    float rz = forward[0] * up[1] - forward[1] * up[0];
+    float length = sqrtf(rx * rx + ry * ry + rz * rz);
+    if (length < 1e-6f) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to set listener with parallel forward and up vectors");
+        return false;
+    }
+
+    FiniteAudioMixerCommand command = {
+        .type = FINITE_AUDIO_MIXER_SET_LISTENER,
+        .vector = {position[0], position[1], position[2], rx / length, ry / length, rz / length}
+    };
+
+    if (!finite_audio_mixer_push(mixer, &command)) {
+        finite_log_internal(LOG_LEVEL_WARN, file, line, func, "Unable to set listener (mixer queue is full)");
+        return false;
+    }
+
+    return true;
+}
+
+void finite_audio_mixer_set_master_gain(FiniteAudioMixer *mixer, float gain) {
+    atomic_store_explicit(&mixer->masterGain, gain, memory_order_relaxed);
+}
+
+// a voice that was just played may still report false until the mixer picks up the command
+bool finite_audio_mixer_voice_active(FiniteAudioMixer *mixer, FiniteAudioVoice voice) {
+    if (voice == FINITE_AUDIO_VOICE_NONE) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < mixer->_voices; i++) {
+        if (atomic_load_explicit(&mixer->voices[i].id, memory_order_acquire) == voice) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t finite_audio_mixer_get_active_voices(FiniteAudioMixer *mixer) {
+    return atomic_load_explicit(&mixer->_activeVoices, memory_order_relaxed);
+}
+
+// stops the mixer's device if it's running. the device itself still needs finite_audio_cleanup().
+void finite_audio_mixer_destroy_debug(const char *file, const char *func, int line, FiniteAudioMixer *mixer) {
+    if (!mixer) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to destroy NULL mixer");
+        return;
+    }
+
+    if (mixer->dev) {
+        if (mixer->dev->isPlaying) {
+            finite_audio_stop_debug(file, func, line, mixer->dev);
+        }
+        finite_audio_wait_debug(file, func, line, mixer->dev);
+        mixer->dev->fill = NULL;
+        mixer->dev->fillData = NULL;
+    }
+
+    free(mixer->voices);
+    free(mixer->queue);
+    free(mixer->bus);
+    free(mixer->voiceBus);
+    free(mixer->emitters.x);
+    free(mixer);
+}
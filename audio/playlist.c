@@ -0,0 +1,356 @@
+#include "../include/audio/audio-playlist.h"
+#include "../include/log.h"
+#include <math.h>
+#include <string.h>
+
+static size_t finite_audio_playlist_fill(FinitePlaybackDevice *dev, short *out, size_t frames, void *data) {
+    return finite_audio_playlist_render(data, out, frames);
+}
+
+// reads source frames and converts them to the playlist's channel count
+static size_t finite_audio_track_source(FiniteAudioPlaylist *playlist, FiniteAudioTrack *track, short *out, size_t frames) {
+    sf_count_t got;
+    if (track->channels == playlist->channels) {
+        got = sf_readf_short(track->file, out, frames);
+    } else {
+        if (frames > FINITE_AUDIO_PLAYLIST_BLOCK) {
+            frames = FINITE_AUDIO_PLAYLIST_BLOCK;
+        }
+
+        got = sf_readf_short(track->file, track->raw, frames);
+        for (sf_count_t i = 0; i < got; i++) {
+            if (track->channels == 1) {
+                out[i * 2] = track->raw[i];
+                out[i * 2 + 1] = track->raw[i];
+            } else {
+                out[i] = (short) ((track->raw[i * 2] + track->raw[i * 2 + 1]) / 2);
+            }
+        }
+    }
+
+    finite_audio_stream_prefetch(track->stream);
+    return got > 0 ? (size_t) got : 0;
+}
+
+// fills out with frames at the playlist's rate and channels. comes up short once the track is over.
+static size_t finite_audio_track_decode(FiniteAudioPlaylist *playlist, FiniteAudioTrack *track, short *out, size_t frames) {
+    uint32_t channels = playlist->channels;
+    size_t produced = 0;
+
+    // the preroll goes first
+    if (track->pendingOffset < track->_pending) {
+        size_t n = track->_pending - track->pendingOffset;
+        if (n > frames) {
+            n = frames;
+        }
+        memcpy(out, track->pending + (track->pendingOffset * channels), n * channels * sizeof(short));
+        track->pendingOffset += n;
+        produced += n;
+    }
+
+    if (!track->resampler) {
+        while (produced < frames) {
+            size_t got = finite_audio_track_source(playlist, track, out + (produced * channels), frames - produced);
+            if (got == 0) {
+                break;
+            }
+            produced += got;
+        }
+        return produced;
+    }
+
+    while (produced < frames) {
+        if (track->decodeOffset == track->decodeLen && !track->sourceDone) {
+            size_t got = finite_audio_track_source(playlist, track, track->decodeBuffer, track->decodeCap);
+            track->decodeOffset = 0;
+            track->decodeLen = got;
+            track->sourceDone = got == 0;
+        }
+
+        size_t outFrames = frames - produced;
+        if (track->decodeOffset < track->decodeLen) {
+            size_t inFrames = track->decodeLen - track->decodeOffset;
+            finite_audio_resampler_process_s16(track->resampler, track->decodeBuffer + (track->decodeOffset * channels), &inFrames, out + (produced * channels), &outFrames);
+            track->decodeOffset += inFrames;
+        } else {
+            outFrames = finite_audio_resampler_drain_s16(track->resampler, out + (produced * channels), outFrames);
+            if (outFrames == 0) {
+                break;
+            }
+        }
+        produced += outFrames;
+    }
+
+    return produced;
+}
+
+static void finite_audio_track_free(FiniteAudioTrack *track) {
+    if (track->file) {
+        sf_close(track->file);
+    }
+    if (track->stream) {
+        finite_audio_stream_destroy(track->stream);
+    }
+    if (track->resampler) {
+        finite_audio_resampler_destroy(track->resampler);
+    }
+    free(track->raw);
+    free(track->decodeBuffer);
+    free(track->pending);
+    free(track->path);
+    free(track);
+}
+
+static FiniteAudioTrack *finite_audio_track_open(const char *file, const char *func, int line, FiniteAudioPlaylist *playlist, const char *path) {
+    FiniteAudioTrack *track = calloc(1, sizeof(FiniteAudioTrack));
+    if (!track) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to queue %s (no memory available)", path);
+        return NULL;
+    }
+
+    track->path = strdup(path);
+    track->stream = finite_audio_stream_map_debug(file, func, line, path);
+    if (!track->stream) {
+        finite_audio_track_free(track);
+        return NULL;
+    }
+
+    SF_INFO info;
+    track->file = finite_audio_stream_open_debug(file, func, line, track->stream, &info);
+    if (!track->file) {
+        finite_audio_track_free(track);
+        return NULL;
+    }
+
+    if (info.channels < 1 || info.channels > 2 || info.samplerate <= 0) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to queue %s with %d channel(s) at %d Hz", path, info.channels, info.samplerate);
+        finite_audio_track_free(track);
+        return NULL;
+    }
+
+    track->sampleRate = (uint32_t) info.samplerate;
+    track->channels = (uint32_t) info.channels;
+    track->decodeCap = FINITE_AUDIO_PLAYLIST_BLOCK;
+    track->raw = malloc(FINITE_AUDIO_PLAYLIST_BLOCK * track->channels * sizeof(short));
+    track->decodeBuffer = malloc(track->decodeCap * playlist->channels * sizeof(short));
+    track->pending = malloc(FINITE_AUDIO_PLAYLIST_PREROLL * playlist->channels * sizeof(short));
+    if (!track->path || !track->raw || !track->decodeBuffer || !track->pending) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to queue %s (no memory available)", path);
+        finite_audio_track_free(track);
+        return NULL;
+    }
+
+    if (track->sampleRate != playlist->sampleRate) {
+        track->resampler = finite_audio_resampler_create_debug(file, func, line, track->sampleRate, playlist->sampleRate, playlist->channels, FINITE_AUDIO_RESAMPLE_HIGH);
+        if (!track->resampler) {
+            finite_audio_track_free(track);
+            return NULL;
+        }
+    }
+
+    if (info.frames > 0) {
+        track->outFrames = track->resampler ? finite_audio_resampler_get_output_frames(track->resampler, info.frames) : (size_t) info.frames;
+        // keep a couple of seconds of the file on its way in while it plays
+        track->stream->aheadBytes = (sf_count_t) (((double) track->stream->size / info.frames) * track->sampleRate * 2);
+    }
+
+    track->_pending = finite_audio_track_decode(playlist, track, track->pending, FINITE_AUDIO_PLAYLIST_PREROLL);
+    return track;
+}
+
+FiniteAudioPlaylist *finite_audio_playlist_create_debug(const char *file, const char *func, int line, FinitePlaybackDevice *dev, uint32_t sampleRate, uint32_t channels) {
+    if (sampleRate == 0 || channels == 0 || channels > 2) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to create playlist (Rate: %d Channels: %d)", sampleRate, channels);
+        return NULL;
+    }
+
+    FiniteAudioPlaylist *playlist = calloc(1, sizeof(FiniteAudioPlaylist));
+    if (!playlist) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to create playlist (no memory available)");
+        return NULL;
+    }
+
+    playlist->scratch = malloc(FINITE_AUDIO_PLAYLIST_BLOCK * channels * sizeof(short));
+    if (!playlist->scratch) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to create playlist (no memory available)");
+        free(playlist);
+        return NULL;
+    }
+
+    playlist->dev = dev;
+    playlist->sampleRate = sampleRate;
+    playlist->channels = channels;
+
+    if (dev) {
+        if (!finite_audio_init_output_debug(file, func, line, dev, sampleRate, channels, finite_audio_playlist_fill, playlist)) {
+            finite_audio_playlist_destroy_debug(file, func, line, playlist);
+            return NULL;
+        }
+    }
+
+    return playlist;
+}
+
+bool finite_audio_playlist_start_debug(const char *file, const char *func, int line, FiniteAudioPlaylist *playlist) {
+    if (!playlist || !playlist->dev) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to start playlist with NULL playlist or device");
+        return false;
+    }
+
+    return finite_audio_play_async_debug(file, func, line, playlist->dev);
+}
+
+bool finite_audio_playlist_queue_debug(const char *file, const char *func, int line, FiniteAudioPlaylist *playlist, const char *path) {
+    if (!playlist || !path) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to queue with NULL playlist or path");
+        return false;
+    }
+
+    // free what the audio thread has finished with. it never frees anything itself.
+    size_t head = atomic_load_explicit(&playlist->head, memory_order_acquire);
+    while (playlist->reclaim < head) {
+        finite_audio_track_free(playlist->tracks[playlist->reclaim % FINITE_AUDIO_PLAYLIST_MAX]);
+        playlist->tracks[playlist->reclaim % FINITE_AUDIO_PLAYLIST_MAX] = NULL;
+        playlist->reclaim++;
+    }
+
+    size_t tail = atomic_load_explicit(&playlist->tail, memory_order_relaxed);
+    if (tail - playlist->reclaim >= FINITE_AUDIO_PLAYLIST_MAX) {
+        finite_log_internal(LOG_LEVEL_WARN, file, line, func, "Unable to queue %s (playlist is full)", path);
+        return false;
+    }
+
+    FiniteAudioTrack *track = finite_audio_track_open(file, func, line, playlist, path);
+    if (!track) {
+        return false;
+    }
+
+    playlist->tracks[tail % FINITE_AUDIO_PLAYLIST_MAX] = track;
+    atomic_store_explicit(&playlist->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+void finite_audio_playlist_set_crossfade(FiniteAudioPlaylist *playlist, float ms) {
+    uint32_t frames = ms > 0 ? (uint32_t) ((ms * playlist->sampleRate) / 1000.0f) : 0;
+    atomic_store_explicit(&playlist->crossfadeFrames, frames, memory_order_relaxed);
+}
+
+uint32_t finite_audio_playlist_get_queued(FiniteAudioPlaylist *playlist) {
+    size_t head = atomic_load_explicit(&playlist->head, memory_order_acquire);
+    size_t tail = atomic_load_explicit(&playlist->tail, memory_order_acquire);
+    return (uint32_t) (tail - head);
+}
+
+// equal power so the overlap doesn't dip in loudness
+static void finite_audio_playlist_crossfade(FiniteAudioPlaylist *playlist, short *out, const short *in, size_t frames, size_t position, size_t length) {
+    uint32_t channels = playlist->channels;
+    for (size_t i = 0; i < frames; i++) {
+        float t = ((float) (position + i) + 0.5f) / length;
+        float outGain = cosf(t * (float) M_PI_2);
+        float inGain = sinf(t * (float) M_PI_2);
+        for (uint32_t c = 0; c < channels; c++) {
+            float v = (out[i * channels + c] * outGain) + (in[i * channels + c] * inGain);
+            out[i * channels + c] = (short) (v > 32767.0f ? 32767.0f : (v < -32768.0f ? -32768.0f : v));
+        }
+    }
+}
+
+size_t finite_audio_playlist_render(FiniteAudioPlaylist *playlist, short *out, size_t frames) {
+    uint32_t channels = playlist->channels;
+    size_t produced = 0;
+
+    while (produced < frames) {
+        size_t head = atomic_load_explicit(&playlist->head, memory_order_relaxed);
+        size_t tail = atomic_load_explicit(&playlist->tail, memory_order_acquire);
+        short *dst = out + (produced * channels);
+        size_t want = frames - produced;
+
+        if (head == tail) {
+            // nothing queued. keep the device fed with silence until something is.
+            memset(dst, 0, want * channels * sizeof(short));
+            return frames;
+        }
+
+        FiniteAudioTrack *track = playlist->tracks[head % FINITE_AUDIO_PLAYLIST_MAX];
+        FiniteAudioTrack *next = head + 1 != tail ? playlist->tracks[(head + 1) % FINITE_AUDIO_PLAYLIST_MAX] : NULL;
+
+        if (!track->fadeDecided && track->outFrames > 0) {
+            size_t fade = atomic_load_explicit(&playlist->crossfadeFrames, memory_order_relaxed);
+            if (fade > track->outFrames / 2) {
+                fade = track->outFrames / 2;
+            }
+
+            size_t fadeStart = track->outFrames - fade;
+            if (track->played >= fadeStart) {
+                track->fadeDecided = true;
+                track->fadeFrames = next ? track->outFrames - track->played : 0;
+                continue;
+            }
+
+            if (want > fadeStart - track->played) {
+                want = fadeStart - track->played;
+            }
+        }
+
+        if (track->fadeFrames > 0 && next) {
+            size_t position = track->played - (track->outFrames - track->fadeFrames);
+            size_t n = track->outFrames - track->played;
+            if (n > want) {
+                n = want;
+            }
+            if (n > FINITE_AUDIO_PLAYLIST_BLOCK) {
+                n = FINITE_AUDIO_PLAYLIST_BLOCK;
+            }
+
+            // either side can end a little early if the file lied about its length
+            size_t got = finite_audio_track_decode(playlist, track, dst, n);
+            memset(dst + (got * channels), 0, (n - got) * channels * sizeof(short));
+            size_t incoming = finite_audio_track_decode(playlist, next, playlist->scratch, n);
+            memset(playlist->scratch + (incoming * channels), 0, (n - incoming) * channels * sizeof(short));
+
+            finite_audio_playlist_crossfade(playlist, dst, playlist->scratch, n, position, track->fadeFrames);
+            track->played += n;
+            next->played += incoming;
+            produced += n;
+        } else {
+            size_t got = finite_audio_track_decode(playlist, track, dst, want);
+            track->played += got;
+            produced += got;
+            if (got < want) {
+                // the track ended early (or its length wasn't known). the next one starts on the very next frame.
+                atomic_store_explicit(&playlist->head, head + 1, memory_order_release);
+                continue;
+            }
+        }
+
+        if (track->outFrames > 0 && track->played >= track->outFrames) {
+            atomic_store_explicit(&playlist->head, head + 1, memory_order_release);
+        }
+    }
+
+    return produced;
+}
+
+void finite_audio_playlist_destroy_debug(const char *file, const char *func, int line, FiniteAudioPlaylist *playlist) {
+    if (!playlist) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to destroy NULL playlist");
+        return;
+    }
+
+    if (playlist->dev) {
+        if (playlist->dev->isPlaying) {
+            finite_audio_stop_debug(file, func, line, playlist->dev);
+        }
+        finite_audio_wait_debug(file, func, line, playlist->dev);
+        playlist->dev->fill = NULL;
+        playlist->dev->fillData = NULL;
+    }
+
+    size_t tail = atomic_load_explicit(&playlist->tail, memory_order_relaxed);
+    for (size_t i = playlist->reclaim; i < tail; i++) {
+        finite_audio_track_free(playlist->tracks[i % FINITE_AUDIO_PLAYLIST_MAX]);
+    }
+
+    free(playlist->scratch);
+    free(playlist);
+}
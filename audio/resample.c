@@ -0,0 +1,296 @@
+#include "../include/audio/audio-resample.h"
+#include "../include/audio/audio-dsp.h"
+#include "../include/log.h"
+#include <math.h>
+#include <string.h>
+
+// frames converted per internal pass
+#define FINITE_AUDIO_RESAMPLER_BLOCK 1024
+
+static uint32_t gcd(uint32_t a, uint32_t b) {
+    while (b != 0) {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// zeroth order modified bessel function, needed by the kaiser window
+static double bessel_i0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 32; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12) {
+            break;
+        }
+    }
+    return sum;
+}
+
+// windowed sinc split into up phases. each phase is reversed so a filter step is one dot product.
+static void finite_audio_resampler_design(FiniteAudioResampler *rs, double rolloff, double beta) {
+    // centred on a whole tap so the delay is exactly taps / 2 input frames
+    uint32_t length = rs->taps * rs->up;
+    double centre = length / 2.0;
+    double cutoff = 0.5 * rolloff / (rs->up > rs->down ? rs->up : rs->down);
+    double norm = bessel_i0(beta);
+
+    for (uint32_t p = 0; p < rs->up; p++) {
+        float *phase = rs->coeffs + ((size_t) p * rs->taps);
+        double sum = 0.0;
+
+        for (uint32_t k = 0; k < rs->taps; k++) {
+            uint32_t n = p + (rs->taps - 1 - k) * rs->up;
+            double x = n - centre;
+            double sinc = x == 0.0 ? 1.0 : sin(2.0 * M_PI * cutoff * x) / (2.0 * M_PI * cutoff * x);
+            double r = (2.0 * n / length) - 1.0;
+            double window = bessel_i0(beta * sqrt(fmax(0.0, 1.0 - r * r))) / norm;
+            phase[k] = (float) (sinc * window);
+            sum += phase[k];
+        }
+
+        // every phase gets unity gain so there's no ripple on DC
+        for (uint32_t k = 0; k < rs->taps; k++) {
+            phase[k] = (float) (phase[k] / sum);
+        }
+    }
+}
+
+FiniteAudioResampler *finite_audio_resampler_create_debug(const char *file, const char *func, int line, uint32_t inRate, uint32_t outRate, uint32_t channels, FiniteAudioResampleQuality quality) {
+    if (inRate == 0 || outRate == 0 || channels == 0) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to create resampler (In: %d Out: %d Channels: %d)", inRate, outRate, channels);
+        return NULL;
+    }
+
+    FiniteAudioResampler *rs = calloc(1, sizeof(FiniteAudioResampler));
+    if (!rs) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to create resampler (no memory available)");
+        return NULL;
+    }
+
+    uint32_t div = gcd(inRate, outRate);
+    rs->inRate = inRate;
+    rs->outRate = outRate;
+    rs->channels = channels;
+    rs->up = outRate / div;
+    rs->down = inRate / div;
+
+    if (rs->up > FINITE_AUDIO_RESAMPLER_MAX_PHASES) {
+        // find the closest ratio we can build with a sane number of phases
+        double target = (double) outRate / inRate;
+        double best = INFINITY;
+        for (uint32_t up = 1; up <= FINITE_AUDIO_RESAMPLER_MAX_PHASES; up++) {
+            uint32_t down = (uint32_t) llround(up / target);
+            if (down == 0) {
+                continue;
+            }
+            double error = fabs(((double) up / down) - target);
+            if (error < best) {
+                best = error;
+                rs->up = up;
+                rs->down = down;
+            }
+        }
+        finite_log_internal(LOG_LEVEL_WARN, file, line, func, "Resampling %d to %d is approximated as %d/%d", inRate, outRate, rs->up, rs->down);
+    }
+
+    double rolloff, beta;
+    switch (quality) {
+        case FINITE_AUDIO_RESAMPLE_FAST:
+            rs->taps = 8;
+            rolloff = 0.80;
+            beta = 5.0;
+            break;
+        case FINITE_AUDIO_RESAMPLE_HIGH:
+            rs->taps = 64;
+            rolloff = 0.94;
+            beta = 9.0;
+            break;
+        default:
+            rs->taps = 24;
+            rolloff = 0.90;
+            beta = 7.0;
+            break;
+    }
+
+    rs->historyCap = rs->taps + FINITE_AUDIO_RESAMPLER_BLOCK + (rs->down / rs->up) + 1;
+    rs->coeffs = aligned_alloc(64, (((size_t) rs->up * rs->taps * sizeof(float)) + 63) & ~(size_t) 63);
+    rs->history = calloc(channels, sizeof(float *));
+    rs->scratch = malloc(FINITE_AUDIO_RESAMPLER_BLOCK * channels * sizeof(float) * 2);
+    bool ok = rs->coeffs && rs->history && rs->scratch;
+    for (uint32_t c = 0; ok && c < channels; c++) {
+        rs->history[c] = calloc(rs->historyCap, sizeof(float));
+        ok = rs->history[c] != NULL;
+    }
+
+    if (!ok) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to create resampler (no memory available)");
+        finite_audio_resampler_destroy_debug(file, func, line, rs);
+        return NULL;
+    }
+
+    finite_audio_resampler_design(rs, rolloff, beta);
+    finite_audio_resampler_reset(rs);
+
+    finite_log_internal(LOG_LEVEL_DEBUG, file, line, func, "Created resampler %d -> %d (%d/%d, %d taps)", inRate, outRate, rs->up, rs->down, rs->taps);
+    return rs;
+}
+
+void finite_audio_resampler_reset(FiniteAudioResampler *rs) {
+    // prime the filter with half its length so the output lines up with the input instead of lagging
+    rs->historyLen = rs->taps / 2 - 1;
+    for (uint32_t c = 0; c < rs->channels; c++) {
+        memset(rs->history[c], 0, rs->historyLen * sizeof(float));
+    }
+    rs->start = 0;
+    rs->phase = 0;
+    rs->draining = false;
+    rs->drainLeft = 0;
+}
+
+static size_t finite_audio_resampler_run(FiniteAudioResampler *rs, const float *in, size_t inFrames, float *out, size_t outCap, size_t *consumed) {
+    uint32_t channels = rs->channels;
+
+    if (rs->up == rs->down) {
+        size_t n = inFrames < outCap ? inFrames : outCap;
+        memcpy(out, in, n * channels * sizeof(float));
+        *consumed = n;
+        return n;
+    }
+
+    size_t produced = 0;
+    size_t used = 0;
+    while (true) {
+        while (produced < outCap && rs->start + rs->taps <= rs->historyLen) {
+            const float *coeff = rs->coeffs + ((size_t) rs->phase * rs->taps);
+            for (uint32_t c = 0; c < channels; c++) {
+                out[produced * channels + c] = finite_audio_dsp_dot_f32(coeff, rs->history[c] + rs->start, rs->taps);
+            }
+            produced++;
+
+            rs->phase += rs->down;
+            rs->start += rs->phase / rs->up;
+            rs->phase %= rs->up;
+        }
+
+        if (produced == outCap || used == inFrames) {
+            break;
+        }
+
+        // slide what the filter still needs to the front and append more input
+        size_t shift = rs->start < rs->historyLen ? rs->start : rs->historyLen;
+        if (shift > 0) {
+            for (uint32_t c = 0; c < channels; c++) {
+                memmove(rs->history[c], rs->history[c] + shift, (rs->historyLen - shift) * sizeof(float));
+            }
+            rs->historyLen -= shift;
+            rs->start -= shift;
+        }
+
+        size_t room = rs->historyCap - rs->historyLen;
+        size_t take = inFrames - used < room ? inFrames - used : room;
+        for (size_t i = 0; i < take; i++) {
+            for (uint32_t c = 0; c < channels; c++) {
+                rs->history[c][rs->historyLen + i] = in[(used + i) * channels + c];
+            }
+        }
+        rs->historyLen += take;
+        used += take;
+    }
+
+    *consumed = used;
+    return produced;
+}
+
+void finite_audio_resampler_process_f32(FiniteAudioResampler *rs, const float *in, size_t *inFrames, float *out, size_t *outFrames) {
+    size_t consumed;
+    *outFrames = finite_audio_resampler_run(rs, in, *inFrames, out, *outFrames, &consumed);
+    *inFrames = consumed;
+}
+
+void finite_audio_resampler_process_s16(FiniteAudioResampler *rs, const short *in, size_t *inFrames, short *out, size_t *outFrames) {
+    uint32_t channels = rs->channels;
+    float *inScratch = rs->scratch;
+    float *outScratch = rs->scratch + (FINITE_AUDIO_RESAMPLER_BLOCK * channels);
+    size_t consumed = 0;
+    size_t produced = 0;
+
+    while (produced < *outFrames) {
+        size_t inChunk = *inFrames - consumed < FINITE_AUDIO_RESAMPLER_BLOCK ? *inFrames - consumed : FINITE_AUDIO_RESAMPLER_BLOCK;
+        size_t outChunk = *outFrames - produced < FINITE_AUDIO_RESAMPLER_BLOCK ? *outFrames - produced : FINITE_AUDIO_RESAMPLER_BLOCK;
+
+        finite_audio_dsp_s16_to_f32(inScratch, in + (consumed * channels), inChunk * channels);
+
+        size_t used;
+        size_t got = finite_audio_resampler_run(rs, inScratch, inChunk, outScratch, outChunk, &used);
+        finite_audio_dsp_f32_to_s16(out + (produced * channels), outScratch, got * channels);
+
+        consumed += used;
+        produced += got;
+        if (got == 0 && used == 0) {
+            break;
+        }
+    }
+
+    *inFrames = consumed;
+    *outFrames = produced;
+}
+
+size_t finite_audio_resampler_drain_s16(FiniteAudioResampler *rs, short *out, size_t outFrames) {
+    if (rs->up == rs->down) {
+        return 0;
+    }
+
+    if (!rs->draining) {
+        rs->draining = true;
+        rs->drainLeft = rs->taps / 2;
+    }
+
+    uint32_t channels = rs->channels;
+    float *zeros = rs->scratch;
+    float *outScratch = rs->scratch + (FINITE_AUDIO_RESAMPLER_BLOCK * channels);
+    size_t produced = 0;
+
+    while (produced < outFrames) {
+        size_t inChunk = rs->drainLeft;
+        size_t outChunk = outFrames - produced < FINITE_AUDIO_RESAMPLER_BLOCK ? outFrames - produced : FINITE_AUDIO_RESAMPLER_BLOCK;
+        memset(zeros, 0, inChunk * channels * sizeof(float));
+
+        size_t used;
+        size_t got = finite_audio_resampler_run(rs, zeros, inChunk, outScratch, outChunk, &used);
+        finite_audio_dsp_f32_to_s16(out + (produced * channels), outScratch, got * channels);
+
+        rs->drainLeft -= used;
+        produced += got;
+        if (got == 0) {
+            break;
+        }
+    }
+
+    return produced;
+}
+
+size_t finite_audio_resampler_get_output_frames(FiniteAudioResampler *rs, size_t inFrames) {
+    return (size_t) (((uint64_t) inFrames * rs->up + rs->down - 1) / rs->down);
+}
+
+void finite_audio_resampler_destroy_debug(const char *file, const char *func, int line, FiniteAudioResampler *rs) {
+    if (!rs) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to destroy NULL resampler");
+        return;
+    }
+
+    if (rs->history) {
+        for (uint32_t c = 0; c < rs->channels; c++) {
+            free(rs->history[c]);
+        }
+    }
+
+    free(rs->history);
+    free(rs->coeffs);
+    free(rs->scratch);
+    free(rs);
+}
@@ -0,0 +1,128 @@
+#include "../include/audio/audio-ring.h"
+#include "../include/log.h"
+#include <string.h>
+
+static size_t next_pow2(size_t value) {
+    size_t out = 1;
+    while (out < value) {
+        out <<= 1;
+    }
+    return out;
+}
+
+bool finite_audio_ring_init_debug(const char *file, const char *func, int line, FiniteAudioRing *ring, size_t frames, uint32_t channels) {
+    if (!ring || frames == 0 || channels == 0) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to create ring with NULL ring or no size (Frames: %zu Channels: %d)", frames, channels);
+        return false;
+    }
+
+    size_t capacity = next_pow2(frames);
+    short *data = aligned_alloc(64, ((capacity * channels * sizeof(short)) + 63) & ~(size_t) 63);
+    if (!data) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to create ring (no memory available)");
+        return false;
+    }
+
+    ring->data = data;
+    ring->capacity = capacity;
+    ring->mask = capacity - 1;
+    ring->channels = channels;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+
+    finite_log_internal(LOG_LEVEL_DEBUG, file, line, func, "Created ring with %zu frames", capacity);
+    return true;
+}
+
+void finite_audio_ring_free(FiniteAudioRing *ring) {
+    free(ring->data);
+    ring->data = NULL;
+    ring->capacity = 0;
+    ring->mask = 0;
+}
+
+// only safe while neither side is running
+void finite_audio_ring_reset(FiniteAudioRing *ring) {
+    atomic_store_explicit(&ring->head, 0, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, 0, memory_order_relaxed);
+}
+
+size_t finite_audio_ring_readable(FiniteAudioRing *ring) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    return head - tail;
+}
+
+size_t finite_audio_ring_writable(FiniteAudioRing *ring) {
+    return ring->capacity - finite_audio_ring_readable(ring);
+}
+
+short *finite_audio_ring_write_begin(FiniteAudioRing *ring, size_t *frames) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    size_t space = ring->capacity - (head - tail);
+    size_t offset = head & ring->mask;
+    size_t contiguous = ring->capacity - offset;
+
+    *frames = space < contiguous ? space : contiguous;
+    return ring->data + (offset * ring->channels);
+}
+
+void finite_audio_ring_write_commit(FiniteAudioRing *ring, size_t frames) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    atomic_store_explicit(&ring->head, head + frames, memory_order_release);
+}
+
+const short *finite_audio_ring_read_begin(FiniteAudioRing *ring, size_t *frames) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+    size_t used = head - tail;
+    size_t offset = tail & ring->mask;
+    size_t contiguous = ring->capacity - offset;
+
+    *frames = used < contiguous ? used : contiguous;
+    return ring->data + (offset * ring->channels);
+}
+
+void finite_audio_ring_read_commit(FiniteAudioRing *ring, size_t frames) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, tail + frames, memory_order_release);
+}
+
+size_t finite_audio_ring_write(FiniteAudioRing *ring, const short *frames, size_t count) {
+    size_t written = 0;
+    while (written < count) {
+        size_t space;
+        short *dst = finite_audio_ring_write_begin(ring, &space);
+        if (space == 0) {
+            break;
+        }
+
+        size_t todo = count - written < space ? count - written : space;
+        memcpy(dst, frames + (written * ring->channels), todo * ring->channels * sizeof(short));
+        finite_audio_ring_write_commit(ring, todo);
+        written += todo;
+    }
+
+    return written;
+}
+
+size_t finite_audio_ring_read(FiniteAudioRing *ring, short *out, size_t count) {
+    size_t read = 0;
+    while (read < count) {
+        size_t avail;
+        const short *src = finite_audio_ring_read_begin(ring, &avail);
+        if (avail == 0) {
+            break;
+        }
+
+        size_t todo = count - read < avail ? count - read : avail;
+        memcpy(out + (read * ring->channels), src, todo * ring->channels * sizeof(short));
+        finite_audio_ring_read_commit(ring, todo);
+        read += todo;
+    }
+
+    return read;
+}
@@ -0,0 +1,161 @@
+#include "../include/audio/audio-stream.h"
+#include "../include/log.h"
+#include <string.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static sf_count_t finite_audio_stream_get_filelen(void *user) {
+    FiniteAudioStream *stream = user;
+    return stream->size;
+}
+
+static sf_count_t finite_audio_stream_seek(sf_count_t offset, int whence, void *user) {
+    FiniteAudioStream *stream = user;
+    sf_count_t target;
+    switch (whence) {
+        case SEEK_SET:
+            target = offset;
+            break;
+        case SEEK_CUR:
+            target = stream->offset + offset;
+            break;
+        case SEEK_END:
+            target = stream->size + offset;
+            break;
+        default:
+            return -1;
+    }
+
+    if (target < 0 || target > stream->size) {
+        return -1;
+    }
+
+    // sndfile hops around a little while decoding. only a real jump restarts the prefetch window.
+    if (target > stream->advised || target < stream->advised - stream->aheadBytes) {
+        stream->advised = target;
+    }
+
+    stream->offset = target;
+    return target;
+}
+
+static sf_count_t finite_audio_stream_read(void *ptr, sf_count_t count, void *user) {
+    FiniteAudioStream *stream = user;
+    sf_count_t left = stream->size - stream->offset;
+    if (count > left) {
+        count = left;
+    }
+
+    memcpy(ptr, stream->data + stream->offset, count);
+    stream->offset += count;
+    return count;
+}
+
+static sf_count_t finite_audio_stream_write(const void *ptr, sf_count_t count, void *user) {
+    return 0;
+}
+
+static sf_count_t finite_audio_stream_tell(void *user) {
+    FiniteAudioStream *stream = user;
+    return stream->offset;
+}
+
+FiniteAudioStream *finite_audio_stream_map_debug(const char *file, const char *func, int line, const char *path) {
+    // playback reads front to back so let the kernel read ahead aggressively and drop pages behind us
+    FiniteFileMap map;
+    if (!finite_file_map_debug(file, func, line, path, FINITE_FILE_HINT_SEQUENTIAL, &map)) {
+        return NULL;
+    }
+
+    FiniteAudioStream *stream = finite_audio_stream_from_memory_debug(file, func, line, map.data, map.size);
+    if (!stream) {
+        finite_file_unmap_debug(file, func, line, &map);
+        return NULL;
+    }
+
+    stream->map = map;
+    return stream;
+}
+
+FiniteAudioStream *finite_audio_stream_from_memory_debug(const char *file, const char *func, int line, const void *data, size_t size) {
+    if (!data || size == 0) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to stream from NULL or empty memory");
+        return NULL;
+    }
+
+    FiniteAudioStream *stream = calloc(1, sizeof(FiniteAudioStream));
+    if (!stream) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to create stream (no memory available)");
+        return NULL;
+    }
+
+    stream->data = data;
+    stream->size = (sf_count_t) size;
+    return stream;
+}
+
+SNDFILE *finite_audio_stream_open_debug(const char *file, const char *func, int line, FiniteAudioStream *stream, SF_INFO *info) {
+    if (!stream || !info) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to open NULL stream");
+        return NULL;
+    }
+
+    static SF_VIRTUAL_IO io = {
+        .get_filelen = finite_audio_stream_get_filelen,
+        .seek = finite_audio_stream_seek,
+        .read = finite_audio_stream_read,
+        .write = finite_audio_stream_write,
+        .tell = finite_audio_stream_tell
+    };
+
+    stream->offset = 0;
+    stream->advised = 0;
+    memset(info, 0, sizeof(SF_INFO));
+
+    SNDFILE *sf = sf_open_virtual(&io, SFM_READ, info, stream);
+    if (!sf) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to open stream (%s)", sf_strerror(NULL));
+        return NULL;
+    }
+
+    return sf;
+}
+
+void finite_audio_stream_prefetch(FiniteAudioStream *stream) {
+    if (stream->aheadBytes == 0 || stream->advised >= stream->size) {
+        return;
+    }
+
+    // top the window up once half of it has been read so this is a syscall every so often, not every read
+    if (stream->advised - stream->offset >= stream->aheadBytes / 2) {
+        return;
+    }
+
+    sf_count_t end = stream->offset + stream->aheadBytes;
+    if (end > stream->size) {
+        end = stream->size;
+    }
+
+    uintptr_t page = (uintptr_t) sysconf(_SC_PAGESIZE);
+    sf_count_t from = stream->advised > stream->offset ? stream->advised : stream->offset;
+    uintptr_t start = (uintptr_t) (stream->data + from) & ~(page - 1);
+    uintptr_t stop = (uintptr_t) (stream->data + end);
+
+    // it's only a hint. memory that isn't a file mapping just ignores it.
+    madvise((void *) start, stop - start, MADV_WILLNEED);
+    stream->advised = end;
+}
+
+void finite_audio_stream_destroy_debug(const char *file, const char *func, int line, FiniteAudioStream *stream) {
+    if (!stream) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to destroy NULL stream");
+        return;
+    }
+
+    if (stream->map.data) {
+        finite_file_unmap_debug(file, func, line, &stream->map);
+    }
+
+    free(stream);
+}
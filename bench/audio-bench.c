@@ -0,0 +1,322 @@
+#include "../include/audio/audio.h"
+#include "../include/log.h"
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+// audio benchmark. it needs no hardware: by default everything plays into alsa's null pcm.
+// the null pcm takes frames as fast as they come, so the soak reports how far ahead of real time the engine
+// runs instead of waiting on a clock. pass --device to soak a real (paced) device and count actual xruns.
+//
+// usage: audio-bench [--device NAME] [--seconds N] [--load THREADS] [--latency low|balanced|power]
+
+#define BENCH_RATE 44100
+#define BENCH_SECONDS 10
+#define BENCH_BLOCK 4096
+
+typedef struct {
+    const char *name;
+    int format;
+} BenchFormat;
+
+static const BenchFormat formats[] = {
+    { "wav", SF_FORMAT_WAV | SF_FORMAT_PCM_16 },
+    { "flac", SF_FORMAT_FLAC | SF_FORMAT_PCM_16 },
+    { "ogg", SF_FORMAT_OGG | SF_FORMAT_VORBIS },
+#ifdef SF_FORMAT_MPEG
+    { "mp3", SF_FORMAT_MPEG | SF_FORMAT_MPEG_LAYER_III },
+#endif
+};
+
+static _Atomic bool loadRunning;
+
+static double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+// something a little more like music than a sine so the lossy encoders have to work
+static void bench_signal(short *out, size_t frames, size_t start) {
+    uint32_t seed = (uint32_t) start * 2654435761u;
+    for (size_t i = 0; i < frames; i++) {
+        double t = (double) (start + i) / BENCH_RATE;
+        double v = 0.4 * sin(2 * M_PI * 220.0 * t) + 0.2 * sin(2 * M_PI * 331.0 * t) + 0.1 * sin(2 * M_PI * 1740.0 * t);
+        seed = seed * 1664525u + 1013904223u;
+        v += 0.02 * (((double) (seed >> 8) / (1 << 24)) - 0.5);
+        out[i * 2] = (short) (v * 32767 * 0.8);
+        out[i * 2 + 1] = (short) (v * 32767 * 0.7);
+    }
+}
+
+static bool bench_write_file(const char *path, int format) {
+    SF_INFO info = { .samplerate = BENCH_RATE, .channels = 2, .format = format };
+    if (!sf_format_check(&info)) {
+        return false;
+    }
+
+    SNDFILE *file = sf_open(path, SFM_WRITE, &info);
+    if (!file) {
+        return false;
+    }
+
+    short *block = malloc(BENCH_BLOCK * 2 * sizeof(short));
+    for (size_t done = 0; done < (size_t) BENCH_RATE * BENCH_SECONDS; done += BENCH_BLOCK) {
+        bench_signal(block, BENCH_BLOCK, done);
+        sf_writef_short(file, block, BENCH_BLOCK);
+    }
+
+    free(block);
+    sf_close(file);
+    return true;
+}
+
+static void bench_decode(const char *dir, char *wavPath, size_t wavPathLen) {
+    printf("\n== decode (%d s of stereo %d Hz) ==\n", BENCH_SECONDS, BENCH_RATE);
+    printf("%-8s %14s %10s\n", "format", "frames/s", "realtime");
+
+    short *block = malloc(BENCH_BLOCK * 2 * sizeof(short));
+    for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+        char path[512];
+        snprintf(path, sizeof(path), "%s/bench.%s", dir, formats[f].name);
+        if (!bench_write_file(path, formats[f].format)) {
+            printf("%-8s %14s\n", formats[f].name, "unsupported");
+            continue;
+        }
+
+        if (f == 0) {
+            snprintf(wavPath, wavPathLen, "%s", path);
+        }
+
+        SF_INFO info = { 0 };
+        SNDFILE *file = sf_open(path, SFM_READ, &info);
+        if (!file) {
+            printf("%-8s %14s\n", formats[f].name, "unreadable");
+            continue;
+        }
+
+        sf_count_t total = 0;
+        sf_count_t got;
+        double start = bench_now();
+        while ((got = sf_readf_short(file, block, BENCH_BLOCK)) > 0) {
+            total += got;
+        }
+        double elapsed = bench_now() - start;
+        sf_close(file);
+
+        printf("%-8s %14.0f %9.0fx\n", formats[f].name, total / elapsed, (total / elapsed) / BENCH_RATE);
+    }
+
+    // the engine runs every source through the resampler when the device wants another rate
+    static const char *tiers[] = { "fast", "medium", "high" };
+    size_t frames = (size_t) BENCH_RATE * BENCH_SECONDS;
+    short *in = malloc(frames * 2 * sizeof(short));
+    short *out = malloc(BENCH_BLOCK * 2 * sizeof(short));
+    bench_signal(in, frames, 0);
+
+    printf("\n== resample %d -> 48000 ==\n", BENCH_RATE);
+    printf("%-8s %14s %10s\n", "quality", "frames/s", "realtime");
+    for (int q = FINITE_AUDIO_RESAMPLE_FAST; q <= FINITE_AUDIO_RESAMPLE_HIGH; q++) {
+        FiniteAudioResampler *rs = finite_audio_resampler_create(BENCH_RATE, 48000, 2, q);
+        if (!rs) {
+            continue;
+        }
+
+        size_t used = 0;
+        double start = bench_now();
+        while (used < frames) {
+            size_t inFrames = frames - used;
+            size_t outFrames = BENCH_BLOCK;
+            finite_audio_resampler_process_s16(rs, in + (used * 2), &inFrames, out, &outFrames);
+            used += inFrames;
+        }
+        double elapsed = bench_now() - start;
+
+        printf("%-8s %14.0f %9.0fx\n", tiers[q], frames / elapsed, (frames / elapsed) / BENCH_RATE);
+        finite_audio_resampler_destroy(rs);
+    }
+
+    free(in);
+    free(out);
+    free(block);
+}
+
+static void bench_mixer(void) {
+    static const uint32_t counts[] = { 1, 8, 32, 128 };
+    size_t clipFrames = 48000;
+    size_t renderFrames = 48000 * BENCH_SECONDS;
+    short *clip = malloc(clipFrames * 2 * sizeof(short));
+    short *out = malloc(FINITE_AUDIO_MIXER_BLOCK * 2 * sizeof(short));
+    bench_signal(clip, clipFrames, 0);
+
+    printf("\n== mixer (%d s at 48000 Hz) ==\n", BENCH_SECONDS);
+    printf("%-8s %14s %14s %10s\n", "voices", "us/block", "ns/voice/frame", "realtime");
+    for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        FiniteAudioMixer *mixer = finite_audio_mixer_create(NULL, 48000, counts[c]);
+        if (!mixer) {
+            continue;
+        }
+
+        for (uint32_t v = 0; v < counts[c]; v++) {
+            FiniteAudioVoiceInfo info = {
+                .pcm = clip,
+                .frames = clipFrames,
+                .channels = 2,
+                .gain = 0.5f,
+                .pan = ((float) v / counts[c]) * 2.0f - 1.0f,
+                .loop = true
+            };
+            finite_audio_mixer_play(mixer, &info);
+        }
+        // the first render picks up the queued voices
+        finite_audio_mixer_render(mixer, out, FINITE_AUDIO_MIXER_BLOCK);
+
+        size_t done = 0;
+        double start = bench_now();
+        while (done < renderFrames) {
+            done += finite_audio_mixer_render(mixer, out, FINITE_AUDIO_MIXER_BLOCK);
+        }
+        double elapsed = bench_now() - start;
+
+        double blocks = (double) done / FINITE_AUDIO_MIXER_BLOCK;
+        printf("%-8u %14.2f %14.3f %9.0fx\n", counts[c], (elapsed * 1e6) / blocks, (elapsed * 1e9) / ((double) done * counts[c]), (done / elapsed) / 48000);
+        finite_audio_mixer_destroy(mixer);
+    }
+
+    free(clip);
+    free(out);
+}
+
+// keeps a core busy so the soak sees the scheduler pressure a loaded console would
+static void *bench_load(void *data) {
+    volatile double x = 1.0;
+    while (atomic_load_explicit(&loadRunning, memory_order_relaxed)) {
+        for (int i = 0; i < 100000; i++) {
+            x = x * 1.0000001 + 0.0000001;
+        }
+    }
+    return NULL;
+}
+
+// loops the wav file forever so the soak lasts as long as asked
+static size_t bench_fill(FinitePlaybackDevice *dev, short *out, size_t frames, void *data) {
+    SNDFILE *file = data;
+    sf_count_t got = sf_readf_short(file, out, frames);
+    if (got <= 0) {
+        sf_seek(file, 0, SEEK_SET);
+        got = sf_readf_short(file, out, frames);
+    }
+    return got > 0 ? (size_t) got : 0;
+}
+
+static void bench_soak(const char *device, const char *wavPath, int seconds, int load, FiniteAudioLatency latency) {
+    printf("\n== soak (%s, %d s, %d load thread(s)) ==\n", device, seconds, load);
+
+    SF_INFO info = { 0 };
+    SNDFILE *file = wavPath[0] ? sf_open(wavPath, SFM_READ, &info) : NULL;
+    if (!file) {
+        printf("no source file to play\n");
+        return;
+    }
+
+    FinitePlaybackDevice *dev = finite_audio_device_open(device);
+    if (!dev) {
+        sf_close(file);
+        return;
+    }
+
+    finite_audio_set_latency(dev, latency);
+    if (!finite_audio_init_output(dev, info.samplerate, info.channels, bench_fill, file) || !finite_audio_play_async(dev)) {
+        finite_audio_cleanup(dev);
+        sf_close(file);
+        return;
+    }
+
+    pthread_t *threads = calloc(load > 0 ? load : 1, sizeof(pthread_t));
+    atomic_store(&loadRunning, true);
+    for (int i = 0; i < load; i++) {
+        pthread_create(&threads[i], NULL, bench_load, NULL);
+    }
+
+    double start = bench_now();
+    struct timespec tick = { .tv_sec = 0, .tv_nsec = 50 * 1000000 };
+    while (dev->isPlaying && bench_now() - start < seconds) {
+        nanosleep(&tick, NULL);
+    }
+    double elapsed = bench_now() - start;
+    sf_count_t position = finite_audio_get_position(dev);
+
+    FiniteAudioStats stats;
+    finite_audio_get_stats(dev, &stats);
+
+    atomic_store(&loadRunning, false);
+    for (int i = 0; i < load; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+
+    if (dev->isPlaying) {
+        finite_audio_stop(dev);
+    }
+    finite_audio_wait(dev);
+
+    printf("device rate       %u Hz, buffer %lu, period %lu\n", dev->deviceRate, stats.bufferFrames, stats.periodFrames);
+    printf("played            %ld frames in %.2f s (%.1fx realtime)\n", (long) position, elapsed, (position / elapsed) / info.samplerate);
+    printf("writes            %lu\n", (unsigned long) stats.writes);
+    printf("xruns             %lu\n", (unsigned long) stats.xruns);
+    printf("device fill       min %lu avg %.0f max %lu\n", stats.fillMin, stats.fillAvg, stats.fillMax);
+    printf("ring fill         avg %.0f max %zu\n", stats.ringFillAvg, stats.ringFillMax);
+    printf("write jitter      avg %.1f us max %.1f us\n", stats.jitterAvgUs, stats.jitterMaxUs);
+
+    finite_audio_cleanup(dev);
+    sf_close(file);
+}
+
+int main(int argc, char **argv) {
+    const char *device = "null";
+    int seconds = BENCH_SECONDS;
+    int load = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    FiniteAudioLatency latency = FINITE_AUDIO_LATENCY_LOW;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--device") == 0 && i + 1 < argc) {
+            device = argv[++i];
+        } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--load") == 0 && i + 1 < argc) {
+            load = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--latency") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "balanced") == 0) {
+                latency = FINITE_AUDIO_LATENCY_BALANCED;
+            } else if (strcmp(argv[i], "power") == 0) {
+                latency = FINITE_AUDIO_LATENCY_POWER_SAVE;
+            } else {
+                latency = FINITE_AUDIO_LATENCY_LOW;
+            }
+        } else {
+            fprintf(stderr, "usage: %s [--device NAME] [--seconds N] [--load THREADS] [--latency low|balanced|power]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    char dir[] = "/tmp/finite-bench-XXXXXX";
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    char wavPath[512] = "";
+    bench_decode(dir, wavPath, sizeof(wavPath));
+    bench_mixer();
+    bench_soak(device, wavPath, seconds, load, latency);
+
+    for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+        char path[512];
+        snprintf(path, sizeof(path), "%s/bench.%s", dir, formats[f].name);
+        remove(path);
+    }
+    rmdir(dir);
+    return 0;
+}
@@ -0,0 +1,469 @@
+#include "../include/aio.h"
+#include "../include/log.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// io_uring is driven through its syscalls directly so there's no liburing dependency
+
+static int finite_aio_uring_setup(uint32_t entries, struct io_uring_params *params) {
+    return (int) syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int finite_aio_uring_enter(int fd, uint32_t submit, uint32_t complete, uint32_t flags) {
+    return (int) syscall(__NR_io_uring_enter, fd, submit, complete, flags, NULL, 0);
+}
+
+static int finite_aio_uring_register(int fd, uint32_t opcode, void *arg, uint32_t args) {
+    return (int) syscall(__NR_io_uring_register, fd, opcode, arg, args);
+}
+
+static void finite_aio_uring_teardown(FiniteAio *aio) {
+    if (aio->sqes && aio->sqes != MAP_FAILED) {
+        munmap(aio->sqes, aio->sqesSize);
+    }
+    if (aio->cqRing && aio->cqRing != MAP_FAILED && aio->cqRing != aio->sqRing) {
+        munmap(aio->cqRing, aio->cqRingSize);
+    }
+    if (aio->sqRing && aio->sqRing != MAP_FAILED) {
+        munmap(aio->sqRing, aio->sqRingSize);
+    }
+    if (aio->ringFd >= 0) {
+        close(aio->ringFd);
+    }
+    aio->sqes = NULL;
+    aio->cqRing = NULL;
+    aio->sqRing = NULL;
+    aio->ringFd = -1;
+}
+
+static bool finite_aio_uring_init(FiniteAio *aio) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    // fails on old kernels, or where io_uring is turned off or filtered out (containers, sandboxes)
+    aio->ringFd = finite_aio_uring_setup(FINITE_AIO_DEPTH, &params);
+    if (aio->ringFd < 0) {
+        return false;
+    }
+
+    aio->sqEntries = params.sq_entries;
+    aio->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    aio->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    aio->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    // newer kernels put both rings in one mapping
+    bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single) {
+        aio->sqRingSize = aio->sqRingSize > aio->cqRingSize ? aio->sqRingSize : aio->cqRingSize;
+    }
+
+    aio->sqRing = mmap(NULL, aio->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, aio->ringFd, IORING_OFF_SQ_RING);
+    aio->cqRing = single ? aio->sqRing : mmap(NULL, aio->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, aio->ringFd, IORING_OFF_CQ_RING);
+    aio->sqes = mmap(NULL, aio->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, aio->ringFd, IORING_OFF_SQES);
+    if (aio->sqRing == MAP_FAILED || aio->cqRing == MAP_FAILED || aio->sqes == MAP_FAILED) {
+        finite_aio_uring_teardown(aio);
+        return false;
+    }
+
+    unsigned char *sq = aio->sqRing;
+    unsigned char *cq = aio->cqRing;
+    aio->sqHead = (uint32_t *) (sq + params.sq_off.head);
+    aio->sqTail = (uint32_t *) (sq + params.sq_off.tail);
+    aio->sqMask = (uint32_t *) (sq + params.sq_off.ring_mask);
+    aio->sqArray = (uint32_t *) (sq + params.sq_off.array);
+    aio->cqHead = (uint32_t *) (cq + params.cq_off.head);
+    aio->cqTail = (uint32_t *) (cq + params.cq_off.tail);
+    aio->cqMask = (uint32_t *) (cq + params.cq_off.ring_mask);
+    aio->cqes = cq + params.cq_off.cqes;
+
+    // completions signal the same eventfd the thread pool uses, so callers poll one fd either way
+    if (finite_aio_uring_register(aio->ringFd, IORING_REGISTER_EVENTFD, &aio->eventFd, 1) < 0) {
+        finite_aio_uring_teardown(aio);
+        return false;
+    }
+
+    return true;
+}
+
+static void finite_aio_uring_prepare(FiniteAio *aio, FiniteAioRequest *request) {
+    uint32_t tail = *aio->sqTail;
+    uint32_t index = tail & *aio->sqMask;
+    struct io_uring_sqe *sqe = &((struct io_uring_sqe *) aio->sqes)[index];
+
+    request->iov.iov_base = (char *) request->buffer + request->done;
+    request->iov.iov_len = request->size - request->done;
+
+    // readv rather than read so this works back to the first io_uring kernels
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    sqe->opcode = IORING_OP_READV;
+    sqe->fd = request->fd;
+    sqe->addr = (uintptr_t) &request->iov;
+    sqe->len = 1;
+    sqe->off = request->offset + request->done;
+    sqe->user_data = (uintptr_t) request;
+
+    aio->sqArray[index] = index;
+    __atomic_store_n(aio->sqTail, tail + 1, __ATOMIC_RELEASE);
+}
+
+static void *finite_aio_worker(void *data) {
+    FiniteAio *aio = data;
+
+    while (true) {
+        pthread_mutex_lock(&aio->lock);
+        while (!aio->pending && !aio->stopping) {
+            pthread_cond_wait(&aio->wake, &aio->lock);
+        }
+        FiniteAioRequest *request = aio->pending;
+        if (!request) {
+            pthread_mutex_unlock(&aio->lock);
+            break; // stopping and nothing's left
+        }
+        aio->pending = request->next;
+        pthread_mutex_unlock(&aio->lock);
+
+        while (request->done < request->size) {
+            ssize_t n = pread(request->fd, (char *) request->buffer + request->done, request->size - request->done, request->offset + request->done);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                request->result = n < 0 ? -errno : (ssize_t) request->done;
+                break;
+            }
+            request->done += n;
+        }
+        if (request->done == request->size) {
+            request->result = request->done;
+        }
+
+        pthread_mutex_lock(&aio->lock);
+        request->next = aio->completed;
+        aio->completed = request;
+        pthread_mutex_unlock(&aio->lock);
+
+        uint64_t one = 1;
+        write(aio->eventFd, &one, sizeof(one));
+    }
+
+    return NULL;
+}
+
+FiniteAio *finite_aio_create_debug(const char *file, const char *func, int line, FiniteAioBackend backend) {
+    FiniteAio *aio = calloc(1, sizeof(FiniteAio));
+    if (!aio) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to create aio context (no memory available)");
+        return NULL;
+    }
+
+    aio->ringFd = -1;
+    aio->eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (aio->eventFd < 0) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to create aio eventfd (%s)", strerror(errno));
+        free(aio);
+        return NULL;
+    }
+
+    if (backend != FINITE_AIO_BACKEND_THREADS && finite_aio_uring_init(aio)) {
+        aio->backend = FINITE_AIO_BACKEND_URING;
+    } else if (backend == FINITE_AIO_BACKEND_URING) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to set up io_uring (%s)", strerror(errno));
+        close(aio->eventFd);
+        free(aio);
+        return NULL;
+    } else {
+        aio->backend = FINITE_AIO_BACKEND_THREADS;
+        pthread_mutex_init(&aio->lock, NULL);
+        pthread_cond_init(&aio->wake, NULL);
+
+        aio->workers = calloc(FINITE_AIO_WORKERS, sizeof(pthread_t));
+        for (uint32_t i = 0; aio->workers && i < FINITE_AIO_WORKERS; i++) {
+            if (pthread_create(&aio->workers[i], NULL, finite_aio_worker, aio) != 0) {
+                break;
+            }
+            aio->_workers++;
+        }
+
+        if (aio->_workers == 0) {
+            finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to start aio workers");
+            free(aio->workers);
+            close(aio->eventFd);
+            free(aio);
+            return NULL;
+        }
+    }
+
+    finite_log_internal(LOG_LEVEL_DEBUG, file, line, func, "Created aio context using %s", finite_aio_backend(aio));
+    return aio;
+}
+
+bool finite_aio_read_debug(const char *file, const char *func, int line, FiniteAio *aio, FiniteAioRequest *request) {
+    if (!aio || !request) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to read with NULL aio context or request");
+        return false;
+    }
+
+    request->ownsFd = false;
+    if (request->path) {
+        request->fd = open(request->path, O_RDONLY | O_CLOEXEC);
+        if (request->fd < 0) {
+            finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to open %s (%s)", request->path, strerror(errno));
+            return false;
+        }
+        request->ownsFd = true;
+    }
+
+    if (request->size == 0) {
+        struct stat st;
+        if (fstat(request->fd, &st) < 0) {
+            finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to read size of %s (%s)", request->path ? request->path : "fd", strerror(errno));
+            goto fail;
+        }
+        request->size = st.st_size > request->offset ? st.st_size - request->offset : 0;
+    }
+
+    if (!request->buffer) {
+        request->buffer = malloc(request->size ? request->size : 1);
+        if (!request->buffer) {
+            finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to allocate %zu bytes for read", request->size);
+            goto fail;
+        }
+    }
+
+    request->done = 0;
+    request->result = 0;
+    request->next = NULL;
+    if (aio->queuedTail) {
+        aio->queuedTail->next = request;
+    } else {
+        aio->queued = request;
+    }
+    aio->queuedTail = request;
+    return true;
+
+fail:
+    if (request->ownsFd) {
+        close(request->fd);
+        request->ownsFd = false;
+    }
+    return false;
+}
+
+bool finite_aio_submit_debug(const char *file, const char *func, int line, FiniteAio *aio) {
+    if (!aio) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to submit NULL aio context");
+        return false;
+    }
+
+    if (aio->backend == FINITE_AIO_BACKEND_THREADS) {
+        uint32_t count = 0;
+        pthread_mutex_lock(&aio->lock);
+        while (aio->queued) {
+            FiniteAioRequest *request = aio->queued;
+            aio->queued = request->next;
+            request->next = aio->pending;
+            aio->pending = request;
+            count++;
+        }
+        pthread_cond_broadcast(&aio->wake);
+        pthread_mutex_unlock(&aio->lock);
+        aio->queuedTail = NULL;
+        aio->inflight += count;
+        return true;
+    }
+
+    // only as many as the completion ring can hold are in flight, the rest wait in the queue
+    uint32_t count = 0;
+    while (aio->queued && aio->inflight < aio->sqEntries) {
+        FiniteAioRequest *request = aio->queued;
+        aio->queued = request->next;
+        finite_aio_uring_prepare(aio, request);
+        aio->inflight++;
+        count++;
+    }
+    if (!aio->queued) {
+        aio->queuedTail = NULL;
+    }
+
+    while (count > 0) {
+        int submitted = finite_aio_uring_enter(aio->ringFd, count, 0, 0);
+        if (submitted < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+                continue;
+            }
+            finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to submit reads (%s)", strerror(errno));
+            return false;
+        }
+        count -= submitted;
+    }
+
+    return true;
+}
+
+int finite_aio_get_fd(FiniteAio *aio) {
+    return aio->eventFd;
+}
+
+static void finite_aio_finish(FiniteAioRequest *request) {
+    if (request->ownsFd) {
+        close(request->fd);
+        request->ownsFd = false;
+    }
+}
+
+// takes finished requests off the backend. short reads from io_uring go back on the queue for the rest.
+// returns the finished ones in completion order.
+static FiniteAioRequest *finite_aio_reap(FiniteAio *aio) {
+    uint64_t count;
+    read(aio->eventFd, &count, sizeof(count));
+
+    FiniteAioRequest *first = NULL;
+    FiniteAioRequest **last = &first;
+
+    if (aio->backend == FINITE_AIO_BACKEND_THREADS) {
+        pthread_mutex_lock(&aio->lock);
+        FiniteAioRequest *done = aio->completed;
+        aio->completed = NULL;
+        pthread_mutex_unlock(&aio->lock);
+
+        // the workers push onto the front so flip it back around
+        while (done) {
+            FiniteAioRequest *next = done->next;
+            done->next = first;
+            first = done;
+            aio->inflight--;
+            done = next;
+        }
+        return first;
+    }
+
+    uint32_t head = *aio->cqHead;
+    uint32_t tail = __atomic_load_n(aio->cqTail, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++) {
+        struct io_uring_cqe *cqe = &((struct io_uring_cqe *) aio->cqes)[head & *aio->cqMask];
+        FiniteAioRequest *request = (FiniteAioRequest *) (uintptr_t) cqe->user_data;
+        aio->inflight--;
+
+        if (cqe->res > 0 && request->done + cqe->res < request->size) {
+            request->done += cqe->res;
+            request->next = aio->queued;
+            aio->queued = request;
+            if (!aio->queuedTail) {
+                aio->queuedTail = request;
+            }
+            continue;
+        }
+
+        request->result = cqe->res < 0 ? cqe->res : (ssize_t) (request->done + cqe->res);
+        request->next = NULL;
+        *last = request;
+        last = &request->next;
+    }
+    __atomic_store_n(aio->cqHead, head, __ATOMIC_RELEASE);
+    return first;
+}
+
+uint32_t finite_aio_dispatch(FiniteAio *aio) {
+    FiniteAioRequest *request = finite_aio_reap(aio);
+    uint32_t count = 0;
+
+    while (request) {
+        FiniteAioRequest *next = request->next;
+        finite_aio_finish(request);
+        if (request->callback) {
+            request->callback(request, request->data);
+        }
+        request = next;
+        count++;
+    }
+
+    // room was freed up, or a short read needs the rest
+    if (aio->queued) {
+        finite_aio_submit_debug(__FILE__, __func__, __LINE__, aio);
+    }
+    return count;
+}
+
+bool finite_aio_wait_debug(const char *file, const char *func, int line, FiniteAio *aio) {
+    if (!aio) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to wait on NULL aio context");
+        return false;
+    }
+
+    if (aio->queued && !finite_aio_submit_debug(file, func, line, aio)) {
+        return false;
+    }
+
+    while (aio->inflight > 0 || aio->queued) {
+        struct pollfd pfd = {.fd = aio->eventFd, .events = POLLIN};
+        if (poll(&pfd, 1, -1) < 0 && errno != EINTR) {
+            finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to wait for reads (%s)", strerror(errno));
+            return false;
+        }
+        finite_aio_dispatch(aio);
+    }
+
+    return true;
+}
+
+const char *finite_aio_backend(FiniteAio *aio) {
+    return aio->backend == FINITE_AIO_BACKEND_URING ? "io_uring" : "threads";
+}
+
+void finite_aio_destroy_debug(const char *file, const char *func, int line, FiniteAio *aio) {
+    if (!aio) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to destroy NULL aio context");
+        return;
+    }
+
+    // the kernel or a worker may still be writing into buffers, so let those finish before returning
+    while (aio->queued) {
+        FiniteAioRequest *request = aio->queued;
+        aio->queued = request->next;
+        finite_aio_finish(request);
+    }
+    aio->queuedTail = NULL;
+
+    if (aio->backend == FINITE_AIO_BACKEND_URING) {
+        while (aio->inflight > 0) {
+            struct pollfd pfd = {.fd = aio->eventFd, .events = POLLIN};
+            poll(&pfd, 1, -1);
+            for (FiniteAioRequest *request = finite_aio_reap(aio); request; request = request->next) {
+                finite_aio_finish(request);
+            }
+            // short reads were requeued by the reap, drop them too
+            while (aio->queued) {
+                FiniteAioRequest *request = aio->queued;
+                aio->queued = request->next;
+                finite_aio_finish(request);
+            }
+        }
+        finite_aio_uring_teardown(aio);
+    } else {
+        pthread_mutex_lock(&aio->lock);
+        aio->stopping = true;
+        pthread_cond_broadcast(&aio->wake);
+        pthread_mutex_unlock(&aio->lock);
+        for (uint32_t i = 0; i < aio->_workers; i++) {
+            pthread_join(aio->workers[i], NULL);
+        }
+        for (FiniteAioRequest *request = finite_aio_reap(aio); request; request = request->next) {
+            finite_aio_finish(request);
+        }
+        pthread_mutex_destroy(&aio->lock);
+        pthread_cond_destroy(&aio->wake);
+        free(aio->workers);
+    }
+
+    close(aio->eventFd);
+    free(aio);
+}
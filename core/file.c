@@ -1,6 +1,34 @@
 #include "../include/core.h"
+#include "../include/log.h"
+#include "../include/pack.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 char* finite_readfile(const char* filename, size_t* fileSize) {
+    // packed files are copied out so callers can still free what they get back
+    FiniteFileMap packed;
+    if (finite_pack_resolve(filename, &packed)) {
+        char* buffer = malloc(packed.size ? packed.size : 1);
+        if (!buffer) {
+            printf("failed to allocate memory for file: %s\n", filename);
+            finite_file_unmap(&packed);
+            return NULL;
+        }
+
+        // unmapping clears the size, so take it first
+        memcpy(buffer, packed.data, packed.size);
+        if (fileSize) {
+            *fileSize = packed.size;
+        }
+        finite_file_unmap(&packed);
+
+        return buffer;
+    }
+
     FILE* file = fopen(filename, "rb");
     if (!file) {
         printf("failed to open file: %s\n", filename);
@@ -41,6 +69,21 @@ char* finite_readfile(const char* filename, size_t* fileSize) {
 FileBuffer finite_read_raw_file(const char* filename) {
     FileBuffer buffer = {NULL, 0};
 
+    FiniteFileMap packed;
+    if (finite_pack_resolve(filename, &packed)) {
+        buffer.data = (uint32_t*)malloc(packed.size ? packed.size : 1);
+        if (!buffer.data) {
+            perror("Failed to allocate memory");
+            finite_file_unmap(&packed);
+            return buffer;
+        }
+
+        memcpy(buffer.data, packed.data, packed.size);
+        buffer.size = packed.size;
+        finite_file_unmap(&packed);
+        return buffer;
+    }
+
     FILE* file = fopen(filename, "rb"); // "rb" = read binary
     if (!file) {
         perror("Failed to open file");
@@ -62,4 +105,89 @@ FileBuffer finite_read_raw_file(const char* filename) {
     fclose(file);
 
     return buffer;
-}
\ No newline at end of file
+}
+
+static void finite_file_apply_hints(void *start, size_t length, FiniteFileHint hints) {
+    if (hints & FINITE_FILE_HINT_SEQUENTIAL) {
+        madvise(start, length, MADV_SEQUENTIAL);
+    } else if (hints & FINITE_FILE_HINT_RANDOM) {
+        madvise(start, length, MADV_RANDOM);
+    }
+
+    if (hints & FINITE_FILE_HINT_WILLNEED) {
+        madvise(start, length, MADV_WILLNEED);
+    }
+}
+
+bool finite_file_map_debug(const char *file, const char *func, int line, const char *path, FiniteFileHint hints, FiniteFileMap *map) {
+    if (!path || !map) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to map NULL path");
+        return false;
+    }
+
+    map->data = NULL;
+    map->size = 0;
+    map->borrowed = false;
+
+    if (finite_pack_resolve(path, map)) {
+        finite_file_advise(map, 0, map->size, hints);
+        return true;
+    }
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to open %s (%s)", path, strerror(errno));
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to map empty or unreadable file %s", path);
+        close(fd);
+        return false;
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping holds its own reference to the file
+    close(fd);
+    if (data == MAP_FAILED) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to map %s (%s)", path, strerror(errno));
+        return false;
+    }
+
+    finite_file_apply_hints(data, st.st_size, hints);
+    map->data = data;
+    map->size = st.st_size;
+    return true;
+}
+
+void finite_file_advise(FiniteFileMap *map, size_t offset, size_t length, FiniteFileHint hints) {
+    if (!map || !map->data || offset >= map->size) {
+        return;
+    }
+
+    if (length > map->size - offset) {
+        length = map->size - offset;
+    }
+
+    // madvise wants a page aligned start
+    uintptr_t page = (uintptr_t) sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t) map->data + offset;
+    uintptr_t aligned = start & ~(page - 1);
+    finite_file_apply_hints((void *) aligned, length + (start - aligned), hints);
+}
+
+void finite_file_unmap_debug(const char *file, const char *func, int line, FiniteFileMap *map) {
+    if (!map || !map->data) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to unmap NULL map");
+        return;
+    }
+
+    if (!map->borrowed) {
+        munmap((void *) map->data, map->size);
+    }
+
+    map->data = NULL;
+    map->size = 0;
+    map->borrowed = false;
+}
@@ -0,0 +1,3 @@
+// the modified jsmn.h only includes its implementation when JSMN_HEADER is set. this is the copy libfinite exports.
+#define JSMN_HEADER
+#include "../include/jsmn.h"
@@ -1,93 +1,181 @@
+// a private copy of jsmn with parent links. without them every closing bracket and comma walks back over all the
+// tokens before it, which makes big documents quadratic. core/jsmn.c has the plain exported one.
+#define JSMN_HEADER
+#define JSMN_STATIC
+#define JSMN_PARENT_LINKS
 #include "json.h"
 #include "log.h"
 #include <stdlib.h>
 #include <string.h>
 
-static int skip_tokens(jsmntok_t *tokens, int i) {
-    int count = 1;
+typedef struct {
+    const jsmntok_t *tokens;
+    int _tokens;
+    char *text; // the arena's copy of the input. strings are terminated in place.
+    FiniteJSONValue *values;
+    int _values;
+    FiniteJSONValue **members;
+    int _members;
+    uint32_t *slots; // for the indexes of big objects
+    size_t _slots;
+} FiniteJSONBuilder;
+
+// slots for an object of size members. at most half full so probes stay short.
+static uint32_t finite_json_index_size(int size) {
+    uint32_t slots = 16;
+    while (slots < (uint32_t) size * 2) {
+        slots *= 2;
+    }
+    return slots;
+}
+
+static void finite_json_index(FiniteJSONBuilder *builder, FiniteJSONValue *value) {
+    value->_index = finite_json_index_size(value->_members);
+    value->index = builder->slots + builder->_slots;
+    builder->_slots += value->_index;
+
+    // members go in order, so with a duplicated key the first one is found first like it is when scanning
+    uint32_t mask = value->_index - 1;
+    for (int i = 0; i < value->_members; i++) {
+        uint32_t slot = value->members[i]->hash & mask;
+        while (value->index[slot] != 0) {
+            slot = (slot + 1) & mask;
+        }
+        value->index[slot] = i + 1;
+    }
+}
+
+static char *finite_json_text(FiniteJSONBuilder *builder, const jsmntok_t *token) {
+    // a string ends on its closing quote and anything else on the character after it, which has already been tokenized
+    builder->text[token->end] = '\0';
+    return builder->text + token->start;
+}
+
+// fills value from the token at index. returns the index after it and everything inside it, or -1 if it's malformed.
+static int finite_json_build(FiniteJSONBuilder *builder, int index, FiniteJSONValue *value, int depth) {
+    if (index >= builder->_tokens || depth > FINITE_JSON_MAX_DEPTH) {
+        return -1;
+    }
+
+    const jsmntok_t *token = &builder->tokens[index++];
+    value->type = token->type;
+    if (token->type != JSMN_OBJECT && token->type != JSMN_ARRAY) {
+        value->value = finite_json_text(builder, token);
+        return index;
+    }
+
+    // children are laid out one after another so the whole tree is a single walk over the tokens
+    value->members = builder->members + builder->_members;
+    value->_members = token->size;
+    builder->_members += token->size;
+
+    for (int i = 0; i < token->size; i++) {
+        FiniteJSONValue *member = &builder->values[builder->_values++];
+        member->key = "";
+
+        if (token->type == JSMN_OBJECT) {
+            if (index >= builder->_tokens || builder->tokens[index].type == JSMN_OBJECT || builder->tokens[index].type == JSMN_ARRAY) {
+                return -1;
+            }
+            member->key = finite_json_text(builder, &builder->tokens[index++]);
+        }
+        member->hash = finite_json_hash(member->key);
 
-    if (tokens[i].type == JSMN_OBJECT || tokens[i].type == JSMN_ARRAY) {
-        for (int j = 0; j < tokens[i].size; j++) {
-            count += skip_tokens(tokens, i + count);
+        value->members[i] = member;
+        index = finite_json_build(builder, index, member, depth + 1);
+        if (index < 0) {
+            return -1;
         }
     }
 
-    return count;
+    if (token->type == JSMN_OBJECT && token->size >= FINITE_JSON_INDEX_MIN) {
+        finite_json_index(builder, value);
+    }
+
+    return index;
 }
 
-// parses arrays
 FiniteJSONValue *finite_json_parse_debug(const char *file, const char *func, int line, char *data) {
-    jsmn_parser p;
-    jsmntok_t tokens[128];
+    if (!data) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to parse NULL data");
+        return NULL;
+    }
 
+    size_t len = strlen(data);
+    jsmn_parser p;
     jsmn_init(&p);
-    int r = jsmn_parse(&p, data, strlen(data), tokens, 128);
+
+    // jsmn stops when it runs out of tokens and carries on from there once it's given more
+    unsigned int _tokens = len / 8 + 16;
+    jsmntok_t *tokens = NULL;
+    int r = JSMN_ERROR_NOMEM;
+    while (r == JSMN_ERROR_NOMEM) {
+        jsmntok_t *grown = realloc(tokens, _tokens * sizeof(jsmntok_t));
+        if (!grown) {
+            finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to parse (no memory)");
+            free(tokens);
+            return NULL;
+        }
+
+        tokens = grown;
+        r = jsmn_parse(&p, data, len, tokens, _tokens);
+        _tokens *= 2;
+    }
+
     if (r <= 0) {
-        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to parse");
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to parse (%s)", r == JSMN_ERROR_PART ? "truncated" : "invalid json");
+        free(tokens);
         return NULL;
     }
 
-    bool isKey = true;
-    FiniteJSONValue *values = calloc(1, sizeof(FiniteJSONValue));
-    values->key = "";
-    values->value = data;
-    int _keys = 0;
-    for (int i = 1; i < r; i++) {
-        int len = tokens[i].end - tokens[i].start;
-        char item_token[len + 1];
-        strncpy(item_token, data + tokens[i].start, len);
-        item_token[len] = '\0';
-        finite_log_internal(LOG_LEVEL_DEBUG, file, line, func, "item: %s (isKey: %s) [%d]", item_token, isKey == true ? "true" : "false", i);
-        // if iskey then create a new FiniteJSONValue and add it to the array. Otherwise get the latest item (_keys) and add the value to it. If its an object do a recursive search
-        if (isKey) {
-            FiniteJSONValue *item = calloc(1, sizeof(FiniteJSONValue));
-            item->key =  malloc(len + 1);
-            strncpy(item->key, item_token, len);
-            item->key[len] = '\0';
-            FiniteJSONValue **tmp = realloc(values->members, sizeof(FiniteJSONValue *) * (_keys + 1));
-            if (!tmp) {
-                finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to parse (no memory)");
-            }
-            values->members = tmp;
-            values->members[_keys] = item;
-            isKey = false;
-        } else {
-            if (tokens[i].type == JSMN_OBJECT) {
-                FiniteJSONValue *children =  finite_json_parse(item_token);
-                FiniteJSONValue *item = values->members[_keys];
-
-                item->members = malloc(sizeof(FiniteJSONValue*) * children->_members);
-                item->_members = children->_members;
-                
-                for (int j = 0; j < children->_members; j++) {
-                    item->members[j] = children->members[j];
-                }
-
-                item->value =  malloc(len + 1);
-                strncpy(item->value, item_token, len);
-                item->type = JSMN_OBJECT;
-                _keys++;
-                isKey = true; 
-                // skip used values
-                i += skip_tokens(tokens, i);
-
-                free(children);
-            } else {
-                FiniteJSONValue *item = values->members[_keys];
-                item->value =  malloc(len + 1);
-                strncpy(item->value, item_token, len);
-                item->type = tokens[i].type;
-                _keys++;
-                isKey = true;
-            }
+    // every value and member pointer comes from a token, so r of each (plus the root) always fits
+    size_t valuesSize = sizeof(FiniteJSONValue) * (r + 1);
+    size_t membersSize = sizeof(FiniteJSONValue *) * r;
+    size_t _slots = 0;
+    for (int i = 0; i < r; i++) {
+        if (tokens[i].type == JSMN_OBJECT && tokens[i].size >= FINITE_JSON_INDEX_MIN) {
+            _slots += finite_json_index_size(tokens[i].size);
         }
+    }
+    size_t slotsSize = sizeof(uint32_t) * _slots;
 
+    char *arena = malloc(valuesSize + membersSize + slotsSize + len + 1);
+    if (!arena) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to parse (no memory)");
+        free(tokens);
+        return NULL;
     }
 
-    values->_members = _keys;
-    values->type = JSMN_OBJECT;
+    FiniteJSONBuilder builder = {
+        .tokens = tokens,
+        ._tokens = r,
+        .values = (FiniteJSONValue *) arena,
+        ._values = 1,
+        .members = (FiniteJSONValue **) (arena + valuesSize),
+        .slots = (uint32_t *) (arena + valuesSize + membersSize),
+        .text = arena + valuesSize + membersSize + slotsSize
+    };
+    memset(arena, 0, valuesSize);
+    memset(builder.slots, 0, slotsSize);
+    memcpy(builder.text, data, len + 1);
+
+    // the root comes first in the arena, which is what lets finite_json_cleanup free it all at once
+    FiniteJSONValue *root = &builder.values[0];
+    root->key = "";
+    root->hash = finite_json_hash(root->key);
+    int end = finite_json_build(&builder, 0, root, 0);
+    free(tokens);
+    if (end < 0) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to parse (malformed or nested deeper than %d)", FINITE_JSON_MAX_DEPTH);
+        free(arena);
+        return NULL;
+    }
+
+    if (root->type == JSMN_OBJECT || root->type == JSMN_ARRAY) {
+        root->value = data;
+    }
 
-    return values;
+    return root;
 }
 
 char *finite_json_get_value_debug(const char *file, const char *func, int line, FiniteJSONValue *item) {
@@ -97,55 +185,68 @@ char *finite_json_get_value_debug(const char *file, const char *func, int line,
     return item->value;
 }
 
-char *finite_json_get_value_from_key_debug(const char *file, const char *func, int line, FiniteJSONValue *item, char *key) {
-    if (!key || !item) {
-        FINITE_LOG("No key or item was defined");
-       return NULL;
-    }
-
-
-    if (strcmp(item->key, key) == 0) {
-        finite_log_internal(LOG_LEVEL_DEBUG, file, line, func, "Key (inherited): %s", item->key);
-        return item->value;
+// position of key in item's members, or -1
+static int finite_json_find(FiniteJSONValue *item, const char *key, uint32_t hash) {
+    if (item->index) {
+        uint32_t mask = item->_index - 1;
+        for (uint32_t slot = hash & mask; item->index[slot] != 0; slot = (slot + 1) & mask) {
+            FiniteJSONValue *member = item->members[item->index[slot] - 1];
+            if (member->hash == hash && strcmp(member->key, key) == 0) {
+                return item->index[slot] - 1;
+            }
+        }
+        return -1;
     }
 
     for (int i = 0; i < item->_members; i++) {
-        finite_log_internal(LOG_LEVEL_DEBUG, file, line, func, "Key %s value: %s", item->members[i]->key, item->members[i]->value);
-        if (strcmp(item->members[i]->key, key) == 0) {
-            finite_log_internal(LOG_LEVEL_DEBUG, file, line, func, "Key (found): %s", item->members[i]->key);
-            return item->members[i]->value;
+        if (item->members[i]->hash == hash && strcmp(item->members[i]->key, key) == 0) {
+            return i;
         }
     }
+    return -1;
+}
 
-    return NULL;
+char *finite_json_get_value_from_key_debug(const char *file, const char *func, int line, FiniteJSONValue *item, char *key) {
+    return finite_json_get_value_from_key_hashed_debug(file, func, line, item, key, finite_json_hash(key));
 }
 
-int finite_json_get_index_from_key_debug(const char *file, const char *func, int line, FiniteJSONValue *item, char *key) {
-    if (!key) {
-       return -1;
+char *finite_json_get_value_from_key_hashed_debug(const char *file, const char *func, int line, FiniteJSONValue *item, const char *key, uint32_t hash) {
+    if (!key || !item) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "No key or item was defined");
+        return NULL;
+    }
+
+    if (item->hash == hash && strcmp(item->key, key) == 0) {
+        return item->value;
     }
 
+    int i = finite_json_find(item, key, hash);
+    return i < 0 ? NULL : item->members[i]->value;
+}
+
+int finite_json_get_index_from_key_debug(const char *file, const char *func, int line, FiniteJSONValue *item, char *key) {
+    return finite_json_get_index_from_key_hashed_debug(file, func, line, item, key, finite_json_hash(key));
+}
 
-    if (strcmp(item->key, key) == 0) {
-        finite_log_internal(LOG_LEVEL_DEBUG, file, line, func, "Key (inherited): %s", item->key);
+int finite_json_get_index_from_key_hashed_debug(const char *file, const char *func, int line, FiniteJSONValue *item, const char *key, uint32_t hash) {
+    if (!key || !item) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "No key or item was defined");
         return -1;
     }
 
-    for (int i = 0; i < item->_members; i++) {
-        finite_log_internal(LOG_LEVEL_DEBUG, file, line, func, "Key %s value: %s", item->members[i]->key, item->members[i]->value);
-        if (strcmp(item->members[i]->key, key) == 0) {
-            finite_log_internal(LOG_LEVEL_DEBUG, file, line, func, "Key (found): %s", item->members[i]->key);
-            return i;
-        }
+    if (item->hash == hash && strcmp(item->key, key) == 0) {
+        return -1;
     }
 
-    return -1;
+    return finite_json_find(item, key, hash);
 }
 
 void finite_json_cleanup_debug(const char *file, const char *func, int line, FiniteJSONValue *item) {
-    for (int i = 0; i < item->_members; i++) {
-        free(item->members[i]);
+    if (!item) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to clean up NULL json");
+        return;
     }
 
+    // keys, values, members and indexes all live in the root's arena
     free(item);
 }
\ No newline at end of file
@@ -1,4 +1,12 @@
 #include "../include/log.h"
+#include <stdatomic.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
 #define NONE ""
 #define RED    "\033[38;5;160m"
 #define ORANGE "\033[38;5;208m"
@@ -12,13 +20,149 @@
 
 #define RESET  "\033[0m"
 
+typedef struct FiniteLogRecord FiniteLogRecord;
+typedef struct FiniteLogRing FiniteLogRing;
+typedef struct FiniteLogPending FiniteLogPending;
+typedef struct FiniteLogSite FiniteLogSite;
+typedef struct FiniteLogSpec FiniteLogSpec;
+typedef struct FiniteLogTrace FiniteLogTrace;
+typedef struct FiniteLogRecorder FiniteLogRecorder;
+typedef struct FiniteLogLimit FiniteLogLimit;
+typedef struct FiniteLogLimitSite FiniteLogLimitSite;
+
+// a line that's been formatted by the thread that logged it but not written yet
+struct FiniteLogRecord {
+    struct timespec time;
+    FiniteLogLevel level;
+    int line;
+    const char *func;
+    char message[FINITE_LOG_MESSAGE_MAX];
+};
+
+// single producer ring owned by one logging thread. only the writer thread consumes it.
+struct FiniteLogRing {
+    _Alignas(64) _Atomic size_t head;
+    _Alignas(64) _Atomic size_t tail;
+    size_t claimed; // where the writer's current batch ends. only the writer touches it.
+    _Atomic uint64_t dropped;
+    _Atomic bool orphaned; // its thread exited. another thread may take it over once it's empty.
+    FiniteLogRing *next;
+    FiniteLogRecord records[FINITE_LOG_RING_SLOTS];
+};
+
+struct FiniteLogPending {
+    FiniteLogRecord *record;
+    size_t order;
+};
+
+// a call site that's been given an id in the binary log. fmt is published last so a reader that sees it sees the rest.
+struct FiniteLogSite {
+    _Atomic(const char *) fmt;
+    const char *file;
+    const char *func;
+    int line;
+    uint32_t id;
+};
+
+// one conversion in a printf format
+struct FiniteLogSpec {
+    const char *start; // the %
+    const char *end; // just past the conversion character
+    char flags[8];
+    bool widthStar;
+    bool precisionStar;
+    int width; // -1 when there isn't one
+    int precision;
+    char length[3];
+    char conversion; // 0 if the format ended or has something we can't read
+};
+
+// a line in the flight recorder. it's kept unformatted, the pointers are the call's own string literals.
+struct FiniteLogTrace {
+    uint64_t timestamp;
+    const char *file;
+    const char *func;
+    const char *fmt;
+    int line;
+    uint16_t size;
+    uint8_t level;
+    unsigned char args[FINITE_LOG_TRACE_ARGS];
+};
+
+// a thread's flight recorder. it overwrites its oldest line and is only read when it's dumped.
+struct FiniteLogRecorder {
+    _Atomic size_t head;
+    _Atomic bool orphaned;
+    FiniteLogRecorder *next;
+    FiniteLogTrace traces[FINITE_LOG_RECORDER_SLOTS];
+};
+
+// rate limiting and repeat collapsing for one level
+struct FiniteLogLimit {
+    _Atomic float rate; // lines per second per call site. 0 is unlimited.
+    _Atomic uint32_t burst;
+    _Atomic bool collapse;
+};
+
+// a call site's token bucket and the last line it wrote. everything but the key is only touched while busy is held.
+struct FiniteLogLimitSite {
+    _Atomic uint64_t key;
+    atomic_flag busy;
+    float tokens;
+    uint64_t refilled;
+    uint32_t suppressed;
+    uint64_t lastHash;
+    uint64_t lastWritten;
+    uint32_t repeats;
+    FiniteLogLevel level;
+    const char *file; // NULL until the site's first line
+    const char *func;
+    int line;
+};
+
 static struct FiniteLog {
     FILE *output;
     FiniteLogLevel level;
     bool withTimestamp;
     pthread_mutex_t lock;
+    // async mode
+    _Atomic bool async;
+    _Atomic uint32_t generation; // bumped on shutdown so threads drop rings that were freed
+    _Atomic(FiniteLogRing *) rings;
+    pthread_t writer;
+    pthread_mutex_t wakeLock;
+    pthread_cond_t wake;
+    pthread_cond_t drained;
+    bool stopping;
+    uint64_t flushRequested;
+    uint64_t flushDone;
+    // binary mode
+    _Atomic(FILE *) binary;
+    pthread_mutex_t siteLock;
+    uint32_t _sites;
+    // flight recorder
+    _Atomic bool recording;
+    _Atomic(FiniteLogRecorder *) recorders;
+    char recorderPath[PATH_MAX]; // kept here so a signal handler never has to allocate
+    struct sigaction previousSegv;
+    struct sigaction previousAbort;
+    // rate limiting
+    _Atomic bool limiting; // any level has a limit set
 } g_logger;
 
+static FiniteLogLimit g_limits[LOG_LEVEL_FATAL + 1];
+static FiniteLogLimitSite g_limitSites[FINITE_LOG_LIMIT_SITES];
+
+static FiniteLogSite g_sites[FINITE_LOG_SITES];
+
+static pthread_once_t ringKeyOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t ringKey;
+static _Thread_local FiniteLogRing *t_ring;
+static _Thread_local uint32_t t_generation;
+static pthread_once_t recorderKeyOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t recorderKey;
+static _Thread_local FiniteLogRecorder *t_recorder;
+
 const char *colors[6] = {
     NONE,
     GREY,
@@ -42,58 +186,1252 @@ void finite_log_init(FILE *out, FiniteLogLevel level, bool timestamp) {
     g_logger.level = level;
     g_logger.withTimestamp = timestamp;
     pthread_mutex_init(&g_logger.lock, NULL);
+    pthread_mutex_init(&g_logger.wakeLock, NULL);
+    pthread_cond_init(&g_logger.wake, NULL);
+    pthread_cond_init(&g_logger.drained, NULL);
+    pthread_mutex_init(&g_logger.siteLock, NULL);
+}
+
+static void finite_log_ring_orphan(void *data) {
+    FiniteLogRing *ring = data;
+    if (ring && atomic_load_explicit(&g_logger.generation, memory_order_acquire) == t_generation) {
+        atomic_store_explicit(&ring->orphaned, true, memory_order_release);
+    }
+}
+
+static void finite_log_make_key(void) {
+    pthread_key_create(&ringKey, finite_log_ring_orphan);
+}
+
+// the calling thread's ring. a thread that exited leaves its ring behind for the next new thread instead of freeing it,
+// so the list only ever grows to the most threads that were logging at once.
+static FiniteLogRing *finite_log_thread_ring(void) {
+    uint32_t generation = atomic_load_explicit(&g_logger.generation, memory_order_acquire);
+    if (t_ring && t_generation == generation) {
+        return t_ring;
+    }
+
+    pthread_once(&ringKeyOnce, finite_log_make_key);
+
+    FiniteLogRing *ring = atomic_load_explicit(&g_logger.rings, memory_order_acquire);
+    for (; ring; ring = ring->next) {
+        bool orphaned = true;
+        if (atomic_load_explicit(&ring->head, memory_order_acquire) == atomic_load_explicit(&ring->tail, memory_order_acquire) &&
+            atomic_compare_exchange_strong_explicit(&ring->orphaned, &orphaned, false, memory_order_acq_rel, memory_order_relaxed)) {
+            break;
+        }
+    }
+
+    if (!ring) {
+        ring = aligned_alloc(64, sizeof(FiniteLogRing));
+        if (!ring) {
+            return NULL;
+        }
+        memset(ring, 0, sizeof(FiniteLogRing));
+
+        FiniteLogRing *first = atomic_load_explicit(&g_logger.rings, memory_order_relaxed);
+        do {
+            ring->next = first;
+        } while (!atomic_compare_exchange_weak_explicit(&g_logger.rings, &first, ring, memory_order_release, memory_order_relaxed));
+    }
+
+    t_ring = ring;
+    t_generation = generation;
+    pthread_setspecific(ringKey, ring);
+    return ring;
+}
+
+static void finite_log_wake(void) {
+    pthread_mutex_lock(&g_logger.wakeLock);
+    pthread_cond_signal(&g_logger.wake);
+    pthread_mutex_unlock(&g_logger.wakeLock);
+}
+
+// copies the line into this thread's ring. nothing here blocks or touches the output.
+static void finite_log_push(FiniteLogLevel level, int line, const char *func, const char *fmt, va_list args) {
+    FiniteLogRing *ring = finite_log_thread_ring();
+    if (!ring) {
+        return;
+    }
+
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head - tail >= FINITE_LOG_RING_SLOTS) {
+        // the writer is behind. dropping is better than stalling the thread that's logging.
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    FiniteLogRecord *record = &ring->records[head % FINITE_LOG_RING_SLOTS];
+    clock_gettime(CLOCK_REALTIME, &record->time);
+    record->level = level;
+    record->line = line;
+    record->func = func;
+    vsnprintf(record->message, sizeof(record->message), fmt, args);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+    // otherwise the writer picks it up on its next tick
+    if (level >= LOG_LEVEL_ERROR || head + 1 - tail == FINITE_LOG_RING_SLOTS / 2) {
+        finite_log_wake();
+    }
+}
+
+static int finite_log_compare(const void *a, const void *b) {
+    const FiniteLogPending *x = a;
+    const FiniteLogPending *y = b;
+    if (x->record->time.tv_sec != y->record->time.tv_sec) {
+        return x->record->time.tv_sec < y->record->time.tv_sec ? -1 : 1;
+    }
+    if (x->record->time.tv_nsec != y->record->time.tv_nsec) {
+        return x->record->time.tv_nsec < y->record->time.tv_nsec ? -1 : 1;
+    }
+    return x->order < y->order ? -1 : 1;
+}
+
+// takes what's in every ring, puts it back in time order and writes it with one fwrite per buffer. returns false once there's nothing left.
+static bool finite_log_write_batch(FiniteLogPending *batch, char *out, size_t outSize) {
+    static time_t cachedSecond = -1;
+    static char cachedStamp[64];
+    size_t count = 0;
+
+    for (FiniteLogRing *ring = atomic_load_explicit(&g_logger.rings, memory_order_acquire); ring; ring = ring->next) {
+        size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        size_t take = head - tail;
+        if (take > FINITE_LOG_BATCH - count) {
+            take = FINITE_LOG_BATCH - count;
+        }
+
+        for (size_t i = 0; i < take; i++) {
+            batch[count].record = &ring->records[(tail + i) % FINITE_LOG_RING_SLOTS];
+            batch[count].order = count;
+            count++;
+        }
+        ring->claimed = tail + take;
+    }
+
+    if (count == 0) {
+        return false;
+    }
+
+    qsort(batch, count, sizeof(FiniteLogPending), finite_log_compare);
+
+    size_t used = 0;
+    for (size_t i = 0; i < count; i++) {
+        FiniteLogRecord *record = batch[i].record;
+
+        if (outSize - used < FINITE_LOG_MESSAGE_MAX + 256) {
+            fwrite(out, 1, used, g_logger.output);
+            used = 0;
+        }
+
+        // every line in the same second shares one localtime_r
+        const char *stamp = "";
+        if (g_logger.withTimestamp) {
+            if (record->time.tv_sec != cachedSecond) {
+                struct tm tm_now;
+                localtime_r(&record->time.tv_sec, &tm_now);
+                strftime(cachedStamp, sizeof(cachedStamp), "%H:%M:%S", &tm_now);
+                cachedSecond = record->time.tv_sec;
+            }
+            stamp = cachedStamp;
+        }
+
+        used += snprintf(out + used, outSize - used, "%s[Finite]%s - %s[%s]%s%s%s%s%s%s (in function %s() at line %d)%s\n",
+                         ORANGE, RESET, colors[record->level], names[record->level], RESET,
+                         g_logger.withTimestamp ? " (" : "", stamp, g_logger.withTimestamp ? "): " : ": ",
+                         record->message, DIM, record->func, record->line, RESET);
+        if (used >= outSize) {
+            used = outSize - 1; // only a very long function name gets here
+        }
+    }
+
+    // hand the slots back only after the text has been copied out of them
+    for (FiniteLogRing *ring = atomic_load_explicit(&g_logger.rings, memory_order_acquire); ring; ring = ring->next) {
+        atomic_store_explicit(&ring->tail, ring->claimed, memory_order_release);
+
+        uint64_t dropped = atomic_exchange_explicit(&ring->dropped, 0, memory_order_relaxed);
+        if (dropped > 0 && outSize - used > 128) {
+            used += snprintf(out + used, outSize - used, "%s[Finite]%s - %s[%s]%s: Dropped %lu log line(s) (logging thread was behind)\n",
+                             ORANGE, RESET, colors[LOG_LEVEL_WARN], names[LOG_LEVEL_WARN], RESET, (unsigned long) dropped);
+        }
+    }
+
+    fwrite(out, 1, used, g_logger.output);
+    return true;
 }
 
+static void *finite_log_writer(void *data) {
+    FiniteLogPending *batch = malloc(FINITE_LOG_BATCH * sizeof(FiniteLogPending));
+    size_t outSize = 64 * 1024;
+    char *out = malloc(outSize);
+
+    while (true) {
+        pthread_mutex_lock(&g_logger.wakeLock);
+        if (!g_logger.stopping && g_logger.flushDone == g_logger.flushRequested) {
+            struct timespec until;
+            clock_gettime(CLOCK_REALTIME, &until);
+            until.tv_nsec += FINITE_LOG_WRITER_TICK_MS * 1000000L;
+            if (until.tv_nsec >= 1000000000L) {
+                until.tv_sec++;
+                until.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&g_logger.wake, &g_logger.wakeLock, &until);
+        }
+        bool stopping = g_logger.stopping;
+        uint64_t requested = g_logger.flushRequested;
+        pthread_mutex_unlock(&g_logger.wakeLock);
+
+        bool wrote = false;
+        while (finite_log_write_batch(batch, out, outSize)) {
+            wrote = true;
+        }
+        if (wrote) {
+            fflush(g_logger.output);
+        }
+
+        pthread_mutex_lock(&g_logger.wakeLock);
+        g_logger.flushDone = requested;
+        pthread_cond_broadcast(&g_logger.drained);
+        pthread_mutex_unlock(&g_logger.wakeLock);
+
+        if (stopping) {
+            break;
+        }
+    }
+
+    free(batch);
+    free(out);
+    return NULL;
+}
+
+bool finite_log_set_async(bool async) {
+    pthread_mutex_lock(&g_logger.lock);
+    if (async == atomic_load_explicit(&g_logger.async, memory_order_relaxed)) {
+        pthread_mutex_unlock(&g_logger.lock);
+        return true;
+    }
+
+    if (async) {
+        g_logger.stopping = false;
+        if (pthread_create(&g_logger.writer, NULL, finite_log_writer, NULL) != 0) {
+            pthread_mutex_unlock(&g_logger.lock);
+            return false;
+        }
+        atomic_store_explicit(&g_logger.async, true, memory_order_release);
+    } else {
+        // new lines go straight to the output from here, the writer empties the rings before it exits
+        atomic_store_explicit(&g_logger.async, false, memory_order_release);
+        pthread_mutex_lock(&g_logger.wakeLock);
+        g_logger.stopping = true;
+        pthread_cond_signal(&g_logger.wake);
+        pthread_mutex_unlock(&g_logger.wakeLock);
+        pthread_join(g_logger.writer, NULL);
+    }
+
+    pthread_mutex_unlock(&g_logger.lock);
+    return true;
+}
+
+void finite_log_flush(void) {
+    if (!atomic_load_explicit(&g_logger.async, memory_order_acquire)) {
+        return;
+    }
+
+    pthread_mutex_lock(&g_logger.wakeLock);
+    uint64_t ticket = ++g_logger.flushRequested;
+    pthread_cond_signal(&g_logger.wake);
+    while (g_logger.flushDone < ticket && !g_logger.stopping) {
+        pthread_cond_wait(&g_logger.drained, &g_logger.wakeLock);
+    }
+    pthread_mutex_unlock(&g_logger.wakeLock);
+}
+
+static void finite_log_limit_flush(void);
+
 void finite_log_shutdown(void) {
+    finite_log_limit_flush();
+    finite_log_set_async(false);
+
+    FiniteLogRing *ring = atomic_exchange_explicit(&g_logger.rings, NULL, memory_order_acq_rel);
+    atomic_fetch_add_explicit(&g_logger.generation, 1, memory_order_release);
+    while (ring) {
+        FiniteLogRing *next = ring->next;
+        free(ring);
+        ring = next;
+    }
+
     pthread_mutex_destroy(&g_logger.lock);
+    pthread_mutex_destroy(&g_logger.wakeLock);
+    pthread_cond_destroy(&g_logger.wake);
+    pthread_cond_destroy(&g_logger.drained);
+    pthread_mutex_destroy(&g_logger.siteLock);
 }
 
-void finite_log_internal(FiniteLogLevel level, const char *file, int line, const char *func, const char *fmt, ...) {
-    if (g_logger.level > 0) {
-        if (level < g_logger.level) {
-            // if its below the required level ignore
+static uint64_t finite_log_clock(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// finds the next conversion at or after fmt. returns NULL when there are none left.
+static const char *finite_log_next_spec(const char *fmt, FiniteLogSpec *spec) {
+    const char *p = strchr(fmt, '%');
+    if (!p) {
+        return NULL;
+    }
+
+    memset(spec, 0, sizeof(FiniteLogSpec));
+    spec->start = p++;
+    spec->width = -1;
+    spec->precision = -1;
+
+    size_t flags = 0;
+    while (*p && strchr("-+ #0'", *p)) {
+        if (flags < sizeof(spec->flags) - 1) {
+            spec->flags[flags++] = *p;
+        }
+        p++;
+    }
+
+    if (*p == '*') {
+        spec->widthStar = true;
+        p++;
+    } else if (*p >= '0' && *p <= '9') {
+        spec->width = (int) strtol(p, (char **) &p, 10);
+    }
+
+    if (*p == '.') {
+        p++;
+        if (*p == '*') {
+            spec->precisionStar = true;
+            p++;
+        } else {
+            spec->precision = (int) strtol(p, (char **) &p, 10);
+        }
+    }
+
+    size_t length = 0;
+    while (*p && strchr("hlLqjzt", *p) && length < 2) {
+        spec->length[length++] = *p++;
+    }
+
+    if (*p && strchr("diouxXcseEfFgGaAp%n", *p)) {
+        spec->conversion = *p++;
+    }
+    spec->end = p;
+    return spec->start;
+}
+
+static bool finite_log_put(unsigned char *buffer, size_t *used, size_t cap, const void *data, size_t size) {
+    if (*used + size > cap) {
+        return false;
+    }
+    memcpy(buffer + *used, data, size);
+    *used += size;
+    return true;
+}
+
+// reads the arguments fmt asks for and appends their raw bytes. stops at anything it can't read the type of, or the
+// first argument that doesn't fit, so what's packed is always a prefix of the arguments the decoder can walk.
+static size_t finite_log_pack_args(unsigned char *buffer, size_t cap, const char *fmt, va_list args) {
+    FiniteLogSpec spec;
+    size_t used = 0;
+
+    while ((fmt = finite_log_next_spec(fmt, &spec))) {
+        fmt = spec.end;
+        if (spec.conversion == 0) {
+            break;
+        }
+
+        int64_t star;
+        if (spec.widthStar) {
+            star = va_arg(args, int);
+            if (!finite_log_put(buffer, &used, cap, &star, sizeof(star))) {
+                return used;
+            }
+        }
+        if (spec.precisionStar) {
+            star = va_arg(args, int);
+            if (!finite_log_put(buffer, &used, cap, &star, sizeof(star))) {
+                return used;
+            }
+        }
+
+        uint64_t value = 0;
+        double real;
+        switch (spec.conversion) {
+            case '%':
+                continue;
+            case 'n':
+                (void) va_arg(args, void *);
+                continue;
+            case 'd':
+            case 'i':
+            case 'o':
+            case 'u':
+            case 'x':
+            case 'X':
+            case 'c':
+                // everything is widened to 64 bits. the decoder narrows h and hh again.
+                if (spec.length[0] == 'l' && spec.length[1] == 'l') {
+                    value = va_arg(args, long long);
+                } else if (spec.length[0] == 'l' || spec.length[0] == 'q') {
+                    value = (spec.conversion == 'd' || spec.conversion == 'i') ? (uint64_t) va_arg(args, long) : va_arg(args, unsigned long);
+                } else if (spec.length[0] == 'z') {
+                    value = va_arg(args, size_t);
+                } else if (spec.length[0] == 'j') {
+                    value = va_arg(args, intmax_t);
+                } else if (spec.length[0] == 't') {
+                    value = va_arg(args, ptrdiff_t);
+                } else {
+                    value = (spec.conversion == 'd' || spec.conversion == 'i') ? (uint64_t) (int64_t) va_arg(args, int) : va_arg(args, unsigned int);
+                }
+                if (!finite_log_put(buffer, &used, cap, &value, sizeof(value))) {
+                    return used;
+                }
+                break;
+            case 'p':
+                value = (uintptr_t) va_arg(args, void *);
+                if (!finite_log_put(buffer, &used, cap, &value, sizeof(value))) {
+                    return used;
+                }
+                break;
+            case 's': {
+                if (spec.length[0] == 'l') {
+                    return used; // wide strings aren't used anywhere
+                }
+                const char *str = va_arg(args, const char *);
+                if (!str) {
+                    str = "(null)";
+                }
+                size_t length = strlen(str);
+                if (used + sizeof(uint16_t) >= cap) {
+                    return used;
+                }
+                if (length > cap - used - sizeof(uint16_t)) {
+                    length = cap - used - sizeof(uint16_t);
+                }
+                uint16_t size = (uint16_t) length;
+                finite_log_put(buffer, &used, cap, &size, sizeof(size));
+                finite_log_put(buffer, &used, cap, str, length);
+                break;
+            }
+            default:
+                real = spec.length[0] == 'L' ? (double) va_arg(args, long double) : va_arg(args, double);
+                if (!finite_log_put(buffer, &used, cap, &real, sizeof(real))) {
+                    return used;
+                }
+                break;
+        }
+    }
+
+    return used;
+}
+
+// builds the record that defines a call site. returns its size.
+static size_t finite_log_site_entry(unsigned char *buffer, uint32_t id, uint64_t timestamp, const char *file, int line, const char *func, const char *fmt) {
+    FiniteLogEntry entry = {.timestamp = timestamp, .site = id, .level = LOG_LEVEL_NONE};
+    size_t used = sizeof(FiniteLogEntry);
+    int32_t line32 = line;
+
+    finite_log_put(buffer, &used, FINITE_LOG_ENTRY_MAX, &line32, sizeof(line32));
+    const char *strings[3] = {file, func, fmt};
+    for (int i = 0; i < 3; i++) {
+        size_t length = strlen(strings[i]);
+        size_t room = FINITE_LOG_ENTRY_MAX - used - (3 - i); // leave space for every terminator
+        finite_log_put(buffer, &used, FINITE_LOG_ENTRY_MAX, strings[i], length < room ? length : room);
+        buffer[used++] = '\0';
+    }
+
+    entry.size = (uint16_t) (used - sizeof(FiniteLogEntry));
+    memcpy(buffer, &entry, sizeof(entry));
+    return used;
+}
+
+static void finite_log_write_site(FILE *out, uint32_t id, const char *file, int line, const char *func, const char *fmt) {
+    unsigned char buffer[FINITE_LOG_ENTRY_MAX];
+    size_t used = finite_log_site_entry(buffer, id, finite_log_clock(CLOCK_MONOTONIC), file, line, func, fmt);
+    fwrite(buffer, 1, used, out);
+}
+
+// finds or gives out the id for a call site. ids are only handed out under the lock, lookups never take it.
+static uint32_t finite_log_intern(FILE *out, const char *file, int line, const char *func, const char *fmt) {
+    uint64_t hash = ((uintptr_t) fmt ^ ((uintptr_t) file << 1) ^ ((uint64_t) line << 40)) * 0x9E3779B97F4A7C15ull;
+    size_t mask = FINITE_LOG_SITES - 1;
+    size_t start = hash >> 32;
+
+    for (int pass = 0; pass < 2; pass++) {
+        for (size_t i = 0; i < FINITE_LOG_SITES; i++) {
+            FiniteLogSite *site = &g_sites[(start + i) & mask];
+            const char *siteFmt = atomic_load_explicit(&site->fmt, memory_order_acquire);
+            if (!siteFmt) {
+                break;
+            }
+            if (siteFmt == fmt && site->file == file && site->line == line && site->func == func) {
+                if (pass == 1) {
+                    pthread_mutex_unlock(&g_logger.siteLock);
+                }
+                return site->id;
+            }
+        }
+
+        if (pass == 0) {
+            pthread_mutex_lock(&g_logger.siteLock); // someone may have added it while we looked
+        }
+    }
+
+    uint32_t id = UINT32_MAX; // the table is full. the caller defines the site in front of the line.
+    for (size_t i = 0; i < FINITE_LOG_SITES; i++) {
+        FiniteLogSite *site = &g_sites[(start + i) & mask];
+        if (!atomic_load_explicit(&site->fmt, memory_order_relaxed)) {
+            id = g_logger._sites++;
+            site->file = file;
+            site->func = func;
+            site->line = line;
+            site->id = id;
+            // the definition has to be in the file before anyone can use the id
+            finite_log_write_site(out, id, file, line, func, fmt);
+            atomic_store_explicit(&site->fmt, fmt, memory_order_release);
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&g_logger.siteLock);
+    return id;
+}
+
+static void finite_log_binary(FILE *out, FiniteLogLevel level, const char *file, int line, const char *func, const char *fmt, va_list args) {
+    unsigned char buffer[FINITE_LOG_ENTRY_MAX];
+    FiniteLogEntry entry = {.level = level};
+    entry.site = finite_log_intern(out, file, line, func, fmt);
+    entry.timestamp = finite_log_clock(CLOCK_MONOTONIC);
+    entry.size = (uint16_t) finite_log_pack_args(buffer + sizeof(FiniteLogEntry), sizeof(buffer) - sizeof(FiniteLogEntry), fmt, args);
+    memcpy(buffer, &entry, sizeof(entry));
+
+    if (entry.site == UINT32_MAX) {
+        flockfile(out);
+        finite_log_write_site(out, entry.site, file, line, func, fmt);
+        fwrite_unlocked(buffer, 1, sizeof(FiniteLogEntry) + entry.size, out);
+        funlockfile(out);
+    } else {
+        // one fwrite, so lines from different threads never interleave
+        fwrite(buffer, 1, sizeof(FiniteLogEntry) + entry.size, out);
+    }
+
+    if (level >= LOG_LEVEL_ERROR) {
+        fflush(out);
+    }
+}
+
+bool finite_log_set_binary(FILE *out) {
+    pthread_mutex_lock(&g_logger.siteLock);
+
+    FILE *old = atomic_exchange_explicit(&g_logger.binary, NULL, memory_order_acq_rel);
+    if (old) {
+        fflush(old);
+    }
+
+    // a new file needs every site defined again
+    for (size_t i = 0; i < FINITE_LOG_SITES; i++) {
+        atomic_store_explicit(&g_sites[i].fmt, NULL, memory_order_relaxed);
+    }
+    g_logger._sites = 0;
+
+    if (out) {
+        FiniteLogHeader header = {
+            .magic = FINITE_LOG_MAGIC,
+            .version = FINITE_LOG_VERSION,
+            .realtime = finite_log_clock(CLOCK_REALTIME),
+            .monotonic = finite_log_clock(CLOCK_MONOTONIC)
+        };
+        if (fwrite(&header, sizeof(header), 1, out) != 1) {
+            pthread_mutex_unlock(&g_logger.siteLock);
+            return false;
+        }
+        atomic_store_explicit(&g_logger.binary, out, memory_order_release);
+    }
+
+    pthread_mutex_unlock(&g_logger.siteLock);
+    return true;
+}
+
+static bool finite_log_take(const unsigned char **args, const unsigned char *end, void *out, size_t size) {
+    if ((size_t) (end - *args) < size) {
+        return false;
+    }
+    memcpy(out, *args, size);
+    *args += size;
+    return true;
+}
+
+// formats a line from its site's format and the raw arguments, one conversion at a time
+static void finite_log_unpack(FILE *out, const char *fmt, const unsigned char *args, size_t size) {
+    const unsigned char *end = args + size;
+    FiniteLogSpec spec;
+    const char *p;
+
+    while ((p = finite_log_next_spec(fmt, &spec))) {
+        fwrite(fmt, 1, p - fmt, out);
+        fmt = spec.end;
+        if (spec.conversion == 0) {
+            fputs(spec.start, out);
             return;
         }
+        if (spec.conversion == '%') {
+            fputc('%', out);
+            continue;
+        }
+        if (spec.conversion == 'n') {
+            continue;
+        }
 
-        pthread_mutex_lock(&g_logger.lock);
+        int64_t width = spec.width;
+        int64_t precision = spec.precision;
+        if ((spec.widthStar && !finite_log_take(&args, end, &width, sizeof(width))) ||
+            (spec.precisionStar && !finite_log_take(&args, end, &precision, sizeof(precision)))) {
+            fputs("<?>", out);
+            return;
+        }
 
-        char timestampBuf[64] = ""; // empty string if no timestamp is requested
-        if (g_logger.withTimestamp == true) {
-            struct timespec ts;
-            clock_gettime(CLOCK_REALTIME, &ts);
-            time_t now = ts.tv_sec;
-            struct tm tm_now;
-            localtime_r(&now, &tm_now);
-            strftime(timestampBuf, sizeof(timestampBuf), "%H:%M:%S", &tm_now);
+        // rebuild the conversion with a 64 bit length so the widened value prints the same
+        char format[48];
+        int at = snprintf(format, sizeof(format), "%%%s", spec.flags);
+        if (width >= 0) {
+            at += snprintf(format + at, sizeof(format) - at, "%d", (int) width);
+        }
+        if (precision >= 0) {
+            at += snprintf(format + at, sizeof(format) - at, ".%d", (int) precision);
         }
 
-        
+        uint64_t value;
+        double real;
+        switch (spec.conversion) {
+            case 'd':
+            case 'i':
+            case 'o':
+            case 'u':
+            case 'x':
+            case 'X':
+            case 'c':
+                if (!finite_log_take(&args, end, &value, sizeof(value))) {
+                    fputs("<?>", out);
+                    return;
+                }
+                bool isSigned = spec.conversion == 'd' || spec.conversion == 'i';
+                if (spec.length[0] == 'h' && spec.length[1] == 'h') {
+                    value = isSigned ? (uint64_t) (int64_t) (signed char) value : (unsigned char) value;
+                } else if (spec.length[0] == 'h') {
+                    value = isSigned ? (uint64_t) (int64_t) (short) value : (unsigned short) value;
+                }
+                if (spec.conversion == 'c') {
+                    snprintf(format + at, sizeof(format) - at, "c");
+                    fprintf(out, format, (int) value);
+                } else {
+                    snprintf(format + at, sizeof(format) - at, "ll%c", spec.conversion);
+                    fprintf(out, format, (long long) value);
+                }
+                break;
+            case 'p':
+                if (!finite_log_take(&args, end, &value, sizeof(value))) {
+                    fputs("<?>", out);
+                    return;
+                }
+                snprintf(format + at, sizeof(format) - at, "p");
+                fprintf(out, format, (void *) (uintptr_t) value);
+                break;
+            case 's': {
+                uint16_t length;
+                if (!finite_log_take(&args, end, &length, sizeof(length)) || (size_t) (end - args) < length) {
+                    fputs("<?>", out);
+                    return;
+                }
+                // the string isn't terminated in the record so the precision is capped at its length
+                if (precision < 0 || precision > length) {
+                    precision = length;
+                }
+                snprintf(format, sizeof(format), "%%%s", spec.flags);
+                at = strlen(format);
+                if (width >= 0) {
+                    at += snprintf(format + at, sizeof(format) - at, "%d", (int) width);
+                }
+                snprintf(format + at, sizeof(format) - at, ".%ds", (int) precision);
+                fprintf(out, format, (const char *) args);
+                args += length;
+                break;
+            }
+            default:
+                if (!finite_log_take(&args, end, &real, sizeof(real))) {
+                    fputs("<?>", out);
+                    return;
+                }
+                snprintf(format + at, sizeof(format) - at, "%c", spec.conversion);
+                fprintf(out, format, real);
+                break;
+        }
+    }
 
-        // print prep info
-        fprintf(g_logger.output, "%s[Finite]%s - %s[%s]%s",ORANGE, RESET,colors[level], names[level], RESET);
+    fputs(fmt, out);
+}
 
+bool finite_log_dump(FILE *in, FILE *out, bool color) {
+    FiniteLogHeader header;
+    if (fread(&header, sizeof(header), 1, in) != 1 || memcmp(header.magic, FINITE_LOG_MAGIC, 4) != 0) {
+        fprintf(stderr, "Unable to read log (not a binary log)\n");
+        return false;
+    }
+    if (header.version != FINITE_LOG_VERSION) {
+        fprintf(stderr, "Unable to read log version %u (expected %d)\n", header.version, FINITE_LOG_VERSION);
+        return false;
+    }
 
-        if (g_logger.withTimestamp) {
-            fprintf(g_logger.output, " (%s): ",timestampBuf);
+    FiniteLogSite *sites = NULL;
+    char **strings = NULL; // each site's definition, which the file/func/fmt pointers point into
+    uint32_t _sites = 0;
+    char *overflow = NULL;
+    FiniteLogSite overflowSite = {0};
+    unsigned char payload[FINITE_LOG_ENTRY_MAX];
+    FiniteLogEntry entry;
+    bool ok = true;
+
+    while (fread(&entry, sizeof(entry), 1, in) == 1) {
+        if (entry.size > sizeof(payload) || fread(payload, 1, entry.size, in) != entry.size) {
+            fprintf(stderr, "Unable to read log (truncated entry)\n");
+            ok = false;
+            break;
+        }
+
+        if (entry.level == LOG_LEVEL_NONE) {
+            // a site: line, file, func and fmt
+            char *copy = malloc(entry.size + 1);
+            if (!copy) {
+                ok = false;
+                break;
+            }
+            memcpy(copy, payload, entry.size);
+            copy[entry.size] = '\0';
+
+            FiniteLogSite site = {0};
+            int32_t line32 = 0;
+            memcpy(&line32, copy, entry.size >= sizeof(line32) ? sizeof(line32) : 0);
+            site.line = line32;
+            site.file = copy + sizeof(line32);
+            site.func = site.file + strlen(site.file) + 1;
+            if (site.func > copy + entry.size) {
+                site.func = copy + entry.size;
+            }
+            const char *fmt = site.func + strlen(site.func) + 1;
+            atomic_init(&site.fmt, fmt > copy + entry.size ? copy + entry.size : fmt);
+            site.id = entry.site;
+
+            if (entry.site == UINT32_MAX) {
+                free(overflow);
+                overflow = copy;
+                overflowSite = site;
+                continue;
+            }
+
+            if (entry.site >= _sites) {
+                uint32_t grown = entry.site + 64;
+                FiniteLogSite *moreSites = realloc(sites, grown * sizeof(FiniteLogSite));
+                char **moreStrings = moreSites ? realloc(strings, grown * sizeof(char *)) : NULL;
+                if (!moreSites || !moreStrings) {
+                    sites = moreSites ? moreSites : sites;
+                    ok = false;
+                    free(copy);
+                    break;
+                }
+                memset(moreSites + _sites, 0, (grown - _sites) * sizeof(FiniteLogSite));
+                memset(moreStrings + _sites, 0, (grown - _sites) * sizeof(char *));
+                sites = moreSites;
+                strings = moreStrings;
+                _sites = grown;
+            }
+            free(strings[entry.site]);
+            strings[entry.site] = copy;
+            sites[entry.site] = site;
+            continue;
+        }
+
+        FiniteLogSite *site = entry.site == UINT32_MAX ? &overflowSite : (entry.site < _sites ? &sites[entry.site] : NULL);
+        const char *fmt = site ? atomic_load_explicit(&site->fmt, memory_order_relaxed) : NULL;
+        if (!fmt || entry.level > LOG_LEVEL_FATAL) {
+            fprintf(stderr, "Unable to read entry for undefined site %u\n", entry.site);
+            continue;
+        }
+
+        uint64_t wall = header.realtime + (entry.timestamp - header.monotonic);
+        time_t seconds = wall / 1000000000ull;
+        struct tm tm_now;
+        char stamp[32];
+        localtime_r(&seconds, &tm_now);
+        strftime(stamp, sizeof(stamp), "%H:%M:%S", &tm_now);
+
+        if (color) {
+            fprintf(out, "%s[Finite]%s - %s[%s]%s (%s.%03u): ", ORANGE, RESET, colors[entry.level], names[entry.level], RESET, stamp, (unsigned) (wall / 1000000ull % 1000));
+        } else {
+            fprintf(out, "[Finite] - [%s] (%s.%03u): ", names[entry.level], stamp, (unsigned) (wall / 1000000ull % 1000));
+        }
+        finite_log_unpack(out, fmt, payload, entry.size);
+        if (color) {
+            fprintf(out, "%s (in function %s() at line %d)%s\n", DIM, site->func, site->line, RESET);
+        } else {
+            fprintf(out, " (in function %s() at line %d)\n", site->func, site->line);
+        }
+    }
+
+    for (uint32_t i = 0; i < _sites; i++) {
+        free(strings[i]);
+    }
+    free(strings);
+    free(sites);
+    free(overflow);
+    return ok;
+}
+
+static void finite_log_recorder_orphan(void *data) {
+    FiniteLogRecorder *recorder = data;
+    if (recorder) {
+        atomic_store_explicit(&recorder->orphaned, true, memory_order_release);
+    }
+}
+
+static void finite_log_make_recorder_key(void) {
+    pthread_key_create(&recorderKey, finite_log_recorder_orphan);
+}
+
+// the calling thread's recorder. like the async rings, an exited thread's recorder is handed to the next new thread.
+// recorders are never freed so a crash dump can always walk the list.
+static FiniteLogRecorder *finite_log_thread_recorder(void) {
+    if (t_recorder) {
+        return t_recorder;
+    }
+
+    pthread_once(&recorderKeyOnce, finite_log_make_recorder_key);
+
+    FiniteLogRecorder *recorder = atomic_load_explicit(&g_logger.recorders, memory_order_acquire);
+    for (; recorder; recorder = recorder->next) {
+        bool orphaned = true;
+        if (atomic_compare_exchange_strong_explicit(&recorder->orphaned, &orphaned, false, memory_order_acq_rel, memory_order_relaxed)) {
+            break;
+        }
+    }
+
+    if (!recorder) {
+        recorder = calloc(1, sizeof(FiniteLogRecorder));
+        if (!recorder) {
+            return NULL;
+        }
+
+        FiniteLogRecorder *first = atomic_load_explicit(&g_logger.recorders, memory_order_relaxed);
+        do {
+            recorder->next = first;
+        } while (!atomic_compare_exchange_weak_explicit(&g_logger.recorders, &first, recorder, memory_order_release, memory_order_relaxed));
+    }
+
+    t_recorder = recorder;
+    pthread_setspecific(recorderKey, recorder);
+    return recorder;
+}
+
+// no formatting and no io: the arguments are copied raw, the same way the binary sink stores them
+static void finite_log_record(FiniteLogLevel level, const char *file, int line, const char *func, const char *fmt, va_list args) {
+    FiniteLogRecorder *recorder = finite_log_thread_recorder();
+    if (!recorder) {
+        return;
+    }
+
+    size_t head = atomic_load_explicit(&recorder->head, memory_order_relaxed);
+    FiniteLogTrace *trace = &recorder->traces[head % FINITE_LOG_RECORDER_SLOTS];
+    trace->timestamp = finite_log_clock(CLOCK_MONOTONIC);
+    trace->file = file;
+    trace->func = func;
+    trace->fmt = fmt;
+    trace->line = line;
+    trace->level = level;
+    trace->size = (uint16_t) finite_log_pack_args(trace->args, sizeof(trace->args), fmt, args);
+    atomic_store_explicit(&recorder->head, head + 1, memory_order_release);
+}
+
+static bool finite_log_write_all(int fd, const void *data, size_t size) {
+    const unsigned char *p = data;
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+// writes every thread's recorder to fd as a binary log, oldest line first. it only uses async signal safe calls so
+// the crash handlers can run it. each line carries its own site definition since there's nowhere to keep an id table.
+static bool finite_log_recorder_write(int fd) {
+    FiniteLogHeader header = {
+        .magic = FINITE_LOG_MAGIC,
+        .version = FINITE_LOG_VERSION,
+        .realtime = finite_log_clock(CLOCK_REALTIME),
+        .monotonic = finite_log_clock(CLOCK_MONOTONIC)
+    };
+    if (!finite_log_write_all(fd, &header, sizeof(header))) {
+        return false;
+    }
+
+    // where each recorder's oldest unwritten line is. a thread that keeps logging while we dump can overwrite lines
+    // we haven't reached, so the window is fixed up front.
+    size_t cursor[FINITE_LOG_RECORDER_DUMP_THREADS];
+    size_t end[FINITE_LOG_RECORDER_DUMP_THREADS];
+    FiniteLogRecorder *recorders[FINITE_LOG_RECORDER_DUMP_THREADS];
+    size_t _recorders = 0;
+
+    for (FiniteLogRecorder *r = atomic_load_explicit(&g_logger.recorders, memory_order_acquire); r && _recorders < FINITE_LOG_RECORDER_DUMP_THREADS; r = r->next) {
+        size_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+        recorders[_recorders] = r;
+        end[_recorders] = head;
+        cursor[_recorders] = head > FINITE_LOG_RECORDER_SLOTS ? head - FINITE_LOG_RECORDER_SLOTS : 0;
+        _recorders++;
+    }
+
+    unsigned char buffer[FINITE_LOG_ENTRY_MAX];
+    while (true) {
+        // merge the threads by time. there are only ever a handful so a scan beats a heap here.
+        FiniteLogTrace *next = NULL;
+        size_t from = 0;
+        for (size_t i = 0; i < _recorders; i++) {
+            if (cursor[i] == end[i]) {
+                continue;
+            }
+            FiniteLogTrace *trace = &recorders[i]->traces[cursor[i] % FINITE_LOG_RECORDER_SLOTS];
+            if (!next || trace->timestamp < next->timestamp) {
+                next = trace;
+                from = i;
+            }
+        }
+        if (!next) {
+            break;
+        }
+        cursor[from]++;
+
+        size_t used = finite_log_site_entry(buffer, UINT32_MAX, next->timestamp, next->file, next->line, next->func, next->fmt);
+        FiniteLogEntry entry = {.timestamp = next->timestamp, .site = UINT32_MAX, .size = next->size, .level = next->level};
+        if (used + sizeof(entry) + next->size <= sizeof(buffer)) {
+            memcpy(buffer + used, &entry, sizeof(entry));
+            memcpy(buffer + used + sizeof(entry), next->args, next->size);
+            used += sizeof(entry) + next->size;
+        }
+        if (!finite_log_write_all(fd, buffer, used)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool finite_log_recorder_dump_to(const char *path) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = finite_log_recorder_write(fd);
+    close(fd);
+    return ok;
+}
+
+static void finite_log_crash(int sig) {
+    if (g_logger.recorderPath[0]) {
+        finite_log_recorder_dump_to(g_logger.recorderPath);
+    }
+
+    // hand the signal to whoever had it before (usually the default, which dumps core)
+    sigaction(sig, sig == SIGSEGV ? &g_logger.previousSegv : &g_logger.previousAbort, NULL);
+    raise(sig);
+}
+
+bool finite_log_set_recorder(const char *path) {
+    pthread_mutex_lock(&g_logger.lock);
+
+    if (!path) {
+        if (atomic_load_explicit(&g_logger.recording, memory_order_relaxed)) {
+            sigaction(SIGSEGV, &g_logger.previousSegv, NULL);
+            sigaction(SIGABRT, &g_logger.previousAbort, NULL);
+        }
+        atomic_store_explicit(&g_logger.recording, false, memory_order_release);
+        g_logger.recorderPath[0] = '\0';
+        pthread_mutex_unlock(&g_logger.lock);
+        return true;
+    }
+
+    if (strlen(path) >= sizeof(g_logger.recorderPath)) {
+        pthread_mutex_unlock(&g_logger.lock);
+        return false;
+    }
+
+    if (!atomic_load_explicit(&g_logger.recording, memory_order_relaxed)) {
+        struct sigaction action = {0};
+        action.sa_handler = finite_log_crash;
+        sigemptyset(&action.sa_mask);
+        action.sa_flags = SA_ONSTACK; // still works when the crash was a stack overflow, if the app set up an altstack
+        sigaction(SIGSEGV, &action, &g_logger.previousSegv);
+        sigaction(SIGABRT, &action, &g_logger.previousAbort);
+    }
+
+    strcpy(g_logger.recorderPath, path);
+    atomic_store_explicit(&g_logger.recording, true, memory_order_release);
+    pthread_mutex_unlock(&g_logger.lock);
+    return true;
+}
+
+bool finite_log_dump_recorder(const char *path) {
+    if (!path) {
+        path = g_logger.recorderPath;
+    }
+    if (!path[0]) {
+        return false;
+    }
+    return finite_log_recorder_dump_to(path);
+}
+
+// writes one line to whichever output is active. FATAL doesn't return.
+static void finite_log_output(FiniteLogLevel level, const char *file, int line, const char *func, const char *fmt, va_list args) {
+    FILE *binary = atomic_load_explicit(&g_logger.binary, memory_order_acquire);
+    if (binary) {
+        finite_log_binary(binary, level, file, line, func, fmt, args);
+        if (level == LOG_LEVEL_FATAL) {
+            fflush(binary);
+            exit(EXIT_FAILURE);
+        }
+        return;
+    }
+
+    if (atomic_load_explicit(&g_logger.async, memory_order_acquire)) {
+        if (level != LOG_LEVEL_FATAL) {
+            finite_log_push(level, line, func, fmt, args);
+            return;
+        }
+
+        // write everything that came before so the fatal line really is the last one
+        finite_log_flush();
+    }
+
+    pthread_mutex_lock(&g_logger.lock);
+
+    char timestampBuf[64] = ""; // empty string if no timestamp is requested
+    if (g_logger.withTimestamp == true) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        time_t now = ts.tv_sec;
+        struct tm tm_now;
+        localtime_r(&now, &tm_now);
+        strftime(timestampBuf, sizeof(timestampBuf), "%H:%M:%S", &tm_now);
+    }
+
+    // print prep info
+    fprintf(g_logger.output, "%s[Finite]%s - %s[%s]%s",ORANGE, RESET,colors[level], names[level], RESET);
+
+    if (g_logger.withTimestamp) {
+        fprintf(g_logger.output, " (%s): ",timestampBuf);
+    } else {
+        fprintf(g_logger.output, ": ");
+    }
+
+    vfprintf(g_logger.output, fmt, args);
+
+    fprintf(g_logger.output, "%s (in function %s() at line %d)%s\n", DIM, func, line, RESET);
+    fflush(g_logger.output);
+
+    pthread_mutex_unlock(&g_logger.lock);
+    if (level == LOG_LEVEL_FATAL) { // fatal
+        // close the file if its not stderr or stdout
+        if (g_logger.output != stdout && g_logger.output != stderr) {
+            fclose(g_logger.output);
+        }
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void finite_log_output_line(FiniteLogLevel level, const char *file, int line, const char *func, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    finite_log_output(level, file, line, func, fmt, args);
+    va_end(args);
+}
+
+static uint64_t finite_log_hash(const unsigned char *data, size_t size, uint64_t hash) {
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+// decides whether a line gets written. a line identical to the last one from its call site only bumps a counter,
+// and each call site spends a token from its level's bucket per line. whatever was held back is reported in front
+// of the next line that gets through. it never waits: a site another thread is updating lets the line through.
+static bool finite_log_limit(FiniteLogLevel level, const char *file, int line, const char *func, const char *fmt, va_list args) {
+    float rate = atomic_load_explicit(&g_limits[level].rate, memory_order_relaxed);
+    bool collapse = atomic_load_explicit(&g_limits[level].collapse, memory_order_relaxed);
+    if (rate <= 0.0f && !collapse) {
+        return true;
+    }
+
+    uint64_t key = ((uintptr_t) fmt ^ ((uintptr_t) file << 1) ^ ((uint64_t) line << 40)) * 0x9E3779B97F4A7C15ull;
+    key |= 1; // 0 marks a free slot
+    FiniteLogLimitSite *site = NULL;
+    for (size_t i = 0; i < FINITE_LOG_LIMIT_SITES; i++) {
+        FiniteLogLimitSite *slot = &g_limitSites[((key >> 32) + i) & (FINITE_LOG_LIMIT_SITES - 1)];
+        uint64_t current = atomic_load_explicit(&slot->key, memory_order_acquire);
+        if (current == 0) {
+            if (atomic_compare_exchange_strong_explicit(&slot->key, &current, key, memory_order_acq_rel, memory_order_acquire)) {
+                site = slot;
+                break;
+            }
+        }
+        if (current == key) {
+            site = slot;
+            break;
+        }
+    }
+
+    if (!site || atomic_flag_test_and_set_explicit(&site->busy, memory_order_acquire)) {
+        return true; // table's full or it's contended. better to log too much than to stall.
+    }
+
+    uint64_t now = finite_log_clock(CLOCK_MONOTONIC);
+    uint64_t hash = 0;
+    if (collapse) {
+        unsigned char packed[FINITE_LOG_ENTRY_MAX];
+        va_list copy;
+        va_copy(copy, args);
+        size_t size = finite_log_pack_args(packed, sizeof(packed), fmt, copy);
+        va_end(copy);
+        hash = finite_log_hash(packed, size, 0xCBF29CE484222325ull);
+
+        // the same line again. it's still written every so often so a stuck loop doesn't go quiet.
+        if (site->file && hash == site->lastHash && now - site->lastWritten < FINITE_LOG_REPEAT_MS * 1000000ull) {
+            site->repeats++;
+            atomic_flag_clear_explicit(&site->busy, memory_order_release);
+            return false;
+        }
+    }
+
+    if (rate > 0.0f) {
+        float burst = (float) atomic_load_explicit(&g_limits[level].burst, memory_order_relaxed);
+        if (!site->file) {
+            site->tokens = burst;
         } else {
-            fprintf(g_logger.output, ": ");
+            site->tokens += (float) ((now - site->refilled) / 1e9) * rate;
+            site->tokens = site->tokens > burst ? burst : site->tokens;
         }
+        site->refilled = now;
+
+        if (site->tokens < 1.0f) {
+            site->suppressed++;
+            site->file = file;
+            atomic_flag_clear_explicit(&site->busy, memory_order_release);
+            return false;
+        }
+        site->tokens -= 1.0f;
+    }
+
+    uint32_t repeats = site->repeats;
+    uint32_t suppressed = site->suppressed;
+    site->repeats = 0;
+    site->suppressed = 0;
+    site->lastHash = hash;
+    site->lastWritten = now;
+    site->level = level;
+    site->file = file;
+    site->func = func;
+    site->line = line;
+    atomic_flag_clear_explicit(&site->busy, memory_order_release);
+
+    if (repeats > 0) {
+        finite_log_output_line(level, file, line, func, "Last message repeated %u more time(s)", repeats);
+    }
+    if (suppressed > 0) {
+        finite_log_output_line(level, file, line, func, "Dropped %u message(s) from this line (rate limited)", suppressed);
+    }
+    return true;
+}
+
+bool finite_log_set_limit(FiniteLogLevel level, float perSecond, uint32_t burst, bool collapse) {
+    if (level <= LOG_LEVEL_NONE || level >= LOG_LEVEL_FATAL) {
+        return false; // fatal lines always get through
+    }
+
+    atomic_store_explicit(&g_limits[level].rate, perSecond > 0.0f ? perSecond : 0.0f, memory_order_relaxed);
+    atomic_store_explicit(&g_limits[level].burst, burst > 0 ? burst : 1, memory_order_relaxed);
+    atomic_store_explicit(&g_limits[level].collapse, collapse, memory_order_relaxed);
+
+    bool limiting = false;
+    for (int i = LOG_LEVEL_DEBUG; i < LOG_LEVEL_FATAL; i++) {
+        limiting |= atomic_load_explicit(&g_limits[i].rate, memory_order_relaxed) > 0.0f || atomic_load_explicit(&g_limits[i].collapse, memory_order_relaxed);
+    }
+    atomic_store_explicit(&g_logger.limiting, limiting, memory_order_release);
+    return true;
+}
 
+// reports repeats and drops that no later line from their site got to report
+static void finite_log_limit_flush(void) {
+    for (size_t i = 0; i < FINITE_LOG_LIMIT_SITES; i++) {
+        FiniteLogLimitSite *site = &g_limitSites[i];
+        if (atomic_load_explicit(&site->key, memory_order_acquire) == 0 || atomic_flag_test_and_set_explicit(&site->busy, memory_order_acquire)) {
+            continue;
+        }
+
+        uint32_t repeats = site->repeats;
+        uint32_t suppressed = site->suppressed;
+        site->repeats = 0;
+        site->suppressed = 0;
+        atomic_flag_clear_explicit(&site->busy, memory_order_release);
+
+        if (repeats > 0 && site->func) {
+            finite_log_output_line(site->level, site->file, site->line, site->func, "Last message repeated %u more time(s)", repeats);
+        }
+        if (suppressed > 0 && site->func) {
+            finite_log_output_line(site->level, site->file, site->line, site->func, "Dropped %u message(s) from this line (rate limited)", suppressed);
+        }
+    }
+}
+
+void (finite_log_internal)(FiniteLogLevel level, const char *file, int line, const char *func, const char *fmt, ...) {
+    // the recorder sees every line, even ones the output level filters out
+    bool recording = atomic_load_explicit(&g_logger.recording, memory_order_relaxed);
+    if (recording) {
         va_list args;
         va_start(args, fmt);
-        vfprintf(g_logger.output, fmt, args);
+        finite_log_record(level, file, line, func, fmt, args);
         va_end(args);
+        if (level == LOG_LEVEL_FATAL) {
+            finite_log_recorder_dump_to(g_logger.recorderPath);
+        }
+    }
 
-        fprintf(g_logger.output, "%s (in function %s() at line %d)%s\n", DIM, func, line, RESET);
-        fflush(g_logger.output);
+    if (g_logger.level > 0) {
+        if (level < g_logger.level) {
+            // if its below the required level ignore
+            return;
+        }
 
-        pthread_mutex_unlock(&g_logger.lock);
-        if (level == LOG_LEVEL_FATAL) { // fatal
-            // close the file if its not stderr or stdout
-            if (g_logger.output != stdout && g_logger.output != stderr) {
-                fclose(g_logger.output);
+        if (level != LOG_LEVEL_FATAL && atomic_load_explicit(&g_logger.limiting, memory_order_relaxed)) {
+            va_list args;
+            va_start(args, fmt);
+            bool write = finite_log_limit(level, file, line, func, fmt, args);
+            va_end(args);
+            if (!write) {
+                return;
             }
-            exit(EXIT_FAILURE);
         }
+
+        va_list args;
+        va_start(args, fmt);
+        finite_log_output(level, file, line, func, fmt, args);
+        va_end(args);
+    } else if (recording && level == LOG_LEVEL_FATAL) {
+        exit(EXIT_FAILURE);
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,659 @@
+#include "../include/pack.h"
+#include "../include/log.h"
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/mman.h>
+#ifdef FINITE_PACK_LZ4
+#include <lz4.h>
+#include <lz4hc.h>
+#endif
+#ifdef FINITE_PACK_ZSTD
+#include <zstd.h>
+#endif
+
+typedef struct FinitePackJob FinitePackJob;
+
+// one entry being decompressed. chunks are claimed off cursor by whoever gets there first.
+struct FinitePackJob {
+    FinitePack *pack;
+    const FinitePackEntry *entry;
+    unsigned char *out;
+    uint64_t chunks;
+    uint64_t cursor;
+    bool failed;
+    uint32_t users; // workers still touching it. guarded by poolLock.
+    FinitePackJob *next;
+};
+
+static FinitePack *mounts[FINITE_PACK_MOUNTS];
+static uint32_t _mounts = 0;
+static pthread_rwlock_t mountLock = PTHREAD_RWLOCK_INITIALIZER;
+
+static pthread_once_t poolOnce = PTHREAD_ONCE_INIT;
+static pthread_mutex_t poolLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t poolWake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t poolIdle = PTHREAD_COND_INITIALIZER;
+static FinitePackJob *jobs = NULL;
+
+static const char *finite_pack_strip(const char *name) {
+    while (name[0] == '.' && name[1] == '/') {
+        name += 2;
+    }
+    return name;
+}
+
+uint64_t finite_pack_hash(const char *name, size_t length) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char) name[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+FinitePack *finite_pack_open_debug(const char *file, const char *func, int line, const char *path) {
+    // lookups jump around the index, payloads are read however the caller hints them
+    FiniteFileMap map;
+    if (!finite_file_map_debug(file, func, line, path, FINITE_FILE_HINT_RANDOM, &map)) {
+        return NULL;
+    }
+
+    const FinitePackHeader *header = map.data;
+    if (map.size < sizeof(FinitePackHeader) || memcmp(header->magic, FINITE_PACK_MAGIC, 4) != 0) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to open %s (not a pack)", path);
+        goto fail;
+    }
+
+    if (header->version != FINITE_PACK_VERSION) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to open %s (version %u, expected %u)", path, header->version, FINITE_PACK_VERSION);
+        goto fail;
+    }
+
+    if (header->size != map.size || header->index > map.size || header->names > map.size ||
+        (map.size - header->index) / sizeof(FinitePackEntry) < header->_entries || header->index % 8 != 0) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to open %s (truncated or corrupt)", path);
+        goto fail;
+    }
+
+    // checked once here so lookups can trust the index. chunk offsets are checked as they're decompressed.
+    const FinitePackEntry *entries = (const FinitePackEntry *) ((const char *) map.data + header->index);
+    for (uint32_t i = 0; i < header->_entries; i++) {
+        const FinitePackEntry *entry = &entries[i];
+        bool compressed = entry->compression != FINITE_PACK_COMPRESSION_NONE;
+        uint64_t chunks = compressed && header->chunkSize ? (entry->size + header->chunkSize - 1) / header->chunkSize : 0;
+        if (entry->offset > map.size || entry->storedSize > map.size - entry->offset ||
+            entry->name > map.size - header->names || entry->nameLength > map.size - header->names - entry->name ||
+            (i > 0 && entries[i - 1].hash > entry->hash) || entry->compression > FINITE_PACK_COMPRESSION_ZSTD ||
+            (!compressed && entry->storedSize != entry->size) ||
+            (compressed && (header->chunkSize == 0 || entry->size == 0 || entry->offset % 8 != 0 || entry->storedSize / sizeof(uint64_t) < chunks))) {
+            finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to open %s (entry %u is corrupt)", path, i);
+            goto fail;
+        }
+    }
+
+    FinitePack *pack = calloc(1, sizeof(FinitePack));
+    if (!pack) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to open pack (no memory available)");
+        goto fail;
+    }
+
+    pack->map = map;
+    pack->header = header;
+    pack->entries = entries;
+    pack->names = (const char *) map.data + header->names;
+    finite_log_internal(LOG_LEVEL_DEBUG, file, line, func, "Opened pack %s with %u entries", path, header->_entries);
+    return pack;
+
+fail:
+    finite_file_unmap_debug(file, func, line, &map);
+    return NULL;
+}
+
+const FinitePackEntry *finite_pack_entry(FinitePack *pack, const char *name) {
+    if (!pack || !name) {
+        return NULL;
+    }
+
+    name = finite_pack_strip(name);
+    size_t length = strlen(name);
+    uint64_t hash = finite_pack_hash(name, length);
+
+    // lower bound on the hash, then check names across any collisions
+    uint32_t low = 0, high = pack->header->_entries;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        if (pack->entries[mid].hash < hash) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    for (uint32_t i = low; i < pack->header->_entries && pack->entries[i].hash == hash; i++) {
+        const FinitePackEntry *entry = &pack->entries[i];
+        if (entry->nameLength == length && memcmp(pack->names + entry->name, name, length) == 0) {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+bool finite_pack_find(FinitePack *pack, const char *name, FiniteFileMap *map) {
+    const FinitePackEntry *entry = finite_pack_entry(pack, name);
+    if (!entry || !map) {
+        return false;
+    }
+
+    if (entry->compression == FINITE_PACK_COMPRESSION_NONE) {
+        map->data = (const char *) pack->map.data + entry->offset;
+        map->size = entry->size;
+        map->borrowed = true;
+        return true;
+    }
+
+    // anonymous memory rather than the heap so finite_file_unmap frees it like any other mapping
+    void *memory = mmap(NULL, entry->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        finite_log_internal(LOG_LEVEL_ERROR, __FILE__, __LINE__, __func__, "Unable to decompress %s (%s)", name, strerror(errno));
+        return false;
+    }
+
+    if (!finite_pack_read_debug(__FILE__, __func__, __LINE__, pack, entry, memory, entry->size)) {
+        munmap(memory, entry->size);
+        return false;
+    }
+
+    mprotect(memory, entry->size, PROT_READ);
+    map->data = memory;
+    map->size = entry->size;
+    map->borrowed = false;
+    return true;
+}
+
+static bool finite_pack_decompress_chunk(FinitePack *pack, const FinitePackEntry *entry, uint64_t chunk, unsigned char *out) {
+    uint64_t chunkSize = pack->header->chunkSize;
+    uint64_t chunks = (entry->size + chunkSize - 1) / chunkSize;
+    const unsigned char *payload = (const unsigned char *) pack->map.data + entry->offset;
+    const uint64_t *ends = (const uint64_t *) payload;
+    const unsigned char *data = payload + chunks * sizeof(uint64_t);
+    uint64_t available = entry->storedSize - chunks * sizeof(uint64_t);
+
+    uint64_t start = chunk > 0 ? ends[chunk - 1] : 0;
+    uint64_t end = ends[chunk];
+    if (start > end || end > available) {
+        return false;
+    }
+
+    uint64_t at = chunk * chunkSize;
+    size_t length = entry->size - at < chunkSize ? entry->size - at : chunkSize;
+    size_t stored = end - start;
+    if (stored == length) {
+        memcpy(out + at, data + start, length);
+        return true;
+    }
+
+    switch (entry->compression) {
+#ifdef FINITE_PACK_LZ4
+        case FINITE_PACK_COMPRESSION_LZ4:
+            return LZ4_decompress_safe((const char *) data + start, (char *) out + at, (int) stored, (int) length) == (int) length;
+#endif
+#ifdef FINITE_PACK_ZSTD
+        case FINITE_PACK_COMPRESSION_ZSTD: {
+            size_t n = ZSTD_decompress(out + at, length, data + start, stored);
+            return !ZSTD_isError(n) && n == length;
+        }
+#endif
+        default:
+            return false;
+    }
+}
+
+static void finite_pack_work(FinitePackJob *job) {
+    uint64_t chunk;
+    while ((chunk = __atomic_fetch_add(&job->cursor, 1, __ATOMIC_RELAXED)) < job->chunks) {
+        if (!finite_pack_decompress_chunk(job->pack, job->entry, chunk, job->out)) {
+            __atomic_store_n(&job->failed, true, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+// under poolLock. once a job is off the list no worker can pick it up.
+static void finite_pack_unlist(FinitePackJob *job) {
+    for (FinitePackJob **at = &jobs; *at; at = &(*at)->next) {
+        if (*at == job) {
+            *at = job->next;
+            return;
+        }
+    }
+}
+
+static void *finite_pack_worker(void *data) {
+    while (true) {
+        pthread_mutex_lock(&poolLock);
+        while (!jobs) {
+            pthread_cond_wait(&poolWake, &poolLock);
+        }
+        FinitePackJob *job = jobs;
+        job->users++;
+        pthread_mutex_unlock(&poolLock);
+
+        finite_pack_work(job);
+
+        // everything's been claimed, so nobody else needs to find it
+        pthread_mutex_lock(&poolLock);
+        finite_pack_unlist(job);
+        if (--job->users == 0) {
+            pthread_cond_broadcast(&poolIdle);
+        }
+        pthread_mutex_unlock(&poolLock);
+    }
+
+    return NULL;
+}
+
+static void finite_pack_start_workers(void) {
+    // they live as long as the process and sleep when there's nothing to do.
+    // if none start the reading thread just does every chunk itself.
+    for (int i = 0; i < FINITE_PACK_WORKERS; i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, finite_pack_worker, NULL) == 0) {
+            pthread_detach(thread);
+        }
+    }
+}
+
+bool finite_pack_read_debug(const char *file, const char *func, int line, FinitePack *pack, const FinitePackEntry *entry, void *out, size_t size) {
+    if (!pack || !entry || (!out && entry->size > 0)) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to read NULL pack entry");
+        return false;
+    }
+
+    if (size < entry->size) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to read pack entry (%llu bytes into %zu)", (unsigned long long) entry->size, size);
+        return false;
+    }
+
+    if (entry->compression == FINITE_PACK_COMPRESSION_NONE) {
+        memcpy(out, (const char *) pack->map.data + entry->offset, entry->size);
+        return true;
+    }
+
+#ifndef FINITE_PACK_LZ4
+    if (entry->compression == FINITE_PACK_COMPRESSION_LZ4) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to read pack entry (libfinite was built without lz4)");
+        return false;
+    }
+#endif
+#ifndef FINITE_PACK_ZSTD
+    if (entry->compression == FINITE_PACK_COMPRESSION_ZSTD) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to read pack entry (libfinite was built without zstd)");
+        return false;
+    }
+#endif
+
+    FinitePackJob job = {
+        .pack = pack,
+        .entry = entry,
+        .out = out,
+        .chunks = (entry->size + pack->header->chunkSize - 1) / pack->header->chunkSize
+    };
+
+    // a single chunk isn't worth waking anyone for
+    if (job.chunks > 1) {
+        pthread_once(&poolOnce, finite_pack_start_workers);
+        pthread_mutex_lock(&poolLock);
+        job.next = jobs;
+        jobs = &job;
+        pthread_cond_broadcast(&poolWake);
+        pthread_mutex_unlock(&poolLock);
+    }
+
+    finite_pack_work(&job);
+
+    if (job.chunks > 1) {
+        pthread_mutex_lock(&poolLock);
+        finite_pack_unlist(&job);
+        while (job.users > 0) {
+            pthread_cond_wait(&poolIdle, &poolLock);
+        }
+        pthread_mutex_unlock(&poolLock);
+    }
+
+    if (job.failed) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to decompress pack entry (corrupt data)");
+        return false;
+    }
+
+    return true;
+}
+
+bool finite_pack_mount_debug(const char *file, const char *func, int line, FinitePack *pack) {
+    if (!pack) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to mount NULL pack");
+        return false;
+    }
+
+    pthread_rwlock_wrlock(&mountLock);
+    for (uint32_t i = 0; i < _mounts; i++) {
+        if (mounts[i] == pack) {
+            pthread_rwlock_unlock(&mountLock);
+            return true;
+        }
+    }
+
+    if (_mounts == FINITE_PACK_MOUNTS) {
+        pthread_rwlock_unlock(&mountLock);
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to mount pack (%d are already mounted)", FINITE_PACK_MOUNTS);
+        return false;
+    }
+
+    mounts[_mounts++] = pack;
+    pthread_rwlock_unlock(&mountLock);
+    return true;
+}
+
+void finite_pack_unmount(FinitePack *pack) {
+    pthread_rwlock_wrlock(&mountLock);
+    for (uint32_t i = 0; i < _mounts; i++) {
+        if (mounts[i] == pack) {
+            memmove(&mounts[i], &mounts[i + 1], (_mounts - i - 1) * sizeof(FinitePack *));
+            _mounts--;
+            break;
+        }
+    }
+    pthread_rwlock_unlock(&mountLock);
+}
+
+bool finite_pack_resolve(const char *name, FiniteFileMap *map) {
+    // nothing mounted is the common case for loose files, so skip the lock
+    if (__atomic_load_n(&_mounts, __ATOMIC_RELAXED) == 0 || !name) {
+        return false;
+    }
+
+    bool found = false;
+    pthread_rwlock_rdlock(&mountLock);
+    for (uint32_t i = _mounts; i > 0 && !found; i--) {
+        found = finite_pack_find(mounts[i - 1], name, map);
+    }
+    pthread_rwlock_unlock(&mountLock);
+    return found;
+}
+
+void finite_pack_close_debug(const char *file, const char *func, int line, FinitePack *pack) {
+    if (!pack) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to close NULL pack");
+        return;
+    }
+
+    finite_pack_unmount(pack);
+    finite_file_unmap_debug(file, func, line, &pack->map);
+    free(pack);
+}
+
+typedef struct {
+    const char *name;
+    FinitePackEntry entry;
+} FinitePackInput;
+
+static int finite_pack_compare(const void *a, const void *b) {
+    const FinitePackInput *x = a, *y = b;
+    if (x->entry.hash != y->entry.hash) {
+        return x->entry.hash < y->entry.hash ? -1 : 1;
+    }
+    return strcmp(x->name, y->name);
+}
+
+static bool finite_pack_pad(FILE *out, uint64_t *offset, uint32_t align) {
+    static const char zeros[4096];
+    uint64_t pad = (align - (*offset % align)) % align;
+    if (pad && fwrite(zeros, 1, pad, out) != pad) {
+        return false;
+    }
+    *offset += pad;
+    return true;
+}
+
+static bool finite_pack_grow(unsigned char **buffer, size_t *cap, size_t size) {
+    if (size <= *cap) {
+        return true;
+    }
+
+    size_t grownCap = *cap * 2 > size ? *cap * 2 : size;
+    unsigned char *grown = realloc(*buffer, grownCap);
+    if (!grown) {
+        return false;
+    }
+    *buffer = grown;
+    *cap = grownCap;
+    return true;
+}
+
+// compresses size bytes of in into the chunked layout. returns the stored size, or 0 when it isn't worth it.
+static size_t finite_pack_compress(FinitePackCompression compression, const unsigned char *in, size_t size, unsigned char **out, size_t *outCap) {
+    if (compression == FINITE_PACK_COMPRESSION_NONE || size == 0) {
+        return 0;
+    }
+
+    size_t chunks = (size + FINITE_PACK_CHUNK - 1) / FINITE_PACK_CHUNK;
+    size_t bound = 0;
+#ifdef FINITE_PACK_LZ4
+    if (compression == FINITE_PACK_COMPRESSION_LZ4) {
+        bound = LZ4_compressBound(FINITE_PACK_CHUNK);
+    }
+#endif
+#ifdef FINITE_PACK_ZSTD
+    if (compression == FINITE_PACK_COMPRESSION_ZSTD) {
+        bound = ZSTD_compressBound(FINITE_PACK_CHUNK);
+    }
+#endif
+    if (bound == 0 || !finite_pack_grow(out, outCap, chunks * (sizeof(uint64_t) + bound))) {
+        return 0;
+    }
+
+    uint64_t *ends = (uint64_t *) *out;
+    unsigned char *data = *out + chunks * sizeof(uint64_t);
+    size_t used = 0;
+    for (size_t chunk = 0; chunk < chunks; chunk++) {
+        size_t at = chunk * FINITE_PACK_CHUNK;
+        size_t length = size - at < FINITE_PACK_CHUNK ? size - at : FINITE_PACK_CHUNK;
+        size_t n = 0;
+
+        // packs are built ahead of time, so both get their slowest, smallest setting
+#ifdef FINITE_PACK_LZ4
+        if (compression == FINITE_PACK_COMPRESSION_LZ4) {
+            int written = LZ4_compress_HC((const char *) in + at, (char *) data + used, (int) length, (int) bound, LZ4HC_CLEVEL_MAX);
+            n = written > 0 ? (size_t) written : 0;
+        }
+#endif
+#ifdef FINITE_PACK_ZSTD
+        if (compression == FINITE_PACK_COMPRESSION_ZSTD) {
+            size_t written = ZSTD_compress(data + used, bound, in + at, length, 19);
+            n = ZSTD_isError(written) ? 0 : written;
+        }
+#endif
+
+        // a chunk that didn't shrink is kept as is, which is how the reader tells them apart
+        if (n == 0 || n >= length) {
+            memcpy(data + used, in + at, length);
+            n = length;
+        }
+
+        used += n;
+        ends[chunk] = used;
+    }
+
+    size_t stored = chunks * sizeof(uint64_t) + used;
+    return stored < size - size / 16 ? stored : 0;
+}
+
+bool finite_pack_build_debug(const char *file, const char *func, int line, const char *path, const char *root, const char **names, uint32_t count, uint32_t align, FinitePackCompression compression) {
+    if (!path || (!names && count > 0)) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to build pack with NULL path or names");
+        return false;
+    }
+
+    if (align == 0) {
+        align = FINITE_PACK_ALIGN;
+    }
+
+    // the index needs 8 and a pack can hold another pack, so nothing smaller than that
+    if ((align & (align - 1)) != 0 || align > 4096) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to build pack (alignment %u isn't a power of two up to 4096)", align);
+        return false;
+    }
+    if (align < 8) {
+        align = 8;
+    }
+
+#ifndef FINITE_PACK_LZ4
+    if (compression == FINITE_PACK_COMPRESSION_LZ4) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to build pack (libfinite was built without lz4)");
+        return false;
+    }
+#endif
+#ifndef FINITE_PACK_ZSTD
+    if (compression == FINITE_PACK_COMPRESSION_ZSTD) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to build pack (libfinite was built without zstd)");
+        return false;
+    }
+#endif
+
+    unsigned char *buffer = NULL;
+    size_t bufferCap = 0;
+    unsigned char *packed = NULL;
+    size_t packedCap = 0;
+    FinitePackInput *inputs = calloc(count ? count : 1, sizeof(FinitePackInput));
+    FILE *out = fopen(path, "wb");
+    bool created = out != NULL;
+    if (!inputs || !out) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to build pack %s (%s)", path, strerror(errno));
+        goto fail;
+    }
+
+    FinitePackHeader header = {
+        .magic = FINITE_PACK_MAGIC,
+        .version = FINITE_PACK_VERSION,
+        ._entries = count,
+        .align = align,
+        .chunkSize = FINITE_PACK_CHUNK
+    };
+
+    uint64_t offset = sizeof(FinitePackHeader);
+    if (fwrite(&header, sizeof(header), 1, out) != 1) {
+        goto write_fail;
+    }
+
+    uint64_t nameBytes = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        const char *name = finite_pack_strip(names[i]);
+        size_t length = strlen(name);
+        inputs[i].name = name;
+        inputs[i].entry.hash = finite_pack_hash(name, length);
+        inputs[i].entry.name = nameBytes;
+        inputs[i].entry.nameLength = length;
+        nameBytes += length;
+        if (nameBytes > UINT32_MAX) {
+            finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to build pack %s (names are too long)", path);
+            goto fail;
+        }
+
+        char source[4096];
+        if (root) {
+            snprintf(source, sizeof(source), "%s/%s", root, name);
+        } else {
+            snprintf(source, sizeof(source), "%s", name);
+        }
+
+        FILE *in = fopen(source, "rb");
+        if (!in) {
+            finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to open %s (%s)", source, strerror(errno));
+            goto fail;
+        }
+
+        // the whole file is needed up front to cut it into chunks
+        size_t size = 0, n;
+        while (finite_pack_grow(&buffer, &bufferCap, size + (1 << 16)) && (n = fread(buffer + size, 1, 1 << 16, in)) > 0) {
+            size += n;
+        }
+
+        bool failed = ferror(in) || !feof(in);
+        fclose(in);
+        if (failed) {
+            finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to read %s", source);
+            goto fail;
+        }
+
+        size_t stored = finite_pack_compress(compression, buffer, size, &packed, &packedCap);
+        inputs[i].entry.size = size;
+        inputs[i].entry.storedSize = stored ? stored : size;
+        inputs[i].entry.compression = stored ? compression : FINITE_PACK_COMPRESSION_NONE;
+
+        if (!finite_pack_pad(out, &offset, align)) {
+            goto write_fail;
+        }
+
+        inputs[i].entry.offset = offset;
+        if (inputs[i].entry.storedSize > 0 && fwrite(stored ? packed : buffer, 1, inputs[i].entry.storedSize, out) != inputs[i].entry.storedSize) {
+            goto write_fail;
+        }
+        offset += inputs[i].entry.storedSize;
+    }
+
+    qsort(inputs, count, sizeof(FinitePackInput), finite_pack_compare);
+    for (uint32_t i = 1; i < count; i++) {
+        if (inputs[i - 1].entry.hash == inputs[i].entry.hash && strcmp(inputs[i - 1].name, inputs[i].name) == 0) {
+            finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to build pack %s (%s is in it twice)", path, inputs[i].name);
+            goto fail;
+        }
+    }
+
+    if (!finite_pack_pad(out, &offset, 8)) {
+        goto write_fail;
+    }
+
+    header.index = offset;
+    for (uint32_t i = 0; i < count; i++) {
+        if (fwrite(&inputs[i].entry, sizeof(FinitePackEntry), 1, out) != 1) {
+            goto write_fail;
+        }
+    }
+    offset += (uint64_t) count * sizeof(FinitePackEntry);
+
+    // names go in their original order, which is the order entry.name was handed out in
+    header.names = offset;
+    for (uint32_t i = 0; i < count; i++) {
+        const char *name = finite_pack_strip(names[i]);
+        if (fwrite(name, 1, strlen(name), out) != strlen(name)) {
+            goto write_fail;
+        }
+    }
+    offset += nameBytes;
+
+    header.size = offset;
+    if (fseek(out, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, out) != 1 || fclose(out) != 0) {
+        out = NULL;
+        goto write_fail;
+    }
+
+    finite_log_internal(LOG_LEVEL_DEBUG, file, line, func, "Built pack %s with %u entries (%llu bytes)", path, count, (unsigned long long) offset);
+    free(inputs);
+    free(buffer);
+    free(packed);
+    return true;
+
+write_fail:
+    finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to write pack %s (%s)", path, strerror(errno));
+fail:
+    if (out) {
+        fclose(out);
+    }
+    if (created) {
+        remove(path);
+    }
+    free(inputs);
+    free(buffer);
+    free(packed);
+    return false;
+}
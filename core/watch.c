@@ -0,0 +1,194 @@
+#include "../include/watch.h"
+#include "../include/log.h"
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <time.h>
+#include <unistd.h>
+
+#define FINITE_WATCH_MASK (IN_CLOSE_WRITE | IN_MOVED_TO)
+
+static uint64_t finite_watch_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+FiniteWatch *finite_watch_create_debug(const char *file, const char *func, int line) {
+    FiniteWatch *watch = calloc(1, sizeof(FiniteWatch));
+    if (!watch) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to create watch (no memory available)");
+        return NULL;
+    }
+
+    watch->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watch->fd < 0) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to create watch (%s)", strerror(errno));
+        free(watch);
+        return NULL;
+    }
+
+    return watch;
+}
+
+bool finite_watch_add_debug(const char *file, const char *func, int line, FiniteWatch *watch, const char *path, FiniteWatchCallback callback, void *data) {
+    if (!watch || !path || !callback) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to watch with NULL watch, path or callback");
+        return false;
+    }
+
+    char *copy = strdup(path);
+    FiniteWatchEntry *entries = realloc(watch->entries, (watch->_entries + 1) * sizeof(FiniteWatchEntry));
+    if (!copy || !entries) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to watch %s (no memory available)", path);
+        free(copy);
+        return false;
+    }
+    watch->entries = entries;
+
+    char dir[PATH_MAX];
+    const char *slash = strrchr(copy, '/');
+    if (!slash) {
+        strcpy(dir, ".");
+    } else if (slash == copy) {
+        strcpy(dir, "/");
+    } else {
+        snprintf(dir, sizeof(dir), "%.*s", (int) (slash - copy), copy);
+    }
+
+    // a directory that's already watched hands back the same wd, so files next to each other share one
+    int wd = inotify_add_watch(watch->fd, dir, FINITE_WATCH_MASK | IN_ONLYDIR);
+    if (wd < 0) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to watch %s (%s)", dir, strerror(errno));
+        free(copy);
+        return false;
+    }
+
+    watch->entries[watch->_entries++] = (FiniteWatchEntry) {
+        .path = copy,
+        .name = slash ? slash + 1 : copy,
+        .wd = wd,
+        .callback = callback,
+        .data = data
+    };
+
+    finite_log_internal(LOG_LEVEL_DEBUG, file, line, func, "Watching %s", path);
+    return true;
+}
+
+void finite_watch_remove(FiniteWatch *watch, const char *path) {
+    for (uint32_t i = 0; i < watch->_entries;) {
+        FiniteWatchEntry *entry = &watch->entries[i];
+        if (strcmp(entry->path, path) != 0) {
+            i++;
+            continue;
+        }
+
+        int wd = entry->wd;
+        free(entry->path);
+        watch->entries[i] = watch->entries[--watch->_entries];
+
+        bool shared = false;
+        for (uint32_t j = 0; j < watch->_entries && !shared; j++) {
+            shared = watch->entries[j].wd == wd;
+        }
+        if (!shared) {
+            inotify_rm_watch(watch->fd, wd);
+        }
+    }
+}
+
+int finite_watch_get_fd(FiniteWatch *watch) {
+    return watch->fd;
+}
+
+int finite_watch_get_timeout(FiniteWatch *watch) {
+    uint64_t now = finite_watch_now();
+    int timeout = -1;
+    for (uint32_t i = 0; i < watch->_entries; i++) {
+        FiniteWatchEntry *entry = &watch->entries[i];
+        if (!entry->dirty) {
+            continue;
+        }
+
+        int left = entry->due > now ? (int) (entry->due - now) : 0;
+        if (timeout < 0 || left < timeout) {
+            timeout = left;
+        }
+    }
+    return timeout;
+}
+
+uint32_t finite_watch_dispatch(FiniteWatch *watch) {
+    char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    uint64_t now = finite_watch_now();
+    ssize_t n;
+
+    while ((n = read(watch->fd, events, sizeof(events))) > 0) {
+        for (char *at = events; at < events + n;) {
+            struct inotify_event *event = (struct inotify_event *) at;
+            at += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                // changes were lost, so reload everything rather than miss one
+                for (uint32_t i = 0; i < watch->_entries; i++) {
+                    watch->entries[i].dirty = true;
+                    watch->entries[i].due = now + FINITE_WATCH_SETTLE_MS;
+                }
+                continue;
+            }
+
+            if (event->len == 0) {
+                continue;
+            }
+
+            // every write pushes the deadline back, so a burst of them is one reload
+            for (uint32_t i = 0; i < watch->_entries; i++) {
+                FiniteWatchEntry *entry = &watch->entries[i];
+                if (entry->wd == event->wd && strcmp(entry->name, event->name) == 0) {
+                    entry->dirty = true;
+                    entry->due = now + FINITE_WATCH_SETTLE_MS;
+                }
+            }
+        }
+    }
+
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < watch->_entries; i++) {
+        FiniteWatchEntry *entry = &watch->entries[i];
+        if (!entry->dirty || entry->due > now) {
+            continue;
+        }
+
+        // a callback may add or remove watches, which can move the array, so copy what it needs first
+        entry->dirty = false;
+        FiniteWatchCallback callback = entry->callback;
+        void *data = entry->data;
+        char *path = strdup(entry->path);
+        if (path) {
+            callback(path, data);
+            free(path);
+            count++;
+        }
+    }
+
+    return count;
+}
+
+void finite_watch_destroy_debug(const char *file, const char *func, int line, FiniteWatch *watch) {
+    if (!watch) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to destroy NULL watch");
+        return;
+    }
+
+    for (uint32_t i = 0; i < watch->_entries; i++) {
+        free(watch->entries[i].path);
+    }
+
+    // closing the inotify fd drops every watch on it
+    close(watch->fd);
+    free(watch->entries);
+    free(watch);
+}
@@ -1,5 +1,7 @@
 #include "../include/draw/cairo.h"
 #include "../include/log.h"
+#include "../include/core.h"
+#include "../include/pack.h"
 #include "cairo.h"
 #include <string.h>
 #include <unistd.h>
@@ -552,6 +554,36 @@ void finite_draw_load_snapshot_debug(const char *file, const char *func, int lin
     cairo_surface_mark_dirty(shell->cairo_surface);
 }
 
+typedef struct {
+    const unsigned char *data;
+    size_t size;
+    size_t offset;
+} FinitePngReader;
+
+static cairo_status_t finite_draw_png_read(void *closure, unsigned char *data, unsigned int length) {
+    FinitePngReader *reader = closure;
+    if (length > reader->size - reader->offset) {
+        return CAIRO_STATUS_READ_ERROR;
+    }
+
+    memcpy(data, reader->data + reader->offset, length);
+    reader->offset += length;
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_surface_t *finite_draw_load_png(const char *path) {
+    // pngs in a mounted pack are decoded straight out of its mapping
+    FiniteFileMap packed;
+    if (finite_pack_resolve(path, &packed)) {
+        FinitePngReader reader = {packed.data, packed.size, 0};
+        cairo_surface_t *image = cairo_image_surface_create_from_png_stream(finite_draw_png_read, &reader);
+        finite_file_unmap(&packed);
+        return image;
+    }
+
+    return cairo_image_surface_create_from_png(path);
+}
+
 void finite_draw_png_debug(const char *file, const char *func, int line, FiniteShell *shell, const char *path, double x, double y, double width, double height, cairo_surface_t **cache,  FiniteColorGroup *fillOnFail) {
     if (!shell) {
         finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to draw png on NULL shell");
@@ -564,7 +596,7 @@ void finite_draw_png_debug(const char *file, const char *func, int line, FiniteS
 
     cairo_t *cr = shell->cr;
 
-    cairo_surface_t *image = cairo_image_surface_create_from_png(path);
+    cairo_surface_t *image = finite_draw_load_png(path);
 
     int w = cairo_image_surface_get_width(image), h = cairo_image_surface_get_height(image);
     cairo_rectangle(cr, x, y, width, height);
@@ -601,6 +633,27 @@ void finite_draw_png_debug(const char *file, const char *func, int line, FiniteS
     }
 }
 
+bool finite_draw_reload_png_debug(const char *file, const char *func, int line, const char *path, cairo_surface_t **cache) {
+    if (!path || !cache) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to reload png with NULL path or cache");
+        return false;
+    }
+
+    cairo_surface_t *image = finite_draw_load_png(path);
+    if (cairo_surface_status(image) != CAIRO_STATUS_SUCCESS) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to reload %s (%s)", path, cairo_status_to_string(cairo_surface_status(image)));
+        cairo_surface_destroy(image);
+        return false;
+    }
+
+    if (*cache) {
+        cairo_surface_destroy(*cache);
+    }
+
+    *cache = image;
+    return true;
+}
+
 void finite_draw_cached_png_debug(const char *file, const char *func, int line, FiniteShell *shell, cairo_surface_t *cache, double x, double y, double width, double height,  FiniteColorGroup *fillOnFail) {
     if (!shell) {
         finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to draw cached png on NULL shell");
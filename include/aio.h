@@ -0,0 +1,109 @@
+#ifndef __AIO_H__
+#define __AIO_H__
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+// requests that can be in flight at once. more can be queued, they're submitted as earlier ones finish.
+#define FINITE_AIO_DEPTH 64
+// workers used when io_uring isn't available
+#define FINITE_AIO_WORKERS 4
+
+typedef struct FiniteAioRequest FiniteAioRequest;
+typedef struct FiniteAio FiniteAio;
+typedef enum FiniteAioBackend FiniteAioBackend;
+
+typedef void (*FiniteAioCallback)(FiniteAioRequest *request, void *data);
+
+enum FiniteAioBackend {
+    FINITE_AIO_BACKEND_AUTO, // io_uring if the kernel allows it, otherwise threads
+    FINITE_AIO_BACKEND_URING,
+    FINITE_AIO_BACKEND_THREADS
+};
+
+// one read. it's owned by the caller and must stay alive until its callback has run.
+struct FiniteAioRequest {
+    const char *path; // opened (and closed again) for the read. NULL to read fd instead.
+    int fd;
+    void *buffer; // NULL allocates one big enough. the caller frees it.
+    size_t size; // 0 reads to the end of the file
+    off_t offset;
+    FiniteAioCallback callback; // runs on the thread that calls finite_aio_dispatch
+    void *data;
+    ssize_t result; // bytes read once it's done, or a negative errno
+
+    // private
+    bool ownsFd;
+    size_t done;
+    struct iovec iov;
+    FiniteAioRequest *next;
+};
+
+// batches reads, runs them through io_uring (or a thread pool) and hands completions back to one thread.
+// everything but the workers is driven by the thread that created it.
+struct FiniteAio {
+    FiniteAioBackend backend;
+    int eventFd; // readable when completions are waiting
+    uint32_t inflight;
+    FiniteAioRequest *queued; // waiting for a free slot
+    FiniteAioRequest *queuedTail;
+
+    // io_uring. the ring pointers point into memory shared with the kernel.
+    int ringFd;
+    uint32_t sqEntries;
+    void *sqRing;
+    size_t sqRingSize;
+    void *cqRing;
+    size_t cqRingSize;
+    void *sqes;
+    size_t sqesSize;
+    uint32_t *sqHead;
+    uint32_t *sqTail;
+    uint32_t *sqMask;
+    uint32_t *sqArray;
+    uint32_t *cqHead;
+    uint32_t *cqTail;
+    uint32_t *cqMask;
+    void *cqes;
+
+    // threads
+    pthread_t *workers;
+    uint32_t _workers;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    FiniteAioRequest *pending; // waiting for a worker
+    FiniteAioRequest *completed; // finished, waiting for dispatch
+    bool stopping;
+};
+
+#define finite_aio_create(backend) finite_aio_create_debug(__FILE__, __func__, __LINE__, backend)
+FiniteAio *finite_aio_create_debug(const char *file, const char *func, int line, FiniteAioBackend backend);
+
+// queues a read. nothing is sent to the kernel until finite_aio_submit, so a batch costs one syscall.
+#define finite_aio_read(aio, request) finite_aio_read_debug(__FILE__, __func__, __LINE__, aio, request)
+bool finite_aio_read_debug(const char *file, const char *func, int line, FiniteAio *aio, FiniteAioRequest *request);
+
+#define finite_aio_submit(aio) finite_aio_submit_debug(__FILE__, __func__, __LINE__, aio)
+bool finite_aio_submit_debug(const char *file, const char *func, int line, FiniteAio *aio);
+
+// for an event loop. it's readable whenever finite_aio_dispatch has callbacks to run.
+int finite_aio_get_fd(FiniteAio *aio);
+
+// runs the callbacks of finished reads and submits anything that was waiting for room. never blocks.
+// returns how many callbacks ran.
+uint32_t finite_aio_dispatch(FiniteAio *aio);
+
+// blocks until every read queued so far has finished and its callback has run
+#define finite_aio_wait(aio) finite_aio_wait_debug(__FILE__, __func__, __LINE__, aio)
+bool finite_aio_wait_debug(const char *file, const char *func, int line, FiniteAio *aio);
+
+const char *finite_aio_backend(FiniteAio *aio);
+
+// waits for reads in flight, then frees the context. their callbacks don't run.
+#define finite_aio_destroy(aio) finite_aio_destroy_debug(__FILE__, __func__, __LINE__, aio)
+void finite_aio_destroy_debug(const char *file, const char *func, int line, FiniteAio *aio);
+
+#endif
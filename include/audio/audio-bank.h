@@ -0,0 +1,50 @@
+// audio.h pulls this header in after the playback device is declared
+#include "audio.h"
+#ifndef __AUDIO_BANK_H__
+#define __AUDIO_BANK_H__
+
+#define FINITE_AUDIO_CLIP_NONE 0
+
+// clips are referred to by handle. handles stay valid until the bank is destroyed.
+typedef uint32_t FiniteAudioClipHandle;
+
+typedef struct FiniteAudioClip FiniteAudioClip;
+typedef struct FiniteAudioBank FiniteAudioBank;
+
+// a fully decoded clip. pcm is 64 byte aligned interleaved S16.
+struct FiniteAudioClip {
+    char *name;
+    short *pcm;
+    size_t frames;
+    uint32_t channels;
+    uint32_t sampleRate;
+};
+
+struct FiniteAudioBank {
+    FiniteAudioClip *clips;
+    uint32_t _clips;
+    uint32_t _capacity;
+    uint32_t sampleRate; // clips are converted to this rate when they're loaded. 0 keeps the file's rate.
+};
+
+#define finite_audio_bank_create(sampleRate) finite_audio_bank_create_debug(__FILE__, __func__, __LINE__, sampleRate)
+FiniteAudioBank *finite_audio_bank_create_debug(const char *file, const char *func, int line, uint32_t sampleRate);
+
+// decodes the whole file up front. loading the same path twice returns the first handle.
+#define finite_audio_bank_load(bank, path) finite_audio_bank_load_debug(__FILE__, __func__, __LINE__, bank, path)
+FiniteAudioClipHandle finite_audio_bank_load_debug(const char *file, const char *func, int line, FiniteAudioBank *bank, const char *path);
+
+#define finite_audio_bank_find(bank, path) finite_audio_bank_find_debug(__FILE__, __func__, __LINE__, bank, path)
+FiniteAudioClipHandle finite_audio_bank_find_debug(const char *file, const char *func, int line, FiniteAudioBank *bank, const char *path);
+
+FiniteAudioClip *finite_audio_bank_get(FiniteAudioBank *bank, FiniteAudioClipHandle clip);
+
+// starts a cached clip on a mixer. this only queues a command, there's no I/O or decoding here.
+#define finite_audio_bank_play(bank, mixer, clip, gain, pan, loop) finite_audio_bank_play_debug(__FILE__, __func__, __LINE__, bank, mixer, clip, gain, pan, loop)
+FiniteAudioVoice finite_audio_bank_play_debug(const char *file, const char *func, int line, FiniteAudioBank *bank, FiniteAudioMixer *mixer, FiniteAudioClipHandle clip, float gain, float pan, bool loop);
+
+// every voice playing from the bank must be stopped before this is called
+#define finite_audio_bank_destroy(bank) finite_audio_bank_destroy_debug(__FILE__, __func__, __LINE__, bank)
+void finite_audio_bank_destroy_debug(const char *file, const char *func, int line, FiniteAudioBank *bank);
+
+#endif
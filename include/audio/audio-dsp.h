@@ -0,0 +1,38 @@
+#ifndef __AUDIO_DSP_H__
+#define __AUDIO_DSP_H__
+#include <stddef.h>
+#include <stdint.h>
+
+// vectorised sample kernels used by the mixer. the best kernel set (AVX2, SSE2, NEON or scalar) is picked once at runtime.
+// float buffers are normalised to [-1, 1] and interleaved.
+
+// adds frames of src (mono or stereo S16) into a stereo float accumulator with separate left/right gains
+void finite_audio_dsp_mix_s16(float *acc, const short *src, size_t frames, uint32_t channels, float gainL, float gainR);
+
+// converts samples, clamping to the S16 range instead of wrapping
+void finite_audio_dsp_f32_to_s16(short *dst, const float *src, size_t samples);
+void finite_audio_dsp_s16_to_f32(float *dst, const short *src, size_t samples);
+
+// used by the resampler's polyphase filters
+float finite_audio_dsp_dot_f32(const float *a, const float *b, size_t n);
+
+// the rest are used by the effects. buffers are stereo unless they're counted in samples.
+
+// dst += src
+void finite_audio_dsp_add_f32(float *dst, const float *src, size_t samples);
+// multiplies frame i by gain + step * i. a step of 0 is a plain gain.
+void finite_audio_dsp_ramp_f32(float *buffer, size_t frames, float gain, float step);
+// one pass over a delay line: out += line * wet, then line = in + line * feedback. out and in may be the same buffer.
+void finite_audio_dsp_delay_f32(float *out, const float *in, float *line, size_t samples, float feedback, float wet);
+// coeffs are b0 b1 b2 a1 a2 (normalised by a0). state holds 4 floats and must start zeroed.
+void finite_audio_dsp_biquad_f32(float *buffer, size_t frames, const float *coeffs, float *state);
+// largest absolute sample
+float finite_audio_dsp_peak_f32(const float *src, size_t samples);
+
+// per emitter gains for count emitters stored as separate arrays. listener is its position then its unit right vector.
+// distance is clamped to [min, max] and attenuated by min / (min + rolloff * (distance - min)), then panned with equal power.
+void finite_audio_dsp_spatialize_f32(const float *x, const float *y, const float *z, const float *minDistance, const float *maxDistance, const float *rolloff, size_t count, const float *listener, float *gainL, float *gainR);
+
+const char *finite_audio_dsp_backend(void);
+
+#endif
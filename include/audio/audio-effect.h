@@ -0,0 +1,136 @@
+#ifndef __AUDIO_EFFECT_H__
+#define __AUDIO_EFFECT_H__
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+// effects run on stereo interleaved float buffers in the [-1, 1] range.
+// everything an effect needs is allocated when it's created so processing never allocates.
+
+// most effects a chain can hold
+#define FINITE_AUDIO_EFFECT_CHAIN_MAX 16
+// frames an effect works on at a time. longer buffers are split up.
+#define FINITE_AUDIO_EFFECT_BLOCK 1024
+// parallel comb filters in the reverb
+#define FINITE_AUDIO_EFFECT_REVERB_LINES 4
+
+typedef struct FiniteAudioEffect FiniteAudioEffect;
+typedef struct FiniteAudioEffectChain FiniteAudioEffectChain;
+typedef enum FiniteAudioEffectType FiniteAudioEffectType;
+
+// processes frames of buffer in place on the audio thread. it must not block or allocate.
+typedef void (*FiniteAudioEffectProcess)(FiniteAudioEffect *effect, float *buffer, size_t frames, void *data);
+
+enum FiniteAudioEffectType {
+    FINITE_AUDIO_EFFECT_GAIN,
+    FINITE_AUDIO_EFFECT_LOWPASS,
+    FINITE_AUDIO_EFFECT_HIGHPASS,
+    FINITE_AUDIO_EFFECT_DELAY,
+    FINITE_AUDIO_EFFECT_REVERB,
+    FINITE_AUDIO_EFFECT_LIMITER,
+    FINITE_AUDIO_EFFECT_CUSTOM
+};
+
+struct FiniteAudioEffect {
+    FiniteAudioEffectType type;
+    uint32_t sampleRate;
+    _Atomic bool bypass;
+    // parameters may be changed from any thread. the audio thread picks them up at the start of its next block.
+    _Atomic float params[3];
+    _Atomic uint32_t changed;
+    uint32_t applied;
+    // audio thread state
+    union {
+        struct {
+            float current;
+            float target;
+            float step;
+            uint32_t rampLeft;
+        } gain;
+        struct {
+            float coeffs[5];
+            float state[4];
+        } biquad;
+        struct {
+            float *lines[FINITE_AUDIO_EFFECT_REVERB_LINES];
+            size_t lengths[FINITE_AUDIO_EFFECT_REVERB_LINES]; // in samples
+            size_t positions[FINITE_AUDIO_EFFECT_REVERB_LINES];
+            size_t capacity; // samples per line
+            uint32_t _lines;
+            float feedback;
+            float wet;
+            float *dry; // copy of the input for the reverb
+        } delay;
+        struct {
+            float gain;
+            float threshold;
+            float release; // how far the gain recovers towards 1 per step
+        } limiter;
+        struct {
+            FiniteAudioEffectProcess process;
+            void *data;
+        } custom;
+    };
+};
+
+// effects run in the order they were added. a chain can be added to (from one thread) while it's playing but never shrinks.
+struct FiniteAudioEffectChain {
+    FiniteAudioEffect *effects[FINITE_AUDIO_EFFECT_CHAIN_MAX];
+    _Atomic uint32_t _effects;
+};
+
+// gain changes ramp over rampMs so they don't click
+#define finite_audio_effect_create_gain(sampleRate, gain, rampMs) finite_audio_effect_create_gain_debug(__FILE__, __func__, __LINE__, sampleRate, gain, rampMs)
+FiniteAudioEffect *finite_audio_effect_create_gain_debug(const char *file, const char *func, int line, uint32_t sampleRate, float gain, float rampMs);
+
+// type is FINITE_AUDIO_EFFECT_LOWPASS or FINITE_AUDIO_EFFECT_HIGHPASS. 0.707 is a flat q.
+#define finite_audio_effect_create_filter(sampleRate, type, cutoff, q) finite_audio_effect_create_filter_debug(__FILE__, __func__, __LINE__, sampleRate, type, cutoff, q)
+FiniteAudioEffect *finite_audio_effect_create_filter_debug(const char *file, const char *func, int line, uint32_t sampleRate, FiniteAudioEffectType type, float cutoff, float q);
+
+// an echo. maxDelayMs sizes the delay line, delayMs can be moved anywhere under it later.
+#define finite_audio_effect_create_delay(sampleRate, delayMs, feedback, wet, maxDelayMs) finite_audio_effect_create_delay_debug(__FILE__, __func__, __LINE__, sampleRate, delayMs, feedback, wet, maxDelayMs)
+FiniteAudioEffect *finite_audio_effect_create_delay_debug(const char *file, const char *func, int line, uint32_t sampleRate, float delayMs, float feedback, float wet, float maxDelayMs);
+
+// a small comb filter reverb. size goes from 0 (small room) to 1 (hall).
+#define finite_audio_effect_create_reverb(sampleRate, size, wet) finite_audio_effect_create_reverb_debug(__FILE__, __func__, __LINE__, sampleRate, size, wet)
+FiniteAudioEffect *finite_audio_effect_create_reverb_debug(const char *file, const char *func, int line, uint32_t sampleRate, float size, float wet);
+
+// keeps peaks under threshold (linear, 1.0 is full scale). there's no lookahead so it reacts within a few frames.
+#define finite_audio_effect_create_limiter(sampleRate, threshold, releaseMs) finite_audio_effect_create_limiter_debug(__FILE__, __func__, __LINE__, sampleRate, threshold, releaseMs)
+FiniteAudioEffect *finite_audio_effect_create_limiter_debug(const char *file, const char *func, int line, uint32_t sampleRate, float threshold, float releaseMs);
+
+#define finite_audio_effect_create_custom(process, data) finite_audio_effect_create_custom_debug(__FILE__, __func__, __LINE__, process, data)
+FiniteAudioEffect *finite_audio_effect_create_custom_debug(const char *file, const char *func, int line, FiniteAudioEffectProcess process, void *data);
+
+// these are safe to call from any thread while the effect is playing
+void finite_audio_effect_set_gain(FiniteAudioEffect *effect, float gain);
+void finite_audio_effect_set_filter(FiniteAudioEffect *effect, float cutoff, float q);
+void finite_audio_effect_set_delay(FiniteAudioEffect *effect, float delayMs, float feedback, float wet);
+void finite_audio_effect_set_reverb(FiniteAudioEffect *effect, float size, float wet);
+void finite_audio_effect_set_limiter(FiniteAudioEffect *effect, float threshold, float releaseMs);
+void finite_audio_effect_set_bypass(FiniteAudioEffect *effect, bool bypass);
+
+// runs the effect on the calling thread. this is what the mixer calls.
+void finite_audio_effect_process(FiniteAudioEffect *effect, float *buffer, size_t frames);
+
+// clears delay lines and filter state. nothing may be playing through the effect.
+void finite_audio_effect_reset(FiniteAudioEffect *effect);
+
+#define finite_audio_effect_destroy(effect) finite_audio_effect_destroy_debug(__FILE__, __func__, __LINE__, effect)
+void finite_audio_effect_destroy_debug(const char *file, const char *func, int line, FiniteAudioEffect *effect);
+
+#define finite_audio_effect_chain_create() finite_audio_effect_chain_create_debug(__FILE__, __func__, __LINE__)
+FiniteAudioEffectChain *finite_audio_effect_chain_create_debug(const char *file, const char *func, int line);
+
+// the chain takes ownership of effect
+#define finite_audio_effect_chain_add(chain, effect) finite_audio_effect_chain_add_debug(__FILE__, __func__, __LINE__, chain, effect)
+bool finite_audio_effect_chain_add_debug(const char *file, const char *func, int line, FiniteAudioEffectChain *chain, FiniteAudioEffect *effect);
+
+void finite_audio_effect_chain_process(FiniteAudioEffectChain *chain, float *buffer, size_t frames);
+
+// destroys every effect in the chain. nothing may be playing through it anymore.
+#define finite_audio_effect_chain_destroy(chain) finite_audio_effect_chain_destroy_debug(__FILE__, __func__, __LINE__, chain)
+void finite_audio_effect_chain_destroy_debug(const char *file, const char *func, int line, FiniteAudioEffectChain *chain);
+
+#endif
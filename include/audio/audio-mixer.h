@@ -0,0 +1,157 @@
+// audio.h pulls this header in after the playback device is declared
+#include "audio.h"
+#ifndef __AUDIO_MIXER_H__
+#define __AUDIO_MIXER_H__
+#include "audio-dsp.h"
+#include "audio-effect.h"
+
+// frames mixed per pass. the bus is sized for this many stereo frames.
+#define FINITE_AUDIO_MIXER_BLOCK 1024
+// pending commands between the game threads and the mixer
+#define FINITE_AUDIO_MIXER_QUEUE 256
+
+#define FINITE_AUDIO_VOICE_NONE 0
+
+// voices are referred to by id. ids are never reused so a stale id just does nothing.
+typedef uint32_t FiniteAudioVoice;
+
+typedef struct FiniteAudioVoiceInfo FiniteAudioVoiceInfo;
+typedef struct FiniteAudioMixerVoice FiniteAudioMixerVoice;
+typedef struct FiniteAudioMixerCommand FiniteAudioMixerCommand;
+typedef struct FiniteAudioMixerSlot FiniteAudioMixerSlot;
+typedef struct FiniteAudioMixerEmitters FiniteAudioMixerEmitters;
+typedef struct FiniteAudioMixer FiniteAudioMixer;
+typedef enum FiniteAudioMixerCommandType FiniteAudioMixerCommandType;
+
+struct FiniteAudioVoiceInfo {
+    const short *pcm; // interleaved S16 at the mixer's sample rate. must stay alive while the voice plays.
+    size_t frames;
+    uint32_t channels; // 1 or 2
+    float gain;
+    float pan; // -1.0 (left) to 1.0 (right)
+    bool loop;
+    FiniteAudioEffectChain *effects; // optional. runs on the voice after it's panned.
+    // positional voices ignore pan and are placed relative to the mixer's listener instead
+    bool positional;
+    float position[3];
+    float minDistance; // full volume inside this. defaults to 1.
+    float maxDistance; // stops getting quieter past this. 0 means never.
+    float rolloff; // how quickly it fades between the two. 1 halves the gain each time the distance doubles. defaults to 1, so 0 can't turn attenuation off. set maxDistance to minDistance for that.
+};
+
+enum FiniteAudioMixerCommandType {
+    FINITE_AUDIO_MIXER_PLAY,
+    FINITE_AUDIO_MIXER_STOP,
+    FINITE_AUDIO_MIXER_STOP_ALL,
+    FINITE_AUDIO_MIXER_SET_GAIN,
+    FINITE_AUDIO_MIXER_SET_PAN,
+    FINITE_AUDIO_MIXER_SET_LOOP,
+    FINITE_AUDIO_MIXER_SET_EFFECTS,
+    FINITE_AUDIO_MIXER_SET_BUS_EFFECTS,
+    FINITE_AUDIO_MIXER_SET_POSITION,
+    FINITE_AUDIO_MIXER_SET_LISTENER
+};
+
+struct FiniteAudioMixerCommand {
+    FiniteAudioMixerCommandType type;
+    FiniteAudioVoice voice;
+    FiniteAudioVoiceInfo info;
+    float value;
+    FiniteAudioEffectChain *effects;
+    float vector[6]; // an emitter's position, or the listener's position then its right vector
+};
+
+// one slot of the bounded multi-producer queue
+struct FiniteAudioMixerSlot {
+    _Atomic size_t sequence;
+    FiniteAudioMixerCommand command;
+};
+
+// owned by the mixer thread. only the id is read from other threads.
+struct FiniteAudioMixerVoice {
+    _Atomic FiniteAudioVoice id;
+    FiniteAudioVoiceInfo info;
+    size_t position;
+};
+
+// one entry per voice slot, kept as separate arrays so every positional gain is worked out in a single vector pass per block
+struct FiniteAudioMixerEmitters {
+    float *x;
+    float *y;
+    float *z;
+    float *minDistance;
+    float *maxDistance;
+    float *rolloff;
+    float *gainL;
+    float *gainR;
+};
+
+struct FiniteAudioMixer {
+    FinitePlaybackDevice *dev; // NULL when the mixer is only rendered by hand
+    uint32_t sampleRate;
+    FiniteAudioMixerVoice *voices;
+    uint32_t _voices;
+    _Atomic uint32_t _activeVoices;
+    _Atomic FiniteAudioVoice nextVoice;
+    FiniteAudioMixerSlot *queue;
+    size_t queueMask;
+    _Alignas(64) _Atomic size_t enqueuePos;
+    _Alignas(64) size_t dequeuePos;
+    float *bus; // stereo float accumulator
+    float *voiceBus; // scratch for voices that have effects
+    FiniteAudioEffectChain *busEffects; // runs on the whole mix. owned by the mixer thread once set.
+    _Atomic float masterGain;
+    float listener[6]; // position then unit right vector. owned by the mixer thread.
+    FiniteAudioMixerEmitters emitters;
+};
+
+#define finite_audio_mixer_create(dev, sampleRate, maxVoices) finite_audio_mixer_create_debug(__FILE__, __func__, __LINE__, dev, sampleRate, maxVoices)
+FiniteAudioMixer *finite_audio_mixer_create_debug(const char *file, const char *func, int line, FinitePlaybackDevice *dev, uint32_t sampleRate, uint32_t maxVoices);
+
+#define finite_audio_mixer_start(mixer) finite_audio_mixer_start_debug(__FILE__, __func__, __LINE__, mixer)
+bool finite_audio_mixer_start_debug(const char *file, const char *func, int line, FiniteAudioMixer *mixer);
+
+#define finite_audio_mixer_play(mixer, info) finite_audio_mixer_play_debug(__FILE__, __func__, __LINE__, mixer, info)
+FiniteAudioVoice finite_audio_mixer_play_debug(const char *file, const char *func, int line, FiniteAudioMixer *mixer, FiniteAudioVoiceInfo *info);
+
+#define finite_audio_mixer_stop_voice(mixer, voice) finite_audio_mixer_stop_voice_debug(__FILE__, __func__, __LINE__, mixer, voice)
+bool finite_audio_mixer_stop_voice_debug(const char *file, const char *func, int line, FiniteAudioMixer *mixer, FiniteAudioVoice voice);
+
+#define finite_audio_mixer_stop_all(mixer) finite_audio_mixer_stop_all_debug(__FILE__, __func__, __LINE__, mixer)
+bool finite_audio_mixer_stop_all_debug(const char *file, const char *func, int line, FiniteAudioMixer *mixer);
+
+#define finite_audio_mixer_set_gain(mixer, voice, gain) finite_audio_mixer_set_gain_debug(__FILE__, __func__, __LINE__, mixer, voice, gain)
+bool finite_audio_mixer_set_gain_debug(const char *file, const char *func, int line, FiniteAudioMixer *mixer, FiniteAudioVoice voice, float gain);
+
+#define finite_audio_mixer_set_pan(mixer, voice, pan) finite_audio_mixer_set_pan_debug(__FILE__, __func__, __LINE__, mixer, voice, pan)
+bool finite_audio_mixer_set_pan_debug(const char *file, const char *func, int line, FiniteAudioMixer *mixer, FiniteAudioVoice voice, float pan);
+
+#define finite_audio_mixer_set_loop(mixer, voice, loop) finite_audio_mixer_set_loop_debug(__FILE__, __func__, __LINE__, mixer, voice, loop)
+bool finite_audio_mixer_set_loop_debug(const char *file, const char *func, int line, FiniteAudioMixer *mixer, FiniteAudioVoice voice, bool loop);
+
+// chain may be NULL to remove the effects. the mixer swaps chains at its next block so only destroy the old one after that (or once it's stopped).
+#define finite_audio_mixer_set_effects(mixer, voice, chain) finite_audio_mixer_set_effects_debug(__FILE__, __func__, __LINE__, mixer, voice, chain)
+bool finite_audio_mixer_set_effects_debug(const char *file, const char *func, int line, FiniteAudioMixer *mixer, FiniteAudioVoice voice, FiniteAudioEffectChain *chain);
+
+#define finite_audio_mixer_set_bus_effects(mixer, chain) finite_audio_mixer_set_bus_effects_debug(__FILE__, __func__, __LINE__, mixer, chain)
+bool finite_audio_mixer_set_bus_effects_debug(const char *file, const char *func, int line, FiniteAudioMixer *mixer, FiniteAudioEffectChain *chain);
+
+// moves a positional voice. it's ignored for voices that weren't played as positional.
+#define finite_audio_mixer_set_position(mixer, voice, x, y, z) finite_audio_mixer_set_position_debug(__FILE__, __func__, __LINE__, mixer, voice, x, y, z)
+bool finite_audio_mixer_set_position_debug(const char *file, const char *func, int line, FiniteAudioMixer *mixer, FiniteAudioVoice voice, float x, float y, float z);
+
+// position, forward and up are 3 floats each. the listener starts at the origin facing -z with +y up.
+#define finite_audio_mixer_set_listener(mixer, position, forward, up) finite_audio_mixer_set_listener_debug(__FILE__, __func__, __LINE__, mixer, position, forward, up)
+bool finite_audio_mixer_set_listener_debug(const char *file, const char *func, int line, FiniteAudioMixer *mixer, const float *position, const float *forward, const float *up);
+
+void finite_audio_mixer_set_master_gain(FiniteAudioMixer *mixer, float gain);
+bool finite_audio_mixer_voice_active(FiniteAudioMixer *mixer, FiniteAudioVoice voice);
+uint32_t finite_audio_mixer_get_active_voices(FiniteAudioMixer *mixer);
+
+// mixes up to frames into out without a device. this is what the engine calls on the mixer thread.
+size_t finite_audio_mixer_render(FiniteAudioMixer *mixer, short *out, size_t frames);
+
+#define finite_audio_mixer_destroy(mixer) finite_audio_mixer_destroy_debug(__FILE__, __func__, __LINE__, mixer)
+void finite_audio_mixer_destroy_debug(const char *file, const char *func, int line, FiniteAudioMixer *mixer);
+
+#endif
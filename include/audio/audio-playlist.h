@@ -0,0 +1,77 @@
+// audio.h pulls this header in after the playback device is declared
+#include "audio.h"
+#ifndef __AUDIO_PLAYLIST_H__
+#define __AUDIO_PLAYLIST_H__
+
+// tracks that can be queued (including the one playing) before the queue is full
+#define FINITE_AUDIO_PLAYLIST_MAX 16
+// frames decoded when a track is queued so the switch never waits on the file
+#define FINITE_AUDIO_PLAYLIST_PREROLL 8192
+// frames crossfaded per pass
+#define FINITE_AUDIO_PLAYLIST_BLOCK 1024
+
+typedef struct FiniteAudioTrack FiniteAudioTrack;
+typedef struct FiniteAudioPlaylist FiniteAudioPlaylist;
+
+// one queued file. it's opened, resampled and partly decoded on the thread that queued it.
+struct FiniteAudioTrack {
+    char *path;
+    FiniteAudioStream *stream;
+    SNDFILE *file;
+    uint32_t sampleRate;
+    uint32_t channels;
+    FiniteAudioResampler *resampler;
+    short *raw; // source frames before they're converted to the playlist's channels
+    short *decodeBuffer; // source frames waiting for the resampler
+    size_t decodeCap;
+    size_t decodeLen;
+    size_t decodeOffset;
+    bool sourceDone;
+    short *pending; // the preroll, already at the playlist's rate and channels
+    size_t _pending;
+    size_t pendingOffset;
+    size_t outFrames; // how many frames the track plays for at the playlist's rate. 0 when the file doesn't say.
+    size_t played;
+    // frames at the end that overlap the next track. decided once, when the track reaches its fade,
+    // so a track queued after that doesn't cut in halfway.
+    size_t fadeFrames;
+    bool fadeDecided;
+};
+
+// plays queued files back to back on one open device. only one thread may queue.
+struct FiniteAudioPlaylist {
+    FinitePlaybackDevice *dev; // NULL when the playlist is only rendered by hand
+    uint32_t sampleRate;
+    uint32_t channels;
+    FiniteAudioTrack *tracks[FINITE_AUDIO_PLAYLIST_MAX];
+    _Atomic size_t head; // the playing track. only the audio thread moves it.
+    _Atomic size_t tail; // where the next track goes. only the queueing thread moves it.
+    size_t reclaim; // tracks before head that the queueing thread hasn't freed yet
+    _Atomic uint32_t crossfadeFrames;
+    short *scratch; // the incoming track during a crossfade
+};
+
+// with a device the playlist becomes its fill source. the queue plays silence when it runs dry so the pcm stays open.
+#define finite_audio_playlist_create(dev, sampleRate, channels) finite_audio_playlist_create_debug(__FILE__, __func__, __LINE__, dev, sampleRate, channels)
+FiniteAudioPlaylist *finite_audio_playlist_create_debug(const char *file, const char *func, int line, FinitePlaybackDevice *dev, uint32_t sampleRate, uint32_t channels);
+
+#define finite_audio_playlist_start(playlist) finite_audio_playlist_start_debug(__FILE__, __func__, __LINE__, playlist)
+bool finite_audio_playlist_start_debug(const char *file, const char *func, int line, FiniteAudioPlaylist *playlist);
+
+// opens and pre-decodes path on the calling thread, then appends it to the queue
+#define finite_audio_playlist_queue(playlist, path) finite_audio_playlist_queue_debug(__FILE__, __func__, __LINE__, playlist, path)
+bool finite_audio_playlist_queue_debug(const char *file, const char *func, int line, FiniteAudioPlaylist *playlist, const char *path);
+
+// how long each track fades into the next. 0 butts them up gaplessly.
+void finite_audio_playlist_set_crossfade(FiniteAudioPlaylist *playlist, float ms);
+
+// tracks waiting to play, including the current one
+uint32_t finite_audio_playlist_get_queued(FiniteAudioPlaylist *playlist);
+
+// renders frames into out without a device. this is what the engine calls on its decode thread.
+size_t finite_audio_playlist_render(FiniteAudioPlaylist *playlist, short *out, size_t frames);
+
+#define finite_audio_playlist_destroy(playlist) finite_audio_playlist_destroy_debug(__FILE__, __func__, __LINE__, playlist)
+void finite_audio_playlist_destroy_debug(const char *file, const char *func, int line, FiniteAudioPlaylist *playlist);
+
+#endif
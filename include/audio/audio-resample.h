@@ -0,0 +1,56 @@
+#ifndef __AUDIO_RESAMPLE_H__
+#define __AUDIO_RESAMPLE_H__
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// the most filter phases a resampler will build. rates that need more get the closest ratio that fits.
+#define FINITE_AUDIO_RESAMPLER_MAX_PHASES 1024
+
+typedef struct FiniteAudioResampler FiniteAudioResampler;
+typedef enum FiniteAudioResampleQuality FiniteAudioResampleQuality;
+
+enum FiniteAudioResampleQuality {
+    FINITE_AUDIO_RESAMPLE_FAST,   // 8 taps. fine for sound effects
+    FINITE_AUDIO_RESAMPLE_MEDIUM, // 24 taps
+    FINITE_AUDIO_RESAMPLE_HIGH    // 64 taps. for music
+};
+
+// streaming polyphase resampler. converts interleaved audio from inRate to outRate one block at a time.
+struct FiniteAudioResampler {
+    uint32_t inRate;
+    uint32_t outRate;
+    uint32_t channels;
+    uint32_t up;   // L in L/M
+    uint32_t down; // M in L/M
+    uint32_t taps;
+    float *coeffs; // up phases of taps reversed coefficients each
+    float **history; // planar input history, one array per channel
+    size_t historyCap;
+    size_t historyLen;
+    size_t start; // first history frame under the filter for the next output
+    uint32_t phase;
+    uint32_t drainLeft;
+    bool draining;
+    float *scratch; // interleaved float input for the s16 path
+};
+
+#define finite_audio_resampler_create(inRate, outRate, channels, quality) finite_audio_resampler_create_debug(__FILE__, __func__, __LINE__, inRate, outRate, channels, quality)
+FiniteAudioResampler *finite_audio_resampler_create_debug(const char *file, const char *func, int line, uint32_t inRate, uint32_t outRate, uint32_t channels, FiniteAudioResampleQuality quality);
+
+// in and out are interleaved. inFrames and outFrames go in as the space available and come back as what was used.
+void finite_audio_resampler_process_f32(FiniteAudioResampler *rs, const float *in, size_t *inFrames, float *out, size_t *outFrames);
+void finite_audio_resampler_process_s16(FiniteAudioResampler *rs, const short *in, size_t *inFrames, short *out, size_t *outFrames);
+
+// flushes the frames still held in the filter once the input has ended. returns 0 when there's nothing left.
+size_t finite_audio_resampler_drain_s16(FiniteAudioResampler *rs, short *out, size_t outFrames);
+
+// how many output frames inFrames of input will turn into
+size_t finite_audio_resampler_get_output_frames(FiniteAudioResampler *rs, size_t inFrames);
+
+void finite_audio_resampler_reset(FiniteAudioResampler *rs);
+
+#define finite_audio_resampler_destroy(rs) finite_audio_resampler_destroy_debug(__FILE__, __func__, __LINE__, rs)
+void finite_audio_resampler_destroy_debug(const char *file, const char *func, int line, FiniteAudioResampler *rs);
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef __AUDIO_RING_H__
+#define __AUDIO_RING_H__
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// single producer / single consumer ring of interleaved S16 frames.
+// one thread may write and one other thread may read without any locking.
+typedef struct FiniteAudioRing FiniteAudioRing;
+
+struct FiniteAudioRing {
+    short *data;
+    size_t capacity; // in frames, always a power of two
+    size_t mask;
+    uint32_t channels;
+    // head and tail live on their own cache lines so the two threads don't fight over them
+    _Alignas(64) _Atomic size_t head; // next frame the producer writes
+    _Alignas(64) _Atomic size_t tail; // next frame the consumer reads
+};
+
+#define finite_audio_ring_init(ring, frames, channels) finite_audio_ring_init_debug(__FILE__, __func__, __LINE__, ring, frames, channels)
+bool finite_audio_ring_init_debug(const char *file, const char *func, int line, FiniteAudioRing *ring, size_t frames, uint32_t channels);
+
+void finite_audio_ring_free(FiniteAudioRing *ring);
+void finite_audio_ring_reset(FiniteAudioRing *ring);
+
+size_t finite_audio_ring_readable(FiniteAudioRing *ring);
+size_t finite_audio_ring_writable(FiniteAudioRing *ring);
+
+// zero copy access. begin returns the largest contiguous region and commit publishes it to the other side.
+short *finite_audio_ring_write_begin(FiniteAudioRing *ring, size_t *frames);
+void finite_audio_ring_write_commit(FiniteAudioRing *ring, size_t frames);
+const short *finite_audio_ring_read_begin(FiniteAudioRing *ring, size_t *frames);
+void finite_audio_ring_read_commit(FiniteAudioRing *ring, size_t frames);
+
+size_t finite_audio_ring_write(FiniteAudioRing *ring, const short *frames, size_t count);
+size_t finite_audio_ring_read(FiniteAudioRing *ring, short *out, size_t count);
+
+#endif
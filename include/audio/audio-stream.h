@@ -0,0 +1,39 @@
+#ifndef __AUDIO_STREAM_H__
+#define __AUDIO_STREAM_H__
+#include <sndfile.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "core.h"
+
+typedef struct FiniteAudioStream FiniteAudioStream;
+
+// an encoded file sitting in memory that sndfile reads through its virtual io callbacks.
+// the decoder never makes a read syscall; pages are asked for ahead of time with madvise instead.
+struct FiniteAudioStream {
+    const unsigned char *data;
+    sf_count_t size;
+    sf_count_t offset; // sndfile's read position
+    FiniteFileMap map; // our own mapping, unmapped on destroy. data is NULL when the memory is the caller's.
+    sf_count_t advised; // the range up to here has already been handed to madvise
+    sf_count_t aheadBytes; // how much past offset to keep advised. 0 turns prefetching off.
+};
+
+// maps the file at path read only
+#define finite_audio_stream_map(path) finite_audio_stream_map_debug(__FILE__, __func__, __LINE__, path)
+FiniteAudioStream *finite_audio_stream_map_debug(const char *file, const char *func, int line, const char *path);
+
+// streams from memory the caller owns (like an asset pack entry). it must outlive the stream.
+#define finite_audio_stream_from_memory(data, size) finite_audio_stream_from_memory_debug(__FILE__, __func__, __LINE__, data, size)
+FiniteAudioStream *finite_audio_stream_from_memory_debug(const char *file, const char *func, int line, const void *data, size_t size);
+
+// opens the stream with sndfile. a stream only has one read position so only open it once at a time.
+#define finite_audio_stream_open(stream, info) finite_audio_stream_open_debug(__FILE__, __func__, __LINE__, stream, info)
+SNDFILE *finite_audio_stream_open_debug(const char *file, const char *func, int line, FiniteAudioStream *stream, SF_INFO *info);
+
+// asks the kernel to start reading in the next aheadBytes past the read position. cheap to call after every read.
+void finite_audio_stream_prefetch(FiniteAudioStream *stream);
+
+#define finite_audio_stream_destroy(stream) finite_audio_stream_destroy_debug(__FILE__, __func__, __LINE__, stream)
+void finite_audio_stream_destroy_debug(const char *file, const char *func, int line, FiniteAudioStream *stream);
+
+#endif
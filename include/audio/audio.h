@@ -5,10 +5,21 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "audio-ring.h"
+#include "audio-resample.h"
+#include "audio-stream.h"
 
 // refers to the device
 typedef struct FinitePlaybackDevice FinitePlaybackDevice;
 typedef struct FinitePlaybackDuration FinitePlaybackDuration;
+typedef struct FiniteAudioStats FiniteAudioStats;
+typedef enum FiniteAudioLatency FiniteAudioLatency;
+
+// produces up to frames of interleaved S16 audio into out. returning 0 ends playback.
+typedef size_t (*FiniteAudioFill)(FinitePlaybackDevice *dev, short *out, size_t frames, void *data);
 struct FinitePlaybackDuration {
     double trueSeconds;
     int hours;
@@ -17,12 +28,36 @@ struct FinitePlaybackDuration {
     int milliseconds;
 };
 
+enum FiniteAudioLatency {
+    FINITE_AUDIO_LATENCY_DEFAULT,   // whatever the device picks
+    FINITE_AUDIO_LATENCY_LOW,       // 3 periods of 2.5ms. needs a quiet system
+    FINITE_AUDIO_LATENCY_BALANCED,  // 4 periods of 10ms
+    FINITE_AUDIO_LATENCY_POWER_SAVE // 4 periods of 50ms so the cpu rarely wakes up
+};
+
+// a snapshot of the engine's counters since playback started (or the last reset)
+struct FiniteAudioStats {
+    uint64_t xruns;
+    uint64_t writes; // writes (or mmap commits) to the device
+    snd_pcm_uframes_t bufferFrames;
+    snd_pcm_uframes_t periodFrames;
+    // frames still queued in the device when a write started. a low minimum means an xrun was close.
+    snd_pcm_uframes_t fillMin;
+    snd_pcm_uframes_t fillMax;
+    double fillAvg;
+    // frames the decoder had ready in the ring
+    size_t ringFillMax;
+    double ringFillAvg;
+    // how far the time between writes strayed from one period
+    double jitterAvgUs;
+    double jitterMaxUs;
+};
+
 struct FinitePlaybackDevice {
     char *name;
     char *filename;
-    bool isPlaying;
-    bool isPaused;
-    short *audioBuffer;
+    _Atomic bool isPlaying;
+    _Atomic bool isPaused;
     FinitePlaybackDuration dur;
     snd_pcm_t *device;
     snd_pcm_format_t format;
@@ -32,12 +67,73 @@ struct FinitePlaybackDevice {
     sf_count_t sfFrames;
     uint32_t sample_rate;
     uint32_t channels;
-    uint32_t buff_time;
-    uint32_t buff_per;
+    uint32_t buff_time; // buffer time in us. 0 leaves it to the device.
+    uint32_t buff_per; // period time in us. 0 leaves it to the device.
     double freq;
     int verbose;
     int resample;
-    int per_event;
+    int per_event; // wake on period events instead of avail_min
+    snd_pcm_uframes_t bufferFrames;
+    // the pcm runs at deviceRate. sources at any other rate go through the resampler instead of alsa's plug layer.
+    uint32_t preferredRate; // 0 asks the device for the source's rate
+    uint32_t deviceRate;
+    FiniteAudioResampleQuality resampleQuality;
+    FiniteAudioResampler *resampler;
+    short *decodeBuffer; // source rate frames waiting for the resampler
+    size_t decodeCap;
+    size_t decodeLen;
+    size_t decodeOffset;
+    bool sourceDone;
+    // playback engine. decoding runs ahead into the ring while the output thread feeds the device.
+    FiniteAudioRing ring;
+    FiniteAudioFill fill; // when set the engine pulls frames from here instead of the file
+    void *fillData;
+    size_t ringFrames; // 0 picks a size based on the device buffer
+    float aheadSeconds; // how much the decoder stays ahead of the device when ringFrames is 0. 0 keeps it to a few device buffers.
+    FiniteAudioStream *stream; // set when the file is streamed from memory. owned by the device.
+    bool useMmap; // set before init to decode and mix straight into the device's mmap buffer. there's no ring or decode thread then.
+    pthread_t decoder;
+    pthread_t output;
+    pthread_mutex_t wakeLock; // only used to sleep, audio data never goes through it
+    pthread_cond_t wake;
+    _Atomic int sleepers;
+    _Atomic bool decodeDone;
+    bool engineRunning;
+    // the engine sleeps in epoll_wait on pollFd, which holds the pcm's descriptors and eventFd.
+    // stop, pause and seek bump eventFd so a sleeping thread hears about them right away.
+    int eventFd;
+    int pollFd;
+    struct pollfd *pollFds; // the pcm descriptors currently in pollFd
+    int _pollFds;
+    bool polled; // the app drives playback with finite_audio_service() instead of engine threads
+    bool draining;
+    bool pcmPaused;
+    sf_count_t writeBase; // writePosition at the last seek
+    sf_count_t written; // device frames written since then
+    // seeking. the decoder seeks the file and parks, then the output thread flushes the ring and pcm.
+    _Atomic sf_count_t seekTarget;
+    _Atomic sf_count_t seekResult;
+    _Atomic uint32_t seekRequest;
+    _Atomic uint32_t decoderSeek;
+    _Atomic uint32_t outputSeek;
+    // playback position in frames
+    sf_count_t writePosition; // file frame of the next frame handed to the device
+    _Atomic uint32_t positionSeq;
+    _Atomic sf_count_t positionFrame;
+    _Atomic sf_count_t positionLimit;
+    _Atomic uint64_t positionTime;
+    // telemetry. only the output thread writes these.
+    _Atomic uint64_t xruns;
+    _Atomic uint64_t writes;
+    _Atomic uint64_t fillSum;
+    _Atomic snd_pcm_uframes_t fillMin;
+    _Atomic snd_pcm_uframes_t fillMax;
+    _Atomic uint64_t ringFillSum;
+    _Atomic size_t ringFillMax;
+    _Atomic uint64_t jitterSum; // ns
+    _Atomic uint64_t jitterMax;
+    _Atomic uint64_t jitterSamples;
+    uint64_t lastWrite;
 };
 
 #define finite_audio_get_audio_duration(dev) finite_audio_get_audio_duration_debug(__FILE__, __func__, __LINE__, dev)
@@ -49,12 +145,60 @@ bool finite_audio_get_audio_params_debug(const char *rfile, const char *func, in
 #define finite_audio_device_init() finite_audio_device_init_debug(__FILE__, __func__, __LINE__)
 FinitePlaybackDevice *finite_audio_device_init_debug(const char *file, const char *func, int line);
 
+// opens a pcm by name, e.g. "hw:0,0" to skip the plug layer entirely
+#define finite_audio_device_open(name) finite_audio_device_open_debug(__FILE__, __func__, __LINE__, name)
+FinitePlaybackDevice *finite_audio_device_open_debug(const char *file, const char *func, int line, const char *name);
+
+// these pick the device's buffer and period. call them before init or between plays, not while playing.
+#define finite_audio_set_latency(dev, latency) finite_audio_set_latency_debug(__FILE__, __func__, __LINE__, dev, latency)
+bool finite_audio_set_latency_debug(const char *file, const char *func, int line, FinitePlaybackDevice *dev, FiniteAudioLatency latency);
+
+#define finite_audio_set_buffer(dev, bufferUs, periodUs) finite_audio_set_buffer_debug(__FILE__, __func__, __LINE__, dev, bufferUs, periodUs)
+bool finite_audio_set_buffer_debug(const char *file, const char *func, int line, FinitePlaybackDevice *dev, uint32_t bufferUs, uint32_t periodUs);
+
+#define finite_audio_get_stats(dev, stats) finite_audio_get_stats_debug(__FILE__, __func__, __LINE__, dev, stats)
+bool finite_audio_get_stats_debug(const char *file, const char *func, int line, FinitePlaybackDevice *dev, FiniteAudioStats *stats);
+
+void finite_audio_reset_stats(FinitePlaybackDevice *dev);
+
 #define finite_audio_init_audio(dev, audio, autoCreate) finite_audio_init_audio_debug(__FILE__, __func__, __LINE__, dev, audio, autoCreate)
 bool finite_audio_init_audio_debug(const char *file, const char *func, int line, FinitePlaybackDevice *dev, char* audio, bool autoCreate);
 
+// like init_audio with autoCreate but the file is mapped and decoded from memory through sndfile's virtual io.
+// the decoder keeps aheadSeconds of audio ready and has the kernel read the file in ahead of that. 0 picks 2 seconds.
+#define finite_audio_init_stream(dev, path, aheadSeconds) finite_audio_init_stream_debug(__FILE__, __func__, __LINE__, dev, path, aheadSeconds)
+bool finite_audio_init_stream_debug(const char *file, const char *func, int line, FinitePlaybackDevice *dev, char *path, float aheadSeconds);
+
+#define finite_audio_init_output(dev, sampleRate, channels, fill, data) finite_audio_init_output_debug(__FILE__, __func__, __LINE__, dev, sampleRate, channels, fill, data)
+bool finite_audio_init_output_debug(const char *file, const char *func, int line, FinitePlaybackDevice *dev, uint32_t sampleRate, uint32_t channels, FiniteAudioFill fill, void *data);
+
 #define finite_audio_play(dev) finite_audio_play_debug(__FILE__, __func__, __LINE__, dev)
 void finite_audio_play_debug(const char *file, const char *func, int line, FinitePlaybackDevice *dev);
 
+#define finite_audio_play_async(dev) finite_audio_play_async_debug(__FILE__, __func__, __LINE__, dev)
+bool finite_audio_play_async_debug(const char *file, const char *func, int line, FinitePlaybackDevice *dev);
+
+// plays without any engine threads. add finite_audio_get_fd() to the app's event loop and call finite_audio_service() when it's readable.
+#define finite_audio_play_polled(dev) finite_audio_play_polled_debug(__FILE__, __func__, __LINE__, dev)
+bool finite_audio_play_polled_debug(const char *file, const char *func, int line, FinitePlaybackDevice *dev);
+
+// decodes and writes whatever the device has room for without blocking. returns false once polled playback has ended.
+bool finite_audio_service(FinitePlaybackDevice *dev);
+
+// an epoll descriptor that's readable whenever polled playback needs servicing. it stays the same for the device's lifetime.
+int finite_audio_get_fd(FinitePlaybackDevice *dev);
+
+#define finite_audio_wait(dev) finite_audio_wait_debug(__FILE__, __func__, __LINE__, dev)
+void finite_audio_wait_debug(const char *file, const char *func, int line, FinitePlaybackDevice *dev);
+
+#define finite_audio_seek(dev, frame) finite_audio_seek_debug(__FILE__, __func__, __LINE__, dev, frame)
+bool finite_audio_seek_debug(const char *file, const char *func, int line, FinitePlaybackDevice *dev, sf_count_t frame);
+
+#define finite_audio_rewind(dev) finite_audio_seek_debug(__FILE__, __func__, __LINE__, dev, 0)
+
+#define finite_audio_get_position(dev) finite_audio_get_position_debug(__FILE__, __func__, __LINE__, dev)
+sf_count_t finite_audio_get_position_debug(const char *file, const char *func, int line, FinitePlaybackDevice *dev);
+
 #define finite_audio_stop(dev) finite_audio_stop_debug(__FILE__, __func__, __LINE__, dev)
 bool finite_audio_stop_debug(const char *file, const char *func, int line, FinitePlaybackDevice *dev);
 
@@ -67,4 +211,9 @@ bool finite_audio_unpause_debug(const char *file, const char *func, int line, Fi
 #define finite_audio_cleanup(dev) finite_audio_cleanup_debug(__FILE__, __func__, __LINE__, dev)
 void finite_audio_cleanup_debug(const char *file, const char *func, int line, FinitePlaybackDevice *dev);
 
+// the rest of the audio api builds on top of the playback device
+#include "audio-mixer.h"
+#include "audio-bank.h"
+#include "audio-playlist.h"
+
 #endif
\ No newline at end of file
@@ -4,13 +4,44 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
 
 typedef struct {
     uint32_t* data;
     size_t size;
 } FileBuffer;
 
+typedef struct FiniteFileMap FiniteFileMap;
+typedef enum FiniteFileHint FiniteFileHint;
+
+// how a mapping is going to be read. they're passed to madvise and can be or'd together.
+enum FiniteFileHint {
+    FINITE_FILE_HINT_NORMAL = 0,
+    FINITE_FILE_HINT_SEQUENTIAL = 1 << 0, // read front to back. the kernel reads ahead further and drops pages behind.
+    FINITE_FILE_HINT_RANDOM = 1 << 1, // jumped around in. read ahead is turned off.
+    FINITE_FILE_HINT_WILLNEED = 1 << 2 // start reading the whole file in now
+};
+
+// a read only view of a whole file. data is page aligned (or pack aligned, see pack.h) so it can be handed
+// straight to vulkan or a decoder.
+struct FiniteFileMap {
+    const void *data;
+    size_t size;
+    bool borrowed; // points into a mounted pack. unmapping leaves the memory alone.
+};
+
 char* finite_readfile(const char* filename, size_t* fileSize);
 FileBuffer finite_read_raw_file(const char* filename);
 
-#endif
\ No newline at end of file
+// files in a mounted pack are found there first, without touching the filesystem
+#define finite_file_map(path, hints, map) finite_file_map_debug(__FILE__, __func__, __LINE__, path, hints, map)
+bool finite_file_map_debug(const char *file, const char *func, int line, const char *path, FiniteFileHint hints, FiniteFileMap *map);
+
+// applies hints to part of a mapping, like the entry of a pack that's about to be read
+void finite_file_advise(FiniteFileMap *map, size_t offset, size_t length, FiniteFileHint hints);
+
+#define finite_file_unmap(map) finite_file_unmap_debug(__FILE__, __func__, __LINE__, map)
+void finite_file_unmap_debug(const char *file, const char *func, int line, FiniteFileMap *map);
+
+#endif
@@ -85,6 +85,10 @@ void finite_draw_png_debug(const char *file, const char *func, int line, FiniteS
 #define finite_draw_cached_png(shell, cache, x, y, width, height, fillOnFail) finite_draw_cached_png_debug(__FILE__, __func__, __LINE__, shell, cache, x, y, width, height, fillOnFail)
 void finite_draw_cached_png_debug(const char *file, const char *func, int line, FiniteShell *shell, cairo_surface_t *cache, double x, double y, double width, double height,  FiniteColorGroup *fillOnFail);
 
+// decodes path again into *cache, dropping the old surface. the old one is kept if path doesn't decode.
+#define finite_draw_reload_png(path, cache) finite_draw_reload_png_debug(__FILE__, __func__, __LINE__, path, cache)
+bool finite_draw_reload_png_debug(const char *file, const char *func, int line, const char *path, cairo_surface_t **cache);
+
 #define finite_draw_set_pattern_dithering(pattern, mode) finite_draw_set_pattern_dithering_debug(__FILE__, __func__, __LINE__, pattern, mode)
 void finite_draw_set_pattern_dithering_debug(const char *file, const char *func, int line, cairo_pattern_t * pattern, FiniteDitherMode mode);
 
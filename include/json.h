@@ -1,33 +1,72 @@
 #ifndef __JSON_H__
 #define __JSON_H__
-#define JSMN_HEADER
 
-// jsmn
+// jsmn. core/jsmn.c builds its implementation.
 #include "jsmn.h"
+#include <stdint.h>
+
+// objects and arrays nested deeper than this fail to parse rather than run the stack out
+#define FINITE_JSON_MAX_DEPTH 256
+// objects with at least this many members get a hash index when they're parsed. smaller ones are scanned.
+#define FINITE_JSON_INDEX_MIN 8
 
 typedef struct FiniteJSONValue FiniteJSONValue;
 
 struct FiniteJSONValue {
-    char *key;
-    char *value; // all values that are not arrays can be stored as strings
-    FiniteJSONValue **members; // FiniteJSONValues that belong to this one
+    char *key; // "" for array elements and the root
+    char *value; // strings and primitives as text. NULL for objects and arrays, except the root, which points at data as it was passed in.
+    FiniteJSONValue **members; // the fields of an object or elements of an array
     int _members;
     jsmntype_t type;
+    uint32_t hash; // finite_json_hash of key
+    uint32_t *index; // open addressed slots holding a member's position + 1, or NULL when the object is small
+    uint32_t _index; // a power of two
 };
 
+// fnv-1a
+static inline uint32_t finite_json_hash(const char *key) {
+    uint32_t hash = 2166136261u;
+    while (key && *key) {
+        hash ^= (unsigned char) *key++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// finite_json_hash of a string literal as a constant, for the _hashed lookups. literals longer than 32 characters
+// are hashed at run time.
+#define FINITE_JSON_KEY(literal) (sizeof(literal) - 1 > 32 ? finite_json_hash(literal) : FINITE_JSON_KEY_32(2166136261u, literal, 0))
+#define FINITE_JSON_KEY_STEP(h, s, i) ((uint32_t) (((h) ^ ((i) < sizeof(s) - 1 ? (unsigned char) (s)[(i) < sizeof(s) ? (i) : 0] : 0u)) * ((i) < sizeof(s) - 1 ? 16777619u : 1u)))
+#define FINITE_JSON_KEY_4(h, s, i) FINITE_JSON_KEY_STEP(FINITE_JSON_KEY_STEP(FINITE_JSON_KEY_STEP(FINITE_JSON_KEY_STEP(h, s, i), s, (i) + 1), s, (i) + 2), s, (i) + 3)
+#define FINITE_JSON_KEY_16(h, s, i) FINITE_JSON_KEY_4(FINITE_JSON_KEY_4(FINITE_JSON_KEY_4(FINITE_JSON_KEY_4(h, s, i), s, (i) + 4), s, (i) + 8), s, (i) + 12)
+#define FINITE_JSON_KEY_32(h, s, i) FINITE_JSON_KEY_16(FINITE_JSON_KEY_16(h, s, i), s, (i) + 16)
+
+// parses data in one pass into a tree that lives in a single allocation. data isn't modified.
 #define finite_json_parse(data) finite_json_parse_debug(__FILE__, __func__, __LINE__, data)
 FiniteJSONValue *finite_json_parse_debug(const char *file, const char *func, int line, char *data);
 
+// objects with an index are a hash lookup, smaller ones a scan that only compares keys whose hashes match
 #define finite_json_get_value_from_key(item, key) finite_json_get_value_from_key_debug(__FILE__, __func__, __LINE__, item, key)
 char *finite_json_get_value_from_key_debug(const char *file, const char *func, int line, FiniteJSONValue *item, char *key);
 
+// hash must be finite_json_hash(key), or FINITE_JSON_KEY(key) when key is a literal
+#define finite_json_get_value_from_key_hashed(item, key, hash) finite_json_get_value_from_key_hashed_debug(__FILE__, __func__, __LINE__, item, key, hash)
+char *finite_json_get_value_from_key_hashed_debug(const char *file, const char *func, int line, FiniteJSONValue *item, const char *key, uint32_t hash);
+
+// the same with the hash worked out at compile time. key has to be a string literal.
+#define finite_json_get_value_from_literal(item, key) finite_json_get_value_from_key_hashed(item, key, FINITE_JSON_KEY(key))
+
 #define finite_json_get_value(item) finite_json_get_value_debug(__FILE__, __func__, __LINE__, item)
 char *finite_json_get_value_debug(const char *file, const char *func, int line, FiniteJSONValue *item);
 
+// frees a tree from finite_json_parse. only pass the root, everything under it goes with it.
 #define finite_json_cleanup(item) finite_json_cleanup_debug(__FILE__, __func__, __LINE__, item)
 void finite_json_cleanup_debug(const char *file, const char *func, int line, FiniteJSONValue *item);
 
 #define finite_json_get_index_from_key(item, key) finite_json_get_index_from_key_debug(__FILE__, __func__, __LINE__, item, key)
 int finite_json_get_index_from_key_debug(const char *file, const char *func, int line, FiniteJSONValue *item, char *key);
 
+#define finite_json_get_index_from_key_hashed(item, key, hash) finite_json_get_index_from_key_hashed_debug(__FILE__, __func__, __LINE__, item, key, hash)
+int finite_json_get_index_from_key_hashed_debug(const char *file, const char *func, int line, FiniteJSONValue *item, const char *key, uint32_t hash);
+
 #endif
\ No newline at end of file
@@ -1,5 +1,12 @@
 #ifndef __LOG_H__
 #define __LOG_H__
+
+// calls below this level are compiled out, arguments and all. set with meson's min-log-level option
+// (1 debug, 2 info, 3 warn, 4 error, 5 fatal). unlike the level given to finite_log_init it can't be lowered at runtime.
+#ifndef FINITE_MIN_LOG_LEVEL
+#define FINITE_MIN_LOG_LEVEL 1
+#endif
+
 #define FINITE_LOG(fmt, ...)       finite_log_internal(LOG_LEVEL_DEBUG, __FILE__, __LINE__, __func__, fmt, ##__VA_ARGS__)
 #define FINITE_LOG_INFO(fmt, ...)  finite_log_internal(LOG_LEVEL_INFO,  __FILE__, __LINE__, __func__, fmt, ##__VA_ARGS__)
 #define FINITE_LOG_WARN(fmt, ...)  finite_log_internal(LOG_LEVEL_WARN,  __FILE__, __LINE__, __func__, fmt, ##__VA_ARGS__)
@@ -13,6 +20,35 @@
 #include <pthread.h>
 #include <time.h>
 
+// async mode: lines each thread can have waiting for the writer before new ones are dropped
+#define FINITE_LOG_RING_SLOTS 256
+// longer messages are cut off in async mode
+#define FINITE_LOG_MESSAGE_MAX 320
+// lines the writer sorts and writes in one go
+#define FINITE_LOG_BATCH 1024
+// how often the writer wakes up when nothing urgent has been logged
+#define FINITE_LOG_WRITER_TICK_MS 20
+
+// binary mode
+#define FINITE_LOG_MAGIC "FLOG"
+#define FINITE_LOG_VERSION 1
+// call sites that are given an id. any past this are defined again before every line they log.
+#define FINITE_LOG_SITES 4096
+// largest binary record, header included. long string arguments are cut to fit.
+#define FINITE_LOG_ENTRY_MAX 1024
+
+// flight recorder: lines kept per thread, and the raw argument bytes kept per line
+#define FINITE_LOG_RECORDER_SLOTS 512
+#define FINITE_LOG_TRACE_ARGS 192
+// threads a dump can include (the most recently started ones)
+#define FINITE_LOG_RECORDER_DUMP_THREADS 64
+
+// call sites that can be rate limited. sites past this are never limited.
+#define FINITE_LOG_LIMIT_SITES 1024
+// a repeated line is still written once this often
+#define FINITE_LOG_REPEAT_MS 5000
+
+typedef struct FiniteLogHeader FiniteLogHeader;
 typedef struct FiniteLogEntry FiniteLogEntry;
 typedef struct FiniteLog FiniteLog;
 typedef enum FiniteLogLevel FiniteLogLevel;
@@ -26,18 +62,55 @@ enum FiniteLogLevel {
     LOG_LEVEL_FATAL = 5
 };
 
+// a binary log starts with this header, then holds FiniteLogEntry records back to back
+struct FiniteLogHeader {
+    char magic[4]; // FINITE_LOG_MAGIC
+    uint32_t version;
+    uint64_t realtime; // CLOCK_REALTIME in ns when the log was opened, to turn entry timestamps back into wall time
+    uint64_t monotonic; // CLOCK_MONOTONIC in ns at the same moment
+};
+
+// one record in a binary log. size bytes follow it.
+// a level of LOG_LEVEL_NONE defines call site `site`: an int32 line, then the file, function and format as NUL terminated strings.
+// any other level is a log call from that site and the bytes are its raw arguments in format order
+// (integers, pointers and * widths as 8 bytes, floats as doubles, strings as a uint16 length and the characters).
 struct FiniteLogEntry {
-    FiniteLogLevel level;
-    const char *message;
-    const char *file;
-    int line;
-    const char *function;
-    uint64_t timestamp_ms;
+    uint64_t timestamp; // CLOCK_MONOTONIC in ns
+    uint32_t site;
+    uint16_t size;
+    uint8_t level;
+    uint8_t reserved;
 };
 
 void finite_log_init(FILE *out, FiniteLogLevel level, bool timestamp);
 void finite_log_shutdown(void);
-void finite_log_internal(FiniteLogLevel level, const char *file, int line, const char *func, const char *fmt, ...);
+// moves writing onto a background thread. callers only format their message into a ring of their own, the writer
+// batches lines from every thread, restores their order and writes them. ERROR and above wake it straight away.
+bool finite_log_set_async(bool async);
+// blocks until every line logged before the call has been written
+void finite_log_flush(void);
+// writes lines to out as FiniteLogEntry records instead of text. nothing is formatted: each call site is written once,
+// then every line is just a timestamp, the site's id and its raw arguments. NULL goes back to text.
+// call it before other threads start logging. it takes over from async mode while it's set.
+bool finite_log_set_binary(FILE *out);
+// turns a binary log back into the usual text lines. this is what finite-logdump runs.
+bool finite_log_dump(FILE *in, FILE *out, bool color);
+// keeps the last FINITE_LOG_RECORDER_SLOTS lines of every thread in memory at every level, whatever level the output
+// is set to. recording is a copy of the raw arguments, there's no formatting or io. the recorder is written to path
+// as a binary log (read it with finite-logdump) on FATAL, SIGSEGV or SIGABRT. NULL stops recording.
+bool finite_log_set_recorder(const char *path);
+// writes the recorder now. NULL uses the path it was set up with.
+bool finite_log_dump_recorder(const char *path);
+// limits each call site logging at level to perSecond lines (with bursts of up to burst), and with collapse set
+// swallows a line identical to the site's last one, writing "Last message repeated N more time(s)" once it changes.
+// a perSecond of 0 with collapse off turns it back off. FATAL can't be limited.
+bool finite_log_set_limit(FiniteLogLevel level, float perSecond, uint32_t burst, bool collapse);
+// the name is in brackets so the macro below doesn't expand it
+void (finite_log_internal)(FiniteLogLevel level, const char *file, int line, const char *func, const char *fmt, ...);
+
+// every log call (including the _debug wrappers) goes through here. with a constant level the dead branch is
+// removed entirely, so nothing in it is evaluated.
+#define finite_log_internal(level, ...) ((level) >= FINITE_MIN_LOG_LEVEL ? (finite_log_internal)(level, __VA_ARGS__) : (void) 0)
 
 
 #endif
\ No newline at end of file
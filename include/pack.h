@@ -0,0 +1,106 @@
+#ifndef __PACK_H__
+#define __PACK_H__
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "core.h"
+
+#define FINITE_PACK_MAGIC "FPAK"
+#define FINITE_PACK_VERSION 1
+// payload alignment when the packer isn't told otherwise. enough for simd loads and spir-v.
+#define FINITE_PACK_ALIGN 64
+// packs that can be mounted at once
+#define FINITE_PACK_MOUNTS 16
+// compressed entries are cut into chunks of this many uncompressed bytes, each compressed on its own so they
+// can be decompressed in parallel
+#define FINITE_PACK_CHUNK (256 * 1024)
+// threads that help decompress entries bigger than a chunk. they're started the first time one is read.
+#define FINITE_PACK_WORKERS 4
+
+typedef struct FinitePackHeader FinitePackHeader;
+typedef struct FinitePackEntry FinitePackEntry;
+typedef struct FinitePack FinitePack;
+typedef enum FinitePackCompression FinitePackCompression;
+
+// lz4 and zstd are only there when the library was built with them (the lz4 and zstd meson options)
+enum FinitePackCompression {
+    FINITE_PACK_COMPRESSION_NONE,
+    FINITE_PACK_COMPRESSION_LZ4,
+    FINITE_PACK_COMPRESSION_ZSTD
+};
+
+// the file is the header, the payloads (each aligned to align), the index and then the names.
+// everything is little endian.
+struct FinitePackHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t _entries;
+    uint32_t align;
+    uint64_t index; // offset of the entries, sorted by hash
+    uint64_t names; // offset of the name table. names aren't nul terminated.
+    uint64_t size; // of the whole file, so a truncated pack is caught on open
+    uint32_t chunkSize;
+    uint32_t reserved;
+};
+
+// a compressed payload starts with the end offset of every chunk (a uint64_t each, counted from after the
+// table), then the chunks. a chunk that didn't shrink is stored as is.
+struct FinitePackEntry {
+    uint64_t hash; // finite_pack_hash of the name
+    uint64_t offset;
+    uint64_t size; // uncompressed
+    uint64_t storedSize; // what's actually at offset. the same as size when it isn't compressed.
+    uint32_t name; // offset into the name table
+    uint32_t nameLength;
+    uint32_t compression;
+    uint32_t reserved;
+};
+
+// an open pack. entries point straight into the mapping.
+struct FinitePack {
+    FiniteFileMap map;
+    const FinitePackHeader *header;
+    const FinitePackEntry *entries;
+    const char *names;
+};
+
+// fnv-1a. names are hashed as given, minus any leading "./".
+uint64_t finite_pack_hash(const char *name, size_t length);
+
+#define finite_pack_open(path) finite_pack_open_debug(__FILE__, __func__, __LINE__, path)
+FinitePack *finite_pack_open_debug(const char *file, const char *func, int line, const char *path);
+
+// NULL if name isn't in the pack
+const FinitePackEntry *finite_pack_entry(FinitePack *pack, const char *name);
+
+// finds name in pack and points map at its payload. an uncompressed entry is borrowed from the pack's mapping, so
+// finite_file_unmap on it is free and the pack has to stay open while it's used. a compressed one is decompressed
+// into a mapping of its own. returns false if it isn't there.
+bool finite_pack_find(FinitePack *pack, const char *name, FiniteFileMap *map);
+
+// copies or decompresses entry into out, which needs room for entry->size bytes. out can be anything writable,
+// like a mapped staging buffer. chunks are spread over the pack workers and the calling thread.
+#define finite_pack_read(pack, entry, out, size) finite_pack_read_debug(__FILE__, __func__, __LINE__, pack, entry, out, size)
+bool finite_pack_read_debug(const char *file, const char *func, int line, FinitePack *pack, const FinitePackEntry *entry, void *out, size_t size);
+
+// makes a pack's entries visible to finite_file_map, finite_readfile, finite_draw_png and everything built on them.
+// packs mounted later are searched first, so a patch pack can override a base one.
+#define finite_pack_mount(pack) finite_pack_mount_debug(__FILE__, __func__, __LINE__, pack)
+bool finite_pack_mount_debug(const char *file, const char *func, int line, FinitePack *pack);
+
+void finite_pack_unmount(FinitePack *pack);
+
+// looks name up in every mounted pack
+bool finite_pack_resolve(const char *name, FiniteFileMap *map);
+
+// unmounts the pack if needed and unmaps it. views from it can't be used after this.
+#define finite_pack_close(pack) finite_pack_close_debug(__FILE__, __func__, __LINE__, pack)
+void finite_pack_close_debug(const char *file, const char *func, int line, FinitePack *pack);
+
+// writes a pack to path holding each of names, read from root/name (or name when root is NULL).
+// align must be a power of two, 0 uses FINITE_PACK_ALIGN. entries that compression doesn't shrink by at least
+// 1/16th (already compressed images and audio, mostly) are stored as is so they stay zero copy.
+#define finite_pack_build(path, root, names, count, align, compression) finite_pack_build_debug(__FILE__, __func__, __LINE__, path, root, names, count, align, compression)
+bool finite_pack_build_debug(const char *file, const char *func, int line, const char *path, const char *root, const char **names, uint32_t count, uint32_t align, FinitePackCompression compression);
+
+#endif
@@ -19,6 +19,7 @@ typedef struct FiniteRenderFramebufferInfo FiniteRenderFramebufferInfo;
 typedef struct FiniteRenderQueueFamilies FiniteRenderQueueFamilies;
 typedef struct FiniteRenderPipelineLayoutInfo FiniteRenderPipelineLayoutInfo;
 typedef struct FiniteRenderShaderStages FiniteRenderShaderStages;
+typedef struct FiniteRenderPipelineState FiniteRenderPipelineState;
 typedef struct FiniteRenderShaderStageInfo FiniteRenderShaderStageInfo;
 typedef struct FiniteRenderVertexInputInfo FiniteRenderVertexInputInfo;
 typedef struct FiniteRenderAssemblyInfo FiniteRenderAssemblyInfo;
@@ -140,6 +141,21 @@ struct FiniteRenderShaderStages {
     VkPipelineShaderStageCreateInfo *infos;
 };
 
+// a copy of what the graphics pipeline was created with, so it can be rebuilt after the caller's structs are gone.
+// the infos and the arrays they point at all live in storage. pNext chains aren't copied.
+struct FiniteRenderPipelineState {
+    VkPipelineCreateFlags flags;
+    VkPipelineVertexInputStateCreateInfo *vertex;
+    VkPipelineInputAssemblyStateCreateInfo *assemble;
+    VkPipelineTessellationStateCreateInfo *tess;
+    VkPipelineViewportStateCreateInfo *port;
+    VkPipelineRasterizationStateCreateInfo *raster;
+    VkPipelineMultisampleStateCreateInfo *sample;
+    VkPipelineColorBlendStateCreateInfo *blend;
+    VkPipelineDynamicStateCreateInfo *dyna;
+    void *storage;
+};
+
 struct FiniteRender {
     FiniteShell *shell;
     char **required_layers; // array of extension layers (usually just validation which is on by default)
@@ -159,6 +175,7 @@ struct FiniteRender {
     bool withDepth;
 
     FiniteRenderShaderStages stages;
+    FiniteRenderPipelineState pipelineState;
     
     VkInstance vk_instance;
     VkPhysicalDevice vk_pDevice;
@@ -414,6 +431,15 @@ void finite_render_record_command_buffer_debug(const char *file, const char *fun
 #define finite_render_get_shader_module(render, code, size) finite_render_get_shader_module_debug(__FILE__, __func__, __LINE__, render, code, size)
 bool finite_render_get_shader_module_debug(const char *file, const char *func, int line, FiniteRender *render, char *code, uint32_t size);
 
+// maps path and builds a shader module straight from the mapping
+#define finite_render_load_shader_module(render, path) finite_render_load_shader_module_debug(__FILE__, __func__, __LINE__, render, path)
+bool finite_render_load_shader_module_debug(const char *file, const char *func, int line, FiniteRender *render, const char *path);
+
+// swaps modules[index] for one built from path and points any shader stage using the old one at it.
+// the old module is kept if path doesn't build. call finite_render_rebuild_graphics_pipeline afterwards.
+#define finite_render_reload_shader_module(render, index, path) finite_render_reload_shader_module_debug(__FILE__, __func__, __LINE__, render, index, path)
+bool finite_render_reload_shader_module_debug(const char *file, const char *func, int line, FiniteRender *render, uint32_t index, const char *path);
+
 void finite_render_cleanup(FiniteRender *render);
 char *finite_render_get_shader_code(const char *fileName, uint32_t *pShaderSize);
 
@@ -108,6 +108,16 @@ struct FiniteRenderTextureSamplerInfo {
 #define finite_render_create_texture(file, info, forceAlpha) finite_render_create_texture_debug(__FILE__, __func__, __LINE__, file, info, forceAlpha)
 void finite_render_create_texture_debug(const char *rfile, const char *func, int line, const char *file, FiniteRenderTextureInfo *info, bool forceAlpha);
 
+// decodes an image that's already in memory, like a finite_file_map view
+#define finite_render_create_texture_from_memory(data, size, info, forceAlpha) finite_render_create_texture_from_memory_debug(__FILE__, __func__, __LINE__, data, size, info, forceAlpha)
+bool finite_render_create_texture_from_memory_debug(const char *file, const char *func, int line, const void *data, size_t size, FiniteRenderTextureInfo *info, bool forceAlpha);
+
+// decodes file again and uploads it over image, which has to be a shader read only texture made from info.
+// the new file has to be the same size. a different size needs a new image, view and descriptor.
+// only the base level is uploaded, so images with mipmaps need finite_render_generate_mipmaps again.
+#define finite_render_reload_texture(render, file, image, info, forceAlpha) finite_render_reload_texture_debug(__FILE__, __func__, __LINE__, render, file, image, info, forceAlpha)
+bool finite_render_reload_texture_debug(const char *rfile, const char *func, int line, FiniteRender *render, const char *file, FiniteRenderImage *image, FiniteRenderImageInfo *info, bool forceAlpha);
+
 void finite_render_destroy_pixels(FiniteRenderTextureInfo *image);
 void finite_render_cleanup_textures(FiniteRender *render, FiniteRenderImage *imgs, uint32_t _imgs);
 
@@ -58,6 +58,11 @@ VkPipelineColorBlendStateCreateInfo finite_render_create_color_blend_state_debug
 #define finite_render_create_graphics_pipeline(render, flags, vertex, assemble, tees, port, raster, sample, blend, dyna) finite_render_create_graphics_pipeline_debug(__FILE__, __func__, __LINE__, render, flags, vertex, assemble, tees, port, raster, sample, blend, dyna)
 bool finite_render_create_graphics_pipeline_debug(const char *file, const char *func, int line, FiniteRender *render, VkPipelineCreateFlags flags, VkPipelineVertexInputStateCreateInfo *vertex, VkPipelineInputAssemblyStateCreateInfo *assemble, VkPipelineTessellationStateCreateInfo *tess, VkPipelineViewportStateCreateInfo *port, VkPipelineRasterizationStateCreateInfo *raster, VkPipelineMultisampleStateCreateInfo *sample, VkPipelineColorBlendStateCreateInfo *blend, VkPipelineDynamicStateCreateInfo *dyna);
 
+// recreates the graphics pipeline from the current shader stages and the state it was last created with.
+// waits for the device to go idle first. the old pipeline is kept if the new one fails.
+#define finite_render_rebuild_graphics_pipeline(render) finite_render_rebuild_graphics_pipeline_debug(__FILE__, __func__, __LINE__, render)
+bool finite_render_rebuild_graphics_pipeline_debug(const char *file, const char *func, int line, FiniteRender *render);
+
 #define finite_render_create_command_buffer(render, autocreate, isPrimary, _buffs) finite_render_create_command_buffer_debug(__FILE__, __func__, __LINE__, render, autocreate, isPrimary, _buffs)
 bool finite_render_create_command_buffer_debug(const char *file, const char *func, int line, FiniteRender *render, bool autocreate, bool isPrimary, uint32_t _buffs);
 
@@ -0,0 +1,56 @@
+#ifndef __WATCH_H__
+#define __WATCH_H__
+#include <stdbool.h>
+#include <stdint.h>
+
+// how long a file has to stay quiet before its callback runs. editors and compilers tend to write
+// a file in a few goes (truncate, write, rename) and this folds them into one reload.
+#define FINITE_WATCH_SETTLE_MS 50
+
+typedef struct FiniteWatchEntry FiniteWatchEntry;
+typedef struct FiniteWatch FiniteWatch;
+
+typedef void (*FiniteWatchCallback)(const char *path, void *data);
+
+struct FiniteWatchEntry {
+    char *path;
+    const char *name; // the last part of path, which is what inotify reports
+    int wd; // the watch on path's directory
+    FiniteWatchCallback callback;
+    void *data;
+    bool dirty;
+    uint64_t due; // when the callback runs, in CLOCK_MONOTONIC ms
+};
+
+// calls back when watched files change. it's built on inotify so nothing runs (no thread, no polling) until a
+// file changes, and a program that never creates one pays nothing at all.
+// callbacks only ever run inside finite_watch_dispatch, on whichever thread calls it.
+struct FiniteWatch {
+    int fd;
+    FiniteWatchEntry *entries;
+    uint32_t _entries;
+};
+
+#define finite_watch_create() finite_watch_create_debug(__FILE__, __func__, __LINE__)
+FiniteWatch *finite_watch_create_debug(const char *file, const char *func, int line);
+
+// watches path, which doesn't have to exist yet. the directory is what's actually watched so a file that's
+// replaced by a rename (how most editors save) is still picked up. files inside packs can't be watched.
+#define finite_watch_add(watch, path, callback, data) finite_watch_add_debug(__FILE__, __func__, __LINE__, watch, path, callback, data)
+bool finite_watch_add_debug(const char *file, const char *func, int line, FiniteWatch *watch, const char *path, FiniteWatchCallback callback, void *data);
+
+void finite_watch_remove(FiniteWatch *watch, const char *path);
+
+// for an event loop. it's readable when a file has changed.
+int finite_watch_get_fd(FiniteWatch *watch);
+
+// ms until a changed file has settled and finite_watch_dispatch should be called again. -1 when nothing's waiting.
+int finite_watch_get_timeout(FiniteWatch *watch);
+
+// reads changes and runs the callbacks of files that have settled. never blocks. returns how many ran.
+uint32_t finite_watch_dispatch(FiniteWatch *watch);
+
+#define finite_watch_destroy(watch) finite_watch_destroy_debug(__FILE__, __func__, __LINE__, watch)
+void finite_watch_destroy_debug(const char *file, const char *func, int line, FiniteWatch *watch);
+
+#endif
@@ -2,17 +2,136 @@
 #include "../include/render/stb_image.h"
 #include "../include/render/render-image.h"
 #include "../include/render/render-core.h"
+#include "../include/render/vulkan.h"
 #include "../include/log.h"
+#include "../include/core.h"
+#include <string.h>
 
 void finite_render_create_texture_debug(const char *rfile, const char *func, int line, const char *file, FiniteRenderTextureInfo *info, bool forceAlpha) {
-    stbi_uc *pixels = stbi_load(file, &info->width, &info->height, &info->channels, forceAlpha ? STBI_rgb_alpha : STBI_rgb);
-    if (!pixels) {
+    // stbi decodes from the mapping instead of reading the file through stdio into its own buffer
+    FiniteFileMap map;
+    if (!finite_file_map_debug(rfile, func, line, file, FINITE_FILE_HINT_SEQUENTIAL | FINITE_FILE_HINT_WILLNEED, &map)) {
+        finite_log_internal(LOG_LEVEL_ERROR, rfile, line, func, "Unable to load texture at %s", file);
+        exit(EXIT_FAILURE);
+    }
+
+    bool loaded = finite_render_create_texture_from_memory_debug(rfile, func, line, map.data, map.size, info, forceAlpha);
+    finite_file_unmap_debug(rfile, func, line, &map);
+    if (!loaded) {
         finite_log_internal(LOG_LEVEL_ERROR, rfile, line, func, "Unable to load texture at %s", file);
         exit(EXIT_FAILURE);
     }
+}
+
+bool finite_render_create_texture_from_memory_debug(const char *file, const char *func, int line, const void *data, size_t size, FiniteRenderTextureInfo *info, bool forceAlpha) {
+    if (!data || !info || size == 0 || size > INT32_MAX) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to load texture from NULL or oversized memory");
+        return false;
+    }
+
+    stbi_uc *pixels = stbi_load_from_memory(data, (int) size, &info->width, &info->height, &info->channels, forceAlpha ? STBI_rgb_alpha : STBI_rgb);
+    if (!pixels) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to decode texture (%s)", stbi_failure_reason());
+        return false;
+    }
 
     info->size = info->width * info->height * 4;
     info->pixels = pixels; // devs must free this at some point.
+    return true;
+}
+
+bool finite_render_reload_texture_debug(const char *rfile, const char *func, int line, FiniteRender *render, const char *file, FiniteRenderImage *image, FiniteRenderImageInfo *info, bool forceAlpha) {
+    if (!render || !image || !info) {
+        finite_log_internal(LOG_LEVEL_ERROR, rfile, line, func, "Unable to reload texture with NULL render, image or info");
+        return false;
+    }
+
+    FiniteFileMap map;
+    if (!finite_file_map_debug(rfile, func, line, file, FINITE_FILE_HINT_SEQUENTIAL, &map)) {
+        return false;
+    }
+
+    FiniteRenderTextureInfo texture;
+    bool loaded = finite_render_create_texture_from_memory_debug(rfile, func, line, map.data, map.size, &texture, forceAlpha);
+    finite_file_unmap_debug(rfile, func, line, &map);
+    if (!loaded) {
+        return false;
+    }
+
+    if ((uint32_t) texture.width != info->extent.width || (uint32_t) texture.height != info->extent.height) {
+        finite_log_internal(LOG_LEVEL_ERROR, rfile, line, func, "Unable to reload %s (it's %dx%d now, the image is %ux%u)", file, texture.width, texture.height, info->extent.width, info->extent.height);
+        finite_render_destroy_pixels(&texture);
+        return false;
+    }
+
+    FiniteRenderBufferInfo staging_info = {
+        .size = texture.size,
+        .useFlags = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        .sharing = VK_SHARING_MODE_EXCLUSIVE
+    };
+
+    FiniteRenderMemAllocInfo staging_mem_info = {
+        .flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+    };
+
+    FiniteRenderReturnBuffer staging = {0};
+    if (!finite_render_create_generic_buffer_debug(rfile, func, line, render, &staging_info, &staging_mem_info, texture.size, &staging)) {
+        finite_render_destroy_pixels(&texture);
+        return false;
+    }
+
+    void *data;
+    vkMapMemory(render->vk_device, staging.mem, 0, texture.size, 0, &data);
+    memcpy(data, texture.pixels, (size_t) texture.size);
+    vkUnmapMemory(render->vk_device, staging.mem);
+    finite_render_destroy_pixels(&texture);
+
+    // frames in flight may still be sampling the old contents
+    vkDeviceWaitIdle(render->vk_device);
+
+    FiniteRenderImageBarrierInfo barrier = {
+        .old = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .new = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .srcfIndex = VK_QUEUE_FAMILY_IGNORED,
+        .destfIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image->textureImage,
+        .subRange = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .baseMipLevel = 0,
+            .levelCount = info->_mipLevels,
+            .baseArrayLayer = 0,
+            .layerCount = info->_layers
+        }
+    };
+
+    FiniteRenderPipelineDirections directions = {0};
+
+    FiniteRenderImageCopyDirections copy = {
+        .subLayers = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .mipLevel = 0,
+            .baseArrayLayer = 0,
+            .layerCount = info->_layers
+        },
+        .extent = info->extent,
+        .destLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .buffer = staging.buf,
+        .image = image->textureImage
+    };
+
+    finite_render_transition_image_layout_debug(rfile, func, line, render, &barrier, info->format, &directions);
+    finite_render_copy_buffer_to_image(render, &copy);
+
+    barrier.old = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.new = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    finite_render_transition_image_layout_debug(rfile, func, line, render, &barrier, info->format, &directions);
+
+    // the oneshot commands wait for the queue, so the staging buffer is done with
+    vkDestroyBuffer(render->vk_device, staging.buf, NULL);
+    vkFreeMemory(render->vk_device, staging.mem, NULL);
+
+    finite_log_internal(LOG_LEVEL_INFO, rfile, line, func, "Reloaded texture %s", file);
+    return true;
 }
 
 void finite_render_destroy_pixels(FiniteRenderTextureInfo *image) {
@@ -154,6 +273,12 @@ void finite_render_transition_image_layout_debug(const char *file, const char *f
         info->destFlags = VK_ACCESS_SHADER_READ_BIT;
         dir->srcFlags = VK_PIPELINE_STAGE_TRANSFER_BIT;
         dir->destFlags = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    } else if (info->old == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL && info->new == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
+        FINITE_LOG("Old is Read Only. Moving to Transfer Optimal");
+        info->srcFlags = VK_ACCESS_SHADER_READ_BIT;
+        info->destFlags = VK_ACCESS_TRANSFER_WRITE_BIT;
+        dir->srcFlags = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        dir->destFlags = VK_PIPELINE_STAGE_TRANSFER_BIT;
     } else if (info->old == VK_IMAGE_LAYOUT_UNDEFINED && info->new == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
         FINITE_LOG("Old is undefined. Moving to Depth Stencil");
         info->srcFlags = 0;
@@ -473,6 +473,7 @@ void finite_render_cleanup(FiniteRender *render) {
     if (render->vk_pipeline) {
         vkDestroyPipelineLayout(render->vk_device, render->vk_layout, NULL);
     }
+    free(render->pipelineState.storage);
     if (render->vk_renderPass) {
         vkDestroyRenderPass(render->vk_device, render->vk_renderPass, NULL);
     }
@@ -1,25 +1,72 @@
 #include "../include/render/render-core.h"
+#include "../include/core.h"
+#include "../include/log.h"
 
 char *finite_render_get_shader_code(const char *fileName, uint32_t *pShaderSize) {
 	if (pShaderSize == NULL){
 		return NULL;
 	}
-	FILE *fp = NULL;
-	fp = fopen(fileName, "rb+");
 
-	if (fp == NULL){
+	size_t size = 0;
+	char *shaderCode = finite_readfile(fileName, &size);
+	if (!shaderCode) {
 		return NULL;
 	}
 
-	fseek(fp, 0l, SEEK_END);
+	*pShaderSize = (uint32_t) size;
+	return shaderCode;
+}
+
+bool finite_render_load_shader_module_debug(const char *file, const char *func, int line, FiniteRender *render, const char *path) {
+	// spir-v goes from the page cache to vulkan without a heap copy. the map is page (or pack) aligned, which covers pCode's alignment.
+	FiniteFileMap map;
+	if (!finite_file_map_debug(file, func, line, path, FINITE_FILE_HINT_SEQUENTIAL, &map)) {
+		return false;
+	}
 
-	*pShaderSize = (uint32_t)ftell(fp);
+	bool success = finite_render_get_shader_module_debug(file, func, line, render, (char *) map.data, (uint32_t) map.size);
+	finite_file_unmap_debug(file, func, line, &map);
+	return success;
+}
 
-	rewind(fp);
+bool finite_render_reload_shader_module_debug(const char *file, const char *func, int line, FiniteRender *render, uint32_t index, const char *path) {
+	if (!render || index >= render->_modules) {
+		finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to reload shader module %u (NULL render or no such module)", index);
+		return false;
+	}
 
-	char *shaderCode = (char *)malloc((*pShaderSize) * sizeof(char));
-	fread(shaderCode, 1, *pShaderSize, fp);
+	FiniteFileMap map;
+	if (!finite_file_map_debug(file, func, line, path, FINITE_FILE_HINT_SEQUENTIAL, &map)) {
+		return false;
+	}
 
-	fclose(fp);
-	return shaderCode;
-}
\ No newline at end of file
+	VkShaderModuleCreateInfo shader = {
+		.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+		.codeSize = map.size,
+		.pCode = (const uint32_t *) map.data
+	};
+
+	// built before anything is torn down so a shader that doesn't compile leaves the old one running
+	VkShaderModule module;
+	VkResult res = vkCreateShaderModule(render->vk_device, &shader, NULL, &module);
+	finite_file_unmap_debug(file, func, line, &map);
+	if (res != VK_SUCCESS) {
+		finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to reload shader module from %s", path);
+		return false;
+	}
+
+	// frames in flight may still be using the old module
+	vkDeviceWaitIdle(render->vk_device);
+
+	VkShaderModule old = render->modules[index];
+	for (uint32_t i = 0; i < render->stages._stages; i++) {
+		if (render->stages.infos[i].module == old) {
+			render->stages.infos[i].module = module;
+		}
+	}
+
+	vkDestroyShaderModule(render->vk_device, old, NULL);
+	render->modules[index] = module;
+	finite_log_internal(LOG_LEVEL_INFO, file, line, func, "Reloaded shader module %u from %s", index, path);
+	return true;
+}
@@ -1,5 +1,6 @@
 #include "../include/render/vulkan.h"
 #include "../include/log.h"
+#include <string.h>
 
 const char * VkResultToString(VkResult result) {
     switch (result) {
@@ -745,6 +746,66 @@ bool finite_render_create_descriptor_layout_debug(const char *file, const char *
     return true;
 }
 
+static void *finite_render_copy_array(char **at, const void *array, size_t size) {
+    if (!array || size == 0) {
+        return NULL;
+    }
+
+    void *copy = *at;
+    memcpy(copy, array, size);
+    *at += size;
+    return copy;
+}
+
+// copies the create infos and every array they point at into one allocation. the infos go first since they need
+// pointer alignment and the arrays only need 4 bytes.
+static bool finite_render_copy_pipeline_state(FiniteRenderPipelineState *state, VkPipelineCreateFlags flags, VkPipelineVertexInputStateCreateInfo *vertex, VkPipelineInputAssemblyStateCreateInfo *assemble, VkPipelineTessellationStateCreateInfo *tess, VkPipelineViewportStateCreateInfo *port, VkPipelineRasterizationStateCreateInfo *raster, VkPipelineMultisampleStateCreateInfo *sample, VkPipelineColorBlendStateCreateInfo *blend, VkPipelineDynamicStateCreateInfo *dyna) {
+    size_t bindings = vertex && vertex->pVertexBindingDescriptions ? sizeof(VkVertexInputBindingDescription) * vertex->vertexBindingDescriptionCount : 0;
+    size_t attributes = vertex && vertex->pVertexAttributeDescriptions ? sizeof(VkVertexInputAttributeDescription) * vertex->vertexAttributeDescriptionCount : 0;
+    size_t viewports = port && port->pViewports ? sizeof(VkViewport) * port->viewportCount : 0;
+    size_t scissors = port && port->pScissors ? sizeof(VkRect2D) * port->scissorCount : 0;
+    size_t mask = sample && sample->pSampleMask ? sizeof(VkSampleMask) * ((sample->rasterizationSamples + 31) / 32) : 0;
+    size_t attachments = blend && blend->pAttachments ? sizeof(VkPipelineColorBlendAttachmentState) * blend->attachmentCount : 0;
+    size_t states = dyna && dyna->pDynamicStates ? sizeof(VkDynamicState) * dyna->dynamicStateCount : 0;
+
+    size_t infos = (vertex ? sizeof(*vertex) : 0) + (assemble ? sizeof(*assemble) : 0) + (tess ? sizeof(*tess) : 0) + (port ? sizeof(*port) : 0) + (raster ? sizeof(*raster) : 0) + (sample ? sizeof(*sample) : 0) + (blend ? sizeof(*blend) : 0) + (dyna ? sizeof(*dyna) : 0);
+    *state = (FiniteRenderPipelineState) {.flags = flags};
+    state->storage = malloc(infos + bindings + attributes + viewports + scissors + mask + attachments + states + 1);
+    if (!state->storage) {
+        return false;
+    }
+
+    char *at = state->storage;
+    state->vertex = finite_render_copy_array(&at, vertex, vertex ? sizeof(*vertex) : 0);
+    state->assemble = finite_render_copy_array(&at, assemble, assemble ? sizeof(*assemble) : 0);
+    state->tess = finite_render_copy_array(&at, tess, tess ? sizeof(*tess) : 0);
+    state->port = finite_render_copy_array(&at, port, port ? sizeof(*port) : 0);
+    state->raster = finite_render_copy_array(&at, raster, raster ? sizeof(*raster) : 0);
+    state->sample = finite_render_copy_array(&at, sample, sample ? sizeof(*sample) : 0);
+    state->blend = finite_render_copy_array(&at, blend, blend ? sizeof(*blend) : 0);
+    state->dyna = finite_render_copy_array(&at, dyna, dyna ? sizeof(*dyna) : 0);
+
+    if (vertex) {
+        state->vertex->pVertexBindingDescriptions = finite_render_copy_array(&at, vertex->pVertexBindingDescriptions, bindings);
+        state->vertex->pVertexAttributeDescriptions = finite_render_copy_array(&at, vertex->pVertexAttributeDescriptions, attributes);
+    }
+    if (port) {
+        state->port->pViewports = finite_render_copy_array(&at, port->pViewports, viewports);
+        state->port->pScissors = finite_render_copy_array(&at, port->pScissors, scissors);
+    }
+    if (sample) {
+        state->sample->pSampleMask = finite_render_copy_array(&at, sample->pSampleMask, mask);
+    }
+    if (blend) {
+        state->blend->pAttachments = finite_render_copy_array(&at, blend->pAttachments, attachments);
+    }
+    if (dyna) {
+        state->dyna->pDynamicStates = finite_render_copy_array(&at, dyna->pDynamicStates, states);
+    }
+
+    return true;
+}
+
 bool finite_render_create_graphics_pipeline_debug(const char *file, const char *func, int line, FiniteRender *render, VkPipelineCreateFlags flags, VkPipelineVertexInputStateCreateInfo *vertex, VkPipelineInputAssemblyStateCreateInfo *assemble, VkPipelineTessellationStateCreateInfo *tess, VkPipelineViewportStateCreateInfo *port, VkPipelineRasterizationStateCreateInfo *raster, VkPipelineMultisampleStateCreateInfo *sample, VkPipelineColorBlendStateCreateInfo *blend, VkPipelineDynamicStateCreateInfo *dyna)  {
     if (!render) {
         finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to create new color blend state with NULL render (%p)", render);
@@ -795,16 +856,51 @@ bool finite_render_create_graphics_pipeline_debug(const char *file, const char *
         .basePipelineIndex = -1 // TODO
     };
 
-    VkResult res = vkCreateGraphicsPipelines(render->vk_device, VK_NULL_HANDLE, 1, &graphics_pipeline_info, NULL, &render->vk_pipeline);
+    // built into a local so a failed rebuild leaves the old pipeline in place
+    VkPipeline pipeline;
+    VkResult res = vkCreateGraphicsPipelines(render->vk_device, VK_NULL_HANDLE, 1, &graphics_pipeline_info, NULL, &pipeline);
+    free(depth_stencil);
     if (res != VK_SUCCESS) {
         finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to create graphics pipeline.");
         return false;
     }
 
+    // the infos are usually on the caller's stack, so keep copies for finite_render_rebuild_graphics_pipeline.
+    // a rebuild passes in the old copies, which is why they're only freed once the new ones are made.
+    FiniteRenderPipelineState state;
+    if (!finite_render_copy_pipeline_state(&state, flags, vertex, assemble, tess, port, raster, sample, blend, dyna)) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to keep the graphics pipeline state (no memory available)");
+        vkDestroyPipeline(render->vk_device, pipeline, NULL);
+        return false;
+    }
+
+    free(render->pipelineState.storage);
+    render->vk_pipeline = pipeline;
+    render->pipelineState = state;
+
     FINITE_LOG("Created a graphics pipeline (%p)", render->vk_pipeline);
     return true;
 }
 
+bool finite_render_rebuild_graphics_pipeline_debug(const char *file, const char *func, int line, FiniteRender *render) {
+    if (!render || !render->vk_pipeline) {
+        finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to rebuild a graphics pipeline that was never created");
+        return false;
+    }
+
+    // the old pipeline may still be recorded into frames in flight
+    vkDeviceWaitIdle(render->vk_device);
+
+    VkPipeline old = render->vk_pipeline;
+    FiniteRenderPipelineState *state = &render->pipelineState;
+    if (!finite_render_create_graphics_pipeline_debug(file, func, line, render, state->flags, state->vertex, state->assemble, state->tess, state->port, state->raster, state->sample, state->blend, state->dyna)) {
+        return false;
+    }
+
+    vkDestroyPipeline(render->vk_device, old, NULL);
+    return true;
+}
+
 bool finite_render_create_vertex_buffer_debug(const char *file, const char *func, int line, FiniteRender *render, FiniteRenderBufferInfo *info, FiniteRenderMemAllocInfo *mem_info, uint64_t vertexSize, FiniteRenderReturnBuffer *rtrn) {
     if (!render) {
         finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Unable to create new vertex buffer with NULL information Render: %p Info: %p", render, info);
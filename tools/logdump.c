@@ -0,0 +1,38 @@
+#include "../include/log.h"
+#include <string.h>
+#include <unistd.h>
+
+// finite-logdump [--no-color] [file]
+// renders a log written with finite_log_set_binary. reads stdin when no file (or -) is given.
+int main(int argc, char **argv) {
+    bool color = isatty(STDOUT_FILENO);
+    const char *path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--no-color") == 0) {
+            color = false;
+        } else if (strcmp(argv[i], "--color") == 0) {
+            color = true;
+        } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            printf("usage: %s [--color | --no-color] [file]\n", argv[0]);
+            return 0;
+        } else {
+            path = argv[i];
+        }
+    }
+
+    FILE *in = stdin;
+    if (path && strcmp(path, "-") != 0) {
+        in = fopen(path, "rb");
+        if (!in) {
+            fprintf(stderr, "Unable to open %s\n", path);
+            return 1;
+        }
+    }
+
+    bool ok = finite_log_dump(in, stdout, color);
+    if (in != stdin) {
+        fclose(in);
+    }
+    return ok ? 0 : 1;
+}
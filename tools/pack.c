@@ -0,0 +1,119 @@
+#define _XOPEN_SOURCE 700
+#include "../include/pack.h"
+#include "../include/log.h"
+#include <ftw.h>
+#include <string.h>
+#include <sys/stat.h>
+
+static const char *root = NULL;
+static size_t rootLength = 0;
+static char **names = NULL;
+static uint32_t _names = 0;
+static uint32_t namesCap = 0;
+
+static bool add_name(const char *name) {
+    if (_names == namesCap) {
+        namesCap = namesCap ? namesCap * 2 : 64;
+        char **grown = realloc(names, namesCap * sizeof(char *));
+        if (!grown) {
+            return false;
+        }
+        names = grown;
+    }
+
+    names[_names] = strdup(name);
+    return names[_names++] != NULL;
+}
+
+static int compare_names(const void *a, const void *b) {
+    return strcmp(*(char *const *) a, *(char *const *) b);
+}
+
+static int add_file(const char *path, const struct stat *st, int type, struct FTW *ftw) {
+    if (type != FTW_F) {
+        return 0;
+    }
+
+    // names are stored relative to the root so they match what the game passes to finite_readfile
+    if (root) {
+        path += rootLength;
+        while (*path == '/') {
+            path++;
+        }
+    }
+
+    return add_name(path) ? 0 : -1;
+}
+
+// finite-pack [-C dir] [-a align] [-c none|lz4|zstd] output inputs...
+// packs files, and everything under directories, into one archive. names are the paths relative to dir.
+int main(int argc, char **argv) {
+    const char *output = NULL;
+    uint32_t align = 0;
+    FinitePackCompression compression = FINITE_PACK_COMPRESSION_NONE;
+    int i = 1;
+
+    // the library reports what went wrong through the log
+    finite_log_init(stderr, LOG_LEVEL_WARN, false);
+
+    for (; i < argc; i++) {
+        if (strcmp(argv[i], "-C") == 0 && i + 1 < argc) {
+            root = argv[++i];
+        } else if (strcmp(argv[i], "-a") == 0 && i + 1 < argc) {
+            align = (uint32_t) strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            const char *codec = argv[++i];
+            if (strcmp(codec, "lz4") == 0) {
+                compression = FINITE_PACK_COMPRESSION_LZ4;
+            } else if (strcmp(codec, "zstd") == 0) {
+                compression = FINITE_PACK_COMPRESSION_ZSTD;
+            } else if (strcmp(codec, "none") != 0) {
+                fprintf(stderr, "Unknown compression %s\n", codec);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            printf("usage: %s [-C dir] [-a align] [-c none|lz4|zstd] output inputs...\n", argv[0]);
+            return 0;
+        } else {
+            output = argv[i++];
+            break;
+        }
+    }
+
+    if (!output || i == argc) {
+        fprintf(stderr, "usage: %s [-C dir] [-a align] [-c none|lz4|zstd] output inputs...\n", argv[0]);
+        return 1;
+    }
+
+    if (root) {
+        rootLength = strlen(root);
+    }
+
+    for (; i < argc; i++) {
+        char path[4096];
+        if (root) {
+            snprintf(path, sizeof(path), "%s/%s", root, argv[i]);
+        } else {
+            snprintf(path, sizeof(path), "%s", argv[i]);
+        }
+
+        if (nftw(path, add_file, 16, FTW_PHYS) != 0) {
+            fprintf(stderr, "Unable to add %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    // keep the archive the same from build to build no matter how the directories were walked
+    qsort(names, _names, sizeof(char *), compare_names);
+
+    bool ok = finite_pack_build(output, root, (const char **) names, _names, align, compression);
+    if (ok) {
+        printf("%s: %u files\n", output, _names);
+    }
+
+    for (uint32_t n = 0; n < _names; n++) {
+        free(names[n]);
+    }
+    free(names);
+    return ok ? 0 : 1;
+}
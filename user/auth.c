@@ -232,7 +232,7 @@ FiniteAuthRequest *finite_user_request_auth_debug(const char *file, const char *
         return code_data;
     }
 
-    char *code = finite_json_get_value_from_key(json, "verify_code");
+    char *code = finite_json_get_value_from_literal(json, "verify_code");
     if (!code) {
         finite_log_internal(LOG_LEVEL_ERROR, file, line, func, "Item verify_code was not found.");
     }
@@ -282,16 +282,16 @@ FiniteAuthRequest *finite_user_request_auth_debug(const char *file, const char *
         return code_data;
     }
 
-    code_data->id = atoi(finite_json_get_value_from_key(json, "id"));
-    code_data->iat = atoi(finite_json_get_value_from_key(json, "expires_at"));
-    code_data->game_id = atoi(finite_json_get_value_from_key(json, "game_id"));
-    code_data->state = finite_json_get_value_from_key(json, "state");
+    code_data->id = atoi(finite_json_get_value_from_literal(json, "id"));
+    code_data->iat = atoi(finite_json_get_value_from_literal(json, "expires_at"));
+    code_data->game_id = atoi(finite_json_get_value_from_literal(json, "game_id"));
+    code_data->state = finite_json_get_value_from_literal(json, "state");
     // convert state
     code_data->auth_state = to_auth_state(code_data->state);
     
-    code_data->device_id = finite_json_get_value_from_key(json, "device_id");
-    code_data->verify_code = finite_json_get_value_from_key(json, "verify_code");
-    code_data->user_id = finite_json_get_value_from_key(json, "user_id");
+    code_data->device_id = finite_json_get_value_from_literal(json, "device_id");
+    code_data->verify_code = finite_json_get_value_from_literal(json, "verify_code");
+    code_data->user_id = finite_json_get_value_from_literal(json, "user_id");
 
     // TODO: set user online here
 
@@ -80,14 +80,14 @@ FiniteUser *finite_user_get_by_id_debug(const char *file, const char *func, int
         return NULL;
     }
 
-    char *name = finite_json_get_value_from_key(json, "username");
-    char *id = finite_json_get_value_from_key(json, "id");
-    char *display = finite_json_get_value_from_key(json, "display_name");
-    char *bio = finite_json_get_value_from_key(json, "bio");
-    char *banner = finite_json_get_value_from_key(json, "bio");
-    char *is_online = finite_json_get_value_from_key(json, "is_online");
-    char *is_mod = finite_json_get_value_from_key(json, "is_moderator");
-    int last_online = atoi(finite_json_get_value_from_key(json, "last_online"));
+    char *name = finite_json_get_value_from_literal(json, "username");
+    char *id = finite_json_get_value_from_literal(json, "id");
+    char *display = finite_json_get_value_from_literal(json, "display_name");
+    char *bio = finite_json_get_value_from_literal(json, "bio");
+    char *banner = finite_json_get_value_from_literal(json, "bio");
+    char *is_online = finite_json_get_value_from_literal(json, "is_online");
+    char *is_mod = finite_json_get_value_from_literal(json, "is_moderator");
+    int last_online = atoi(finite_json_get_value_from_literal(json, "last_online"));
 
     strncpy(usr->user, name, sizeof(usr->user) - 1);
     usr->user[sizeof(usr->user)-1] = '\0';
@@ -170,7 +170,7 @@ enum FiniteUserStatus finite_user_get_status_debug(const char *file, const char
     }
 
     FiniteJSONValue *json = finite_json_parse(response.data);
-    char *status = finite_json_get_value_from_key(json, "online?");
+    char *status = finite_json_get_value_from_literal(json, "online?");
 
     // TODO: isOnline shouldnt be a boolean
     if (strcmp(status, "true") == 0) {